@@ -152,7 +152,9 @@ LOCAL_SRC_FILES :=	\
 	slang_rs_export_var.cpp	\
 	slang_rs_export_func.cpp	\
 	slang_rs_export_foreach.cpp \
+	slang_rs_export_reduce.cpp \
 	slang_rs_object_ref_count.cpp	\
+	slang_rs_odr_database.cpp	\
 	slang_rs_reflection.cpp \
 	slang_rs_reflection_cpp.cpp \
 	slang_rs_reflect_utils.cpp \
@@ -0,0 +1,19 @@
+// RUN: rm -rf %t && mkdir -p %t
+// RUN: cp %s %t/odr_conflict_a.rs
+// RUN: sed -e 's/float member2/int member2/' %s > %t/odr_conflict_b.rs
+// RUN: %Slang -odr-type-db %t/db %t/odr_conflict_a.rs
+// RUN: not %Slang -odr-type-db %t/db %t/odr_conflict_b.rs 2> %t/stderr.txt
+// RUN: FileCheck -input-file %t/stderr.txt %s
+
+// CHECK: error: type 'SharedDefinition' in different translation unit ({{.*}}odr_conflict_b.rs v.s. {{.*}}odr_conflict_a.rs) has incompatible type definition
+
+#pragma version(1)
+#pragma rs java_package_name(foo)
+
+typedef struct SharedDefinition {
+	int member1;
+	float member2;
+	float4 member3;
+} SharedDefinition;
+
+SharedDefinition o;
@@ -0,0 +1,61 @@
+// RUN: rm -rf %t
+// RUN: %Slang -target-api 19 -java-reflection-path-base %t/kk %s
+// RUN: FileCheck -input-file %t/kk/foo/ScriptFieldSoA_Sample.java -check-prefix=KK %s
+// RUN: %Slang -target-api 0 -java-reflection-path-base %t/dev %s
+// RUN: FileCheck -input-file %t/dev/foo/ScriptFieldSoA_Sample.java -check-prefix=DEV %s
+// RUN: %Slang -reflect-c++ -java-reflection-path-base %t/cpp %s
+// RUN: FileCheck -input-file %t/cpp/ScriptFieldSoA_Sample.h -check-prefix=HEADER %s
+// RUN: FileCheck -input-file %t/cpp/ScriptC_export_type_soa.h -check-prefix=SCRIPT %s
+
+// Allocation has no long[] or double[] copy methods before L, so the 64-bit
+// fields are uploaded through a FieldPacker there, and cannot be read back.
+// KK: public void copyFrom_position(float[] d) {
+// KK-NEXT: mAlloc_position.copyFrom(d);
+// KK: public void copyTo_position(float[] d) {
+// KK: public void copyFrom_weight(double[] d) {
+// KK-NEXT: FieldPacker fp = new FieldPacker(d.length * 8);
+// KK-NEXT: for (int ct = 0; ct < d.length; ct++) fp.addF64(d[ct]);
+// KK-NEXT: mAlloc_weight.setFromFieldPacker(0, fp);
+// KK-NOT: copyTo_weight
+// KK: public void copyRangeFrom_weight(int off, int count, double[] d) {
+// KK-NEXT: int size = count * 8;
+// KK: mAlloc_weight.setFromFieldPacker(off, fp);
+// KK: public void copyFrom_ids(long[] d) {
+// KK-NEXT: FieldPacker fp = new FieldPacker(d.length * 8);
+// KK-NEXT: for (int ct = 0; ct < d.length; ct++) fp.addI64(d[ct]);
+// KK-NOT: copyTo_ids
+// KK: public void copyRangeFrom_ids(int off, int count, long[] d) {
+// KK-NEXT: int size = count * 16;
+
+// DEV: public void copyFrom_weight(double[] d) {
+// DEV-NEXT: mAlloc_weight.copyFrom(d);
+// DEV: public void copyTo_weight(double[] d) {
+// DEV-NEXT: mAlloc_weight.copyTo(d);
+// DEV: public void copyRangeFrom_weight(int off, int count, double[] d) {
+// DEV-NEXT: mAlloc_weight.copy1DRangeFrom(off, count, d);
+// DEV-NOT: FieldPacker
+
+// The class lives in its own guarded header, shared by the scripts exporting
+// the same type.
+// HEADER: #ifndef RS_SCRIPTFIELDSOA_SAMPLE_H
+// HEADER-NEXT: #define RS_SCRIPTFIELDSOA_SAMPLE_H
+// HEADER: class ScriptFieldSoA_Sample {
+// HEADER: #endif  // RS_SCRIPTFIELDSOA_SAMPLE_H
+
+// SCRIPT: #include "ScriptFieldSoA_Sample.h"
+// SCRIPT-NOT: class ScriptFieldSoA_Sample
+
+#pragma version(1)
+#pragma rs java_package_name(foo)
+
+typedef struct Sample {
+    float4 position;
+    double weight;
+    long2 ids;
+} Sample_t;
+
+#pragma rs export_type_soa(Sample_t)
+
+float4 *samples_position;
+double *samples_weight;
+long2 *samples_ids;
@@ -0,0 +1,54 @@
+// RUN: %Slang -O 0 %s
+// RUN: %rs-filecheck-wrapper %s
+// One entry per exported variable, in slot order: 0 if the script never
+// writes it, 1 if only invokables do, and 2 if kernels may.
+// CHECK: rs_export_var_access = !{[[RO:![0-9]+]], [[INVOKABLE:![0-9]+]], [[KERNEL:![0-9]+]], [[KERNEL]], [[RO]], [[KERNEL]], [[INVOKABLE]], [[KERNEL]]}
+// CHECK-DAG: [[RO]] = metadata !{metadata !"0"}
+// CHECK-DAG: [[INVOKABLE]] = metadata !{metadata !"1"}
+// CHECK-DAG: [[KERNEL]] = metadata !{metadata !"2"}
+
+#pragma version(1)
+#pragma rs java_package_name(foo)
+
+float scale;          // read-only
+int count;            // written by an invokable
+int hits;             // written by a kernel through a helper
+int escaped;          // its address escapes, so it may be written anywhere
+rs_allocation table;  // read-only, only released by the destructor
+int stashed;          // its address is stored by an invokable, then written
+                      // through by a kernel
+int total;            // written by an invokable through a helper
+int ticks;            // written by a kernel through the runtime
+
+static int *alias = &escaped;
+static int *stash;
+
+static void bump() {
+  hits++;
+}
+
+static void add(int *p, int v) {
+  *p += v;
+}
+
+float RS_KERNEL apply(float in) {
+  if (in > scale)
+    bump();
+  if (stash)
+    *stash += 1;
+  rsAtomicInc(&ticks);
+  return in * scale + rsGetElementAt_float(table, 0);
+}
+
+void reset(int n) {
+  count = n;
+}
+
+void peek() {
+  count += *alias;
+}
+
+void setup() {
+  stash = &stashed;
+  add(&total, 2);
+}
@@ -0,0 +1,50 @@
+// RUN: %Slang %s
+// RUN: %rs-filecheck-wrapper %s
+// One <instructions, loads, stores, transcendentals, loops, unknown callees>
+// entry per kernel, in slot order (starting with the dummy root).
+// CHECK: rs_export_foreach_cost = !{[[ROOT:![0-9]+]], [[SCALE:![0-9]+]], [[WAVE:![0-9]+]], [[FILTER:![0-9]+]], [[APPLY:![0-9]+]]}
+// CHECK-DAG: [[ROOT]] = metadata !{metadata !"{{[0-9]+}}", metadata !"0", metadata !"0", metadata !"0", metadata !"0", metadata !"0"}
+// CHECK-DAG: [[SCALE]] = metadata !{metadata !"{{[0-9]+}}", metadata !"1", metadata !"0", metadata !"0", metadata !"0", metadata !"0"}
+// CHECK-DAG: [[WAVE]] = metadata !{metadata !"{{[0-9]+}}", metadata !"0", metadata !"0", metadata !"3", metadata !"0", metadata !"0"}
+// CHECK-DAG: [[FILTER]] = metadata !{metadata !"{{[0-9]+}}", metadata !"{{[0-9]+}}", metadata !"0", metadata !"0", metadata !"1", metadata !"0"}
+// CHECK-DAG: [[APPLY]] = metadata !{metadata !"{{[0-9]+}}", metadata !"1", metadata !"0", metadata !"0", metadata !"0", metadata !"1"}
+
+#pragma version(1)
+#pragma rs java_package_name(foo)
+
+float gain;
+int taps;
+
+static float twice(float v) {
+  return v * 2.f;
+}
+
+static float halve(float v) {
+  return v * .5f;
+}
+
+static float (*op)(float) = twice;
+
+void setOp(int doubling) {
+  op = doubling ? twice : halve;
+}
+
+float RS_KERNEL scale(float in) {
+  return in * gain;
+}
+
+float RS_KERNEL wave(float in) {
+  return native_sin(in) + exp(in) * pow(in, 2.5f);
+}
+
+float RS_KERNEL filter(float in, uint32_t x) {
+  float sum = 0.f;
+  for (int i = 0; i < taps; i++) {
+    sum = sum * in + 1.f;
+  }
+  return sum;
+}
+
+float RS_KERNEL apply(float in) {
+  return op(in);
+}
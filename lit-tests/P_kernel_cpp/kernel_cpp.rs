@@ -0,0 +1,24 @@
+// RUN: %Slang -reflect-c++ -java-reflection-path-base %t %s
+// RUN: FileCheck -input-file %t/ScriptC_kernel_cpp.h -check-prefix=HEADER %s
+// RUN: FileCheck -input-file %t/ScriptC_kernel_cpp.cpp %s
+
+// Released runtimes only have forEach(slot, in, out, usr, len).
+
+// HEADER-NOT: getKernelID_
+// HEADER: void forEach_scale(android::RSC::sp<const android::RSC::Allocation> ain,
+// HEADER-NEXT: android::RSC::sp<const android::RSC::Allocation> aout);
+// HEADER-NOT: RsScriptCall
+
+// CHECK-NOT: createKernelID
+// CHECK: void ScriptC_kernel_cpp::forEach_scale(
+// CHECK: forEach({{[0-9]+}}, ain, aout, NULL, 0);
+// CHECK-NOT: RsScriptCall
+
+#pragma version(1)
+#pragma rs java_package_name(foo)
+
+float factor;
+
+float RS_KERNEL scale(float in) {
+  return in * factor;
+}
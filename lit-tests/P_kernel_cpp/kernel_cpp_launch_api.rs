@@ -0,0 +1,23 @@
+// RUN: %Slang -reflect-c++ -target-api 0 -java-reflection-path-base %t %s
+// RUN: FileCheck -input-file %t/ScriptC_kernel_cpp_launch_api.h -check-prefix=HEADER %s
+// RUN: FileCheck -input-file %t/ScriptC_kernel_cpp_launch_api.cpp %s
+
+// HEADER: getKernelID_add();
+// HEADER: void forEach_add(android::RSC::sp<const android::RSC::Allocation> ain_in0,
+// HEADER-NEXT: android::RSC::sp<const android::RSC::Allocation> ain_in1,
+// HEADER-NEXT: android::RSC::sp<const android::RSC::Allocation> aout);
+// HEADER: void forEach_add(
+// HEADER: const RsScriptCall * sc);
+
+// CHECK: ScriptC_kernel_cpp_launch_api::getKernelID_add()
+// CHECK-NEXT: return createKernelID([[SLOT:[0-9]+]], {{[0-9]+}}, NULL, NULL);
+// CHECK: ains.push_back(ain_in0);
+// CHECK-NEXT: ains.push_back(ain_in1);
+// CHECK-NEXT: forEach([[SLOT]], ains, aout, NULL, 0, sc);
+
+#pragma version(1)
+#pragma rs java_package_name(foo)
+
+int RS_KERNEL add(int in0, int in1) {
+  return in0 + in1;
+}
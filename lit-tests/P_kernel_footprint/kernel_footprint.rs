@@ -0,0 +1,38 @@
+// RUN: %Slang %s
+// RUN: %rs-filecheck-wrapper %s
+// One entry per kernel in slot order (starting with the dummy root). Kernels
+// without a stencil read have an empty entry.
+// Reads at a constant coordinate of a dimension the kernel does not iterate
+// over (shift), or at a coordinate parameter the kernel modifies (stride), are
+// not stencil reads.
+// CHECK: rs_export_foreach_footprint = !{[[NONE:![0-9]+]], [[BLUR:![0-9]+]], [[NONE]], [[NONE]], [[NONE]]}
+// CHECK-DAG: [[NONE]] = metadata !{}
+// CHECK-DAG: [[BLUR]] = metadata !{metadata !"image", metadata !"-1", metadata !"1", metadata !"-1", metadata !"1"}
+
+#pragma version(1)
+#pragma rs java_package_name(foo)
+
+rs_allocation image;
+rs_allocation lut;
+rs_allocation weights;
+
+float RS_KERNEL blur3x3(uint32_t x, uint32_t y) {
+  float sum = 0.f;
+  sum += rsGetElementAt_float(image, x - 1, y - 1);
+  sum += rsGetElementAt_float(image, x + 1, y + 1);
+  sum += rsGetElementAt_float(image, x, y);
+  return sum * rsGetElementAt_float(weights, 0);
+}
+
+float RS_KERNEL shift(uint32_t x) {
+  return rsGetElementAt_float(image, x + 2, 0);
+}
+
+uchar RS_KERNEL remap(uchar in) {
+  return rsGetElementAt_uchar(lut, in);
+}
+
+float RS_KERNEL stride(uint32_t x) {
+  x = x * 2;
+  return rsGetElementAt_float(image, x + 1);
+}
@@ -0,0 +1,34 @@
+// RUN: %Slang %s
+// RUN: %rs-filecheck-wrapper %s
+// One entry per kernel, in #rs_export_foreach_name order (starting with the
+// dummy root), which is empty for the kernels using the file precision.
+// CHECK: rs_export_foreach_name = !{[[ROOT_NAME:![0-9]+]], [[BRIGHTEN_NAME:![0-9]+]], [[COPY_NAME:![0-9]+]], [[DIM_NAME:![0-9]+]]}
+// CHECK: rs_export_foreach_precision = !{[[EMPTY:![0-9]+]], [[BRIGHTEN:![0-9]+]], [[EMPTY]], [[EMPTY]]}
+// CHECK-DAG: [[ROOT_NAME]] = metadata !{metadata !"root"}
+// CHECK-DAG: [[BRIGHTEN_NAME]] = metadata !{metadata !"brighten"}
+// CHECK-DAG: [[COPY_NAME]] = metadata !{metadata !"copy"}
+// CHECK-DAG: [[DIM_NAME]] = metadata !{metadata !"dim"}
+// CHECK-DAG: [[EMPTY]] = metadata !{metadata !""}
+// CHECK-DAG: [[BRIGHTEN]] = metadata !{metadata !"rs_fp_relaxed"}
+// The pragma preceding the prototype of dim() reaches neither copy() nor dim().
+
+#pragma version(1)
+#pragma rs java_package_name(foo)
+
+float gain;
+
+#pragma rs fp_precision(rs_fp_relaxed)
+float4 RS_KERNEL brighten(float4 in) {
+  return in * gain;
+}
+
+#pragma rs fp_precision(rs_fp_relaxed)
+float4 RS_KERNEL dim(float4 in);
+
+float4 RS_KERNEL copy(float4 in) {
+  return in;
+}
+
+float4 RS_KERNEL dim(float4 in) {
+  return in * 0.5f;
+}
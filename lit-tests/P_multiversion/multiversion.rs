@@ -0,0 +1,60 @@
+// RUN: %Slang %s
+// RUN: %rs-filecheck-wrapper %s
+
+// The uniform values stay scalar until used by a lane-wise operation, and
+// the widened instructions keep the (lack of) fast-math flags of the scalar
+// ones.
+// CHECK-LABEL: define <4 x float> @.rs.vec4.brighten(<4 x float> %in)
+// CHECK: [[GAIN:%[0-9]+]] = load float* @gain
+// CHECK: insertelement <4 x float> undef, float [[GAIN]], i32 0
+// CHECK: = fmul <4 x float>
+// CHECK: = fadd <4 x float>
+// CHECK: = fcmp ogt <4 x float>
+// CHECK: = select <4 x i1>
+// CHECK: ret <4 x float>
+
+// CHECK-LABEL: define <8 x float> @.rs.vec8.brighten(<8 x float> %in)
+// CHECK: = fmul <8 x float>
+// CHECK: ret <8 x float>
+
+// x is the coordinate of the first lane.
+// CHECK-LABEL: define <4 x i32> @.rs.vec4.ramp(i32 %x)
+// CHECK: insertelement <4 x i32> undef, i32 %x, i32 0
+// CHECK: %x.lanes = add <4 x i32> %{{.*}}, <i32 0, i32 1, i32 2, i32 3>
+// CHECK: ret <4 x i32>
+
+// CHECK-LABEL: define <8 x i32> @.rs.vec8.ramp(i32 %x)
+// CHECK: %x.lanes = add <8 x i32> %{{.*}}, <i32 0, i32 1, i32 2, i32 3, i32 4, i32 5, i32 6, i32 7>
+
+// y is the same for all the lanes.
+// CHECK-LABEL: define <4 x float> @.rs.vec4.shade(<4 x float> %in, i32 %x, i32 %y)
+// CHECK: insertelement <4 x i32> undef, i32 %y, i32 0
+// CHECK: = uitofp <4 x i32> %{{.*}} to <4 x float>
+// CHECK: = fmul <4 x float>
+
+// One entry per kernel, in slot order (starting with the dummy root).
+// CHECK: rs_export_foreach_variants = !{[[NONE:![0-9]+]], [[BRIGHTEN:![0-9]+]], [[RAMP:![0-9]+]], [[SHADE:![0-9]+]]}
+// CHECK-DAG: [[NONE]] = metadata !{}
+// CHECK-DAG: [[BRIGHTEN]] = metadata !{metadata !"4", metadata !".rs.vec4.brighten", metadata !"8", metadata !".rs.vec8.brighten"}
+// CHECK-DAG: [[RAMP]] = metadata !{metadata !"4", metadata !".rs.vec4.ramp", metadata !"8", metadata !".rs.vec8.ramp"}
+// CHECK-DAG: [[SHADE]] = metadata !{metadata !"4", metadata !".rs.vec4.shade", metadata !"8", metadata !".rs.vec8.shade"}
+
+#pragma version(1)
+#pragma rs java_package_name(foo)
+
+#pragma rs multiversion(brighten, ramp, shade)
+
+float gain;
+
+float RS_KERNEL brighten(float in) {
+  float out = in * gain + 0.1f;
+  return (out > 1.f) ? 1.f : out;
+}
+
+int RS_KERNEL ramp(uint32_t x) {
+  return x * 2;
+}
+
+float RS_KERNEL shade(float in, uint32_t x, uint32_t y) {
+  return in * (float)y;
+}
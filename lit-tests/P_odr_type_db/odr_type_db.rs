@@ -0,0 +1,25 @@
+// RUN: rm -rf %t && mkdir -p %t
+// RUN: cp %s %t/odr_db_a.rs
+// RUN: %Slang -odr-type-db %t/db %t/odr_db_a.rs
+// The definition recorded for odr_db_a.rs is stale once the file is modified,
+// so it does not conflict with the new definition of odr_db_b.rs.
+// RUN: sed -e 's/float member2/int member2/' %s > %t/odr_db_a.rs
+// RUN: touch -t 200001010000 %t/odr_db_a.rs
+// RUN: cp %t/odr_db_a.rs %t/odr_db_b.rs
+// RUN: %Slang -odr-type-db %t/db %t/odr_db_b.rs
+// RUN: %Slang -odr-type-db %t/db %t/odr_db_a.rs
+// RUN: FileCheck -input-file %t/db/foo.32.rsodr %s
+
+// CHECK-DAG: SharedDefinition{{.*}}member2:int{{.*}}odr_db_a.rs
+// CHECK-DAG: SharedDefinition{{.*}}member2:int{{.*}}odr_db_b.rs
+
+#pragma version(1)
+#pragma rs java_package_name(foo)
+
+typedef struct SharedDefinition {
+	int member1;
+	float member2;
+	float4 member3;
+} SharedDefinition;
+
+SharedDefinition o;
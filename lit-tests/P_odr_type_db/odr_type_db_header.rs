@@ -0,0 +1,25 @@
+// RUN: rm -rf %t && mkdir -p %t
+// RUN: echo 'typedef struct SharedDefinition { int member1; float member2; } SharedDefinition;' > %t/shared.rsh
+// RUN: touch -t 200001010000 %t/shared.rsh
+// RUN: cp %s %t/odr_hdr_a.rs
+// RUN: cp %s %t/odr_hdr_b.rs
+// RUN: %Slang -odr-type-db %t/db %t/odr_hdr_a.rs
+// RUN: %Slang -odr-type-db %t/db %t/odr_hdr_b.rs
+// Modifying the shared header makes the entries of both files stale, so the
+// first one recompiled does not conflict with the other.
+// RUN: echo 'typedef struct SharedDefinition { int member1; int member2; } SharedDefinition;' > %t/shared.rsh
+// RUN: %Slang -odr-type-db %t/db %t/odr_hdr_a.rs
+// RUN: %Slang -odr-type-db %t/db %t/odr_hdr_b.rs
+// RUN: FileCheck -input-file %t/db/foo.32.rsodr %s
+
+// CHECK-DAG: type{{.*}}SharedDefinition{{.*}}member2:int{{.*}}odr_hdr_a.rs
+// CHECK-DAG: type{{.*}}SharedDefinition{{.*}}member2:int{{.*}}odr_hdr_b.rs
+// CHECK-DAG: file{{.*}}shared.rsh{{.*}}odr_hdr_a.rs
+// CHECK-DAG: file{{.*}}shared.rsh{{.*}}odr_hdr_b.rs
+
+#pragma version(1)
+#pragma rs java_package_name(foo)
+
+#include "shared.rsh"
+
+SharedDefinition o;
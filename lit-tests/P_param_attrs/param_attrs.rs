@@ -0,0 +1,11 @@
+// RUN: %Slang -O 3 %s
+// RUN: %rs-filecheck-wrapper %s
+// CHECK: define i32 @sum(i32* nocapture readonly %p)
+// CHECK-NOT: rs_param_attrs
+
+#pragma version(1)
+#pragma rs java_package_name(foo)
+
+int sum(const int *p) {
+  return p[0] + p[1];
+}
@@ -0,0 +1,12 @@
+// RUN: %Slang -O 3 -target-api 19 %s
+// RUN: %rs-filecheck-wrapper %s
+// CHECK: define i32 @sum(i32* nocapture %p)
+// CHECK: rs_param_attrs = !{[[ATTRS:![0-9]+]]}
+// CHECK: [[ATTRS]] = metadata !{metadata !"sum", metadata !"0", metadata !"readonly"}
+
+#pragma version(1)
+#pragma rs java_package_name(foo)
+
+int sum(const int *p) {
+  return p[0] + p[1];
+}
@@ -0,0 +1,21 @@
+// RUN: rm -rf %t
+// RUN: %Slang -reflect-c++ -reflect-c++-incbin -MD -o %t/out -output-dep-dir %t/out -java-reflection-path-base %t/cpp %s
+// RUN: FileCheck -input-file %t/cpp/ScriptC_incbin_bitcode.S %s
+// RUN: FileCheck -input-file %t/out/incbin.d -check-prefix=DEP %s
+
+// The bitcode is referred to relative to the directory of the assembly file.
+// CHECK: .incbin "../out/incbin.bc"
+
+// The assembly file is generated along with the bitcode, and depends on it.
+// DEP: ScriptC_incbin_bitcode.S
+// DEP: incbin.rs
+// DEP: ScriptC_incbin_bitcode.S: {{.*}}out/incbin.bc
+
+#pragma version(1)
+#pragma rs java_package_name(foo)
+
+int i1 = 5;
+
+int RS_KERNEL root(int ain) {
+  return ain + i1;
+}
@@ -0,0 +1,10 @@
+// RUN: %Slang -O 0 %s
+// RUN: %rs-filecheck-wrapper %s
+// CHECK: define void @root(<4 x i8>* {{(noalias align 4|align 4 noalias)}} %ain, <3 x float>* {{(noalias align 16|align 16 noalias)}} %aout, i8* %usrData, i32 %x)
+
+#pragma version(1)
+#pragma rs java_package_name(foo)
+
+void root(const uchar4 *ain, float3 *aout, const void *usrData, uint32_t x) {
+  aout->x = ain->x;
+}
@@ -0,0 +1,14 @@
+// RUN: %Slang -O 0 %s
+// RUN: %rs-filecheck-wrapper %s
+// CHECK: define void @root(%struct.Point* {{(noalias align 4|align 4 noalias)}} %ain, i8* noalias %aout)
+
+#pragma version(1)
+#pragma rs java_package_name(foo)
+
+typedef struct Point {
+  float x, y, z;
+} Point_t;
+
+void root(const Point_t *ain, uchar *aout) {
+  *aout = (uchar) ain->x;
+}
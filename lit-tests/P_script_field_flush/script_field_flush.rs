@@ -0,0 +1,54 @@
+// RUN: rm -rf %t
+// RUN: %Slang -java-reflection-path-base %t/item %s
+// RUN: FileCheck -input-file %t/item/foo/ScriptField_Point.java -check-prefix=ITEM -check-prefix=CHECK %s
+// RUN: %Slang -reflect-packed-fields -java-reflection-path-base %t/packed %s
+// RUN: FileCheck -input-file %t/packed/foo/ScriptField_Point.java -check-prefix=PACKED -check-prefix=CHECK %s
+
+// The setters called without copyNow record the modified items.
+// CHECK: private java.util.BitSet mDirty;
+// CHECK: public synchronized void set(Item i, int index, boolean copyNow) {
+// ITEM: mItemArray[index] = i;
+// ITEM-NEXT: if (!copyNow) markDirty(index);
+// PACKED: if (copyNow) copyRange(index, 1);
+// PACKED-NEXT: else markDirty(index);
+// CHECK: public synchronized void set_x(int index, float v, boolean copyNow) {
+// ITEM: if (!copyNow) markDirty(index);
+// PACKED: else markDirty(index);
+
+// copyRange() uploads [start, start + count) with a single call. The items
+// are packed first with the Item storage.
+// CHECK: public synchronized void copyRange(int start, int count) {
+// ITEM-NEXT: if (mItemArray == null) return;
+// ITEM-NEXT: for (int ct = start; ct < start + count; ct++) if (mItemArray[ct] != null) copyToArray(mItemArray[ct], ct);
+// CHECK-NEXT: if (mIOBuffer == null) return;
+// CHECK-NEXT: int size = count * 8;
+// CHECK: mAllocation.setFromFieldPacker(0, mIOBuffer);
+// CHECK: System.arraycopy(mIOBuffer.getData(), start * 8, mRangeBuffer.getData(), 0, size);
+// CHECK: mAllocation.setFromFieldPacker(start, mRangeBuffer);
+
+// flush() uploads each run of consecutive modified items with copyRange().
+// CHECK: private void markDirty(int index) {
+// CHECK-NEXT: if (mDirty == null) mDirty = new java.util.BitSet(getType().getX() /* count */);
+// CHECK-NEXT: mDirty.set(index);
+// CHECK: public synchronized void flush() {
+// CHECK-NEXT: if (mDirty == null) return;
+// CHECK-NEXT: for (int start = mDirty.nextSetBit(0); start >= 0; ) {
+// CHECK-NEXT: int end = mDirty.nextClearBit(start);
+// CHECK-NEXT: copyRange(start, end - start);
+// CHECK-NEXT: start = mDirty.nextSetBit(end);
+// CHECK-NEXT: }
+// CHECK-NEXT: mDirty.clear();
+
+// copyAll() uploads everything, so nothing is left dirty.
+// CHECK: public synchronized void copyAll() {
+// CHECK: if (mDirty != null) mDirty.clear();
+
+#pragma version(1)
+#pragma rs java_package_name(foo)
+
+typedef struct Point {
+    float x;
+    int y;
+} Point_t;
+
+Point_t *points;
@@ -186,6 +186,8 @@ void slang::ParseArguments(llvm::SmallVectorImpl<const char *> &ArgVector,
           << OptParser->getOptionName(OPT_bitcode_storage)
           << BitcodeStorageValue;
 
+    Opts.mCompressBitcode = Args->hasArg(OPT_compress_bitcode);
+
     if (Args->hasArg(OPT_reflect_cpp)) {
       Opts.mBitcodeStorage = slang::BCST_CPP_CODE;
       // mJavaReflectionPathBase can be set for C++ reflected builds.
@@ -195,6 +197,13 @@ void slang::ParseArguments(llvm::SmallVectorImpl<const char *> &ArgVector,
       }
     }
 
+    Opts.mReflectCppIncbin = Args->hasArg(OPT_reflect_cpp_incbin);
+    Opts.mReflectPackedFields = Args->hasArg(OPT_reflect_packed_fields);
+    Opts.mElideRedundantSet = Args->hasArg(OPT_elide_redundant_set);
+    Opts.mLayoutReport = Args->hasArg(OPT_layout_report);
+    Opts.mWarnUntiledReads = Args->hasArg(OPT_warn_untiled_reads);
+    Opts.mODRDatabaseDir = Args->getLastArgValue(OPT_odr_type_db);
+
     Opts.mDependencyOutputDir =
         Args->getLastArgValue(OPT_output_dep_dir, Opts.mBitcodeOutputDir);
     Opts.mAdditionalDepTargets =
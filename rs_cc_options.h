@@ -69,6 +69,31 @@ class RSCCOptions {
   // Where to store the generated bitcode (resource, Java source, C++ source).
   slang::BitCodeStorageType mBitcodeStorage;
 
+  // Store the bitcode compressed with zlib.
+  bool mCompressBitcode;
+
+  // Pull the bitcode into the reflected C++ classes with a companion assembly
+  // file (.incbin) rather than a byte array initializer.
+  bool mReflectCppIncbin;
+
+  // Reflect the ScriptField_* classes backed by a packed buffer rather than
+  // by an array of Item objects.
+  bool mReflectPackedFields;
+
+  // Skip the runtime call in the reflected scalar setters when the new value
+  // equals the last one set.
+  bool mElideRedundantSet;
+
+  // Print a layout (padding) report of the exported structs.
+  bool mLayoutReport;
+
+  // Warn about the kernel reads whose footprint cannot be determined.
+  bool mWarnUntiledReads;
+
+  // The directory holding the persistent per-package ODR type databases. If
+  // empty, the ODR check only spans the input files of this invocation.
+  std::string mODRDatabaseDir;
+
   // Emit output dependency file for each input file.
   bool mEmitDependency;
 
@@ -102,6 +127,7 @@ class RSCCOptions {
     mOutputType = slang::Slang::OT_Bitcode;
     mBitWidth = 32;
     mBitcodeStorage = slang::BCST_APK_RESOURCE;
+    mCompressBitcode = false;
     mEmitDependency = 0;
     mShowHelp = 0;
     mShowVersion = 0;
@@ -110,6 +136,11 @@ class RSCCOptions {
     mOptimizationLevel = llvm::CodeGenOpt::Aggressive;
     mVerbose = false;
     mEmit3264 = false;
+    mReflectCppIncbin = false;
+    mReflectPackedFields = false;
+    mElideRedundantSet = false;
+    mLayoutReport = false;
+    mWarnUntiledReads = false;
   }
 };
 
@@ -470,6 +470,17 @@ void Slang::setOptimizationLevel(llvm::CodeGenOpt::Level OptimizationLevel) {
   CodeGenOpts.OptimizationLevel = OptimizationLevel;
 }
 
+void Slang::setHalfSupport(bool Enabled) {
+  // "half" is a storage-only type, as in OpenCL, which may be passed to and
+  // returned from functions (i.e., be a kernel input or output).
+  LangOpts.Half = Enabled;
+  LangOpts.HalfArgsAndReturns = Enabled;
+}
+
+void Slang::printDiagnostics(const std::string &Diagnostics) {
+  llvm::errs() << Diagnostics;
+}
+
 void Slang::reset(bool SuppressWarnings) {
   // Always print diagnostics if we had an error occur, but don't print
   // warnings if we suppressed them (i.e. we are doing the 64-bit compile after
@@ -479,7 +490,7 @@ void Slang::reset(bool SuppressWarnings) {
   // the 32-bit and 64-bit compiles, but that is a more substantial feature.
   // Bug: 17052573
   if (!SuppressWarnings || mDiagEngine->hasErrorOccurred()) {
-    llvm::errs() << mDiagClient->str();
+    printDiagnostics(mDiagClient->str());
   }
   mDiagEngine->Reset();
   mDiagClient->reset();
@@ -158,6 +158,9 @@ class Slang : public clang::ModuleLoader {
   virtual void initPreprocessor() {}
   virtual void initASTContext() {}
 
+  // Print the diagnostics of the last input file (called by reset()).
+  virtual void printDiagnostics(const std::string &Diagnostics);
+
   virtual clang::ASTConsumer *
     createBackend(const clang::CodeGenOptions& CodeGenOpts,
                   llvm::raw_ostream *OS,
@@ -233,6 +236,10 @@ class Slang : public clang::ModuleLoader {
 
   void setOptimizationLevel(llvm::CodeGenOpt::Level OptimizationLevel);
 
+  // Make "half" a keyword for the next compilations. It is otherwise an
+  // ordinary identifier.
+  void setHalfSupport(bool Enabled);
+
   // Reset the slang compiler state such that it can be reused to compile
   // another file
   virtual void reset(bool SuppressWarnings = false);
@@ -95,7 +95,7 @@ void Backend::CreateModulePasses() {
 
     PMBuilder.populateModulePassManager(*mPerModulePasses);
     // Add a pass to strip off unknown/unsupported attributes.
-    mPerModulePasses->add(createStripUnknownAttributesPass());
+    mPerModulePasses->add(createStripUnknownAttributesPass(getTargetAPI()));
   }
 }
 
@@ -317,6 +317,8 @@ void Backend::HandleTranslationUnit(clang::ASTContext &Ctx) {
   if (mPerModulePasses)
     mPerModulePasses->run(*mpModule);
 
+  HandleTranslationUnitOptimized(mpModule);
+
   switch (mOT) {
     case Slang::OT_Assembly:
     case Slang::OT_Object: {
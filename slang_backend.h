@@ -98,6 +98,11 @@ class Backend : public clang::ASTConsumer {
   // method, slang will start doing optimization and code generation for @M.
   virtual void HandleTranslationUnitPost(llvm::Module *M) { }
 
+  // This handler will be invoked once the optimization passes have run on @M,
+  // right before the code generation. It suits the analyses that are only
+  // precise on the optimized IR (e.g., once the helpers have been inlined).
+  virtual void HandleTranslationUnitOptimized(llvm::Module *M) { }
+
  public:
   Backend(clang::DiagnosticsEngine *DiagEngine,
           const clang::CodeGenOptions &CodeGenOpts,
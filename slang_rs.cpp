@@ -16,30 +16,47 @@
 
 #include "slang_rs.h"
 
+#include <algorithm>
+#include <cstdio>
 #include <cstring>
+#include <fstream>
 #include <list>
 #include <sstream>
 #include <string>
 #include <utility>
 #include <vector>
 
+#include "clang/Basic/FileManager.h"
 #include "clang/Basic/SourceLocation.h"
+#include "clang/Basic/SourceManager.h"
 
 #include "clang/Frontend/FrontendDiagnostic.h"
 
 #include "clang/Sema/SemaDiagnostic.h"
 
+#include "llvm/Config/llvm-config.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/MathExtras.h"
 #include "llvm/Support/Path.h"
+#include "llvm/Support/raw_ostream.h"
 
 #include "os_sep.h"
 #include "rs_cc_options.h"
 #include "slang_rs_backend.h"
 #include "slang_rs_context.h"
 #include "slang_rs_export_type.h"
+#include "slang_rs_odr_database.h"
 
 #include "slang_rs_reflection.h"
 #include "slang_rs_reflection_cpp.h"
 
+// With threads, the reflection of an input file runs while the next one is
+// compiled. std::thread is not available with every Windows host toolchain.
+#if LLVM_ENABLE_THREADS && !defined(LLVM_ON_WIN32)
+#define SLANG_RS_PIPELINE_REFLECTION
+#include <thread>
+#endif
+
 namespace slang {
 
 #define FS_SUFFIX  "fs"
@@ -76,24 +93,191 @@ bool SlangRS::isFilterscript(const char *Filename) {
   }
 }
 
-bool SlangRS::generateJavaBitcodeAccessor(const std::string &OutputPathBase,
-                                          const std::string &PackageName,
-                                          const std::string *LicenseNote) {
+struct SlangRS::ReflectionJob {
+  // The state of the input file that reflection reads. It is copied since the
+  // compiler moves on to the next input file meanwhile.
+  RSContext *Context;
+  const RSCCOptions *Opts;
+  std::string InputFileName;
+  std::string OutputFileName;
+  std::string Output32FileName;
+
+  // The Java classes to generate, already listed in the dependency file.
+  std::vector<std::string> ClassNames;
+
+  // The record types of Context that checkODR() added to
+  // ReflectedDefinitions. They are kept once the reflection is done.
+  std::list<RSExportRecordType*> Definitions;
+
+  // The output of the reflection, printed once it is done
+  ReflectionMessages Messages;
+
+  bool Success;
+
+#ifdef SLANG_RS_PIPELINE_REFLECTION
+  std::thread Worker;
+#endif
+};
+
+bool SlangRS::generateJavaBitcodeAccessor(const ReflectionJob &Job,
+                                          ReflectionMessages *Messages) {
   RSSlangReflectUtils::BitCodeAccessorContext BCAccessorContext;
 
-  BCAccessorContext.rsFileName = getInputFileName().c_str();
-  BCAccessorContext.bc32FileName = getOutput32FileName().c_str();
-  BCAccessorContext.bc64FileName = getOutputFileName().c_str();
-  BCAccessorContext.reflectPath = OutputPathBase.c_str();
-  BCAccessorContext.packageName = PackageName.c_str();
-  BCAccessorContext.licenseNote = LicenseNote;
+  BCAccessorContext.rsFileName = Job.InputFileName.c_str();
+  BCAccessorContext.bc32FileName = Job.Output32FileName.c_str();
+  BCAccessorContext.bc64FileName = Job.OutputFileName.c_str();
+  BCAccessorContext.reflectPath = Job.Opts->mJavaReflectionPathBase.c_str();
+  BCAccessorContext.packageName =
+      Job.Context->getReflectJavaPackageName().c_str();
+  BCAccessorContext.licenseNote = Job.Context->getLicenseNote();
   BCAccessorContext.bcStorage = BCST_JAVA_CODE;   // Must be BCST_JAVA_CODE
-  BCAccessorContext.verbose = false;
+  BCAccessorContext.verbose = Job.Context->getVerbose();
+  BCAccessorContext.compress = Job.Opts->mCompressBitcode;
+  BCAccessorContext.messages = Messages;
 
   return RSSlangReflectUtils::GenerateJavaBitCodeAccessor(BCAccessorContext);
 }
 
+bool SlangRS::reflect(const ReflectionJob &Job, ReflectionMessages *Messages) {
+  const RSCCOptions &Opts = *Job.Opts;
+
+  if (Opts.mBitcodeStorage == BCST_CPP_CODE) {
+    RSReflectionCpp R(Job.Context, Messages, Opts.mJavaReflectionPathBase,
+                      Job.InputFileName, Job.OutputFileName,
+                      Opts.mReflectCppIncbin, Opts.mCompressBitcode);
+    return R.reflect();
+  }
+
+  std::vector<std::string> GeneratedFileNames;
+  RSReflectionJava R(Job.Context, Messages, &GeneratedFileNames,
+                     Opts.mJavaReflectionPathBase, Job.InputFileName,
+                     Job.OutputFileName,
+                     Opts.mBitcodeStorage == BCST_JAVA_CODE,
+                     Opts.mReflectPackedFields,
+                     Opts.mElideRedundantSet,
+                     Opts.mCompressBitcode);
+  if (!R.reflect()) {
+    // TODO Is this needed or will the error message have been printed
+    // already? and why not for the C++ case?
+    Messages->err() << "RSContext::reflectToJava : failed to do reflection ("
+                    << R.getLastError() << ")\n";
+    return false;
+  }
+  slangAssert((GeneratedFileNames == Job.ClassNames) &&
+              "Reflected classes differ from the dependency file targets");
+
+  if ((Opts.mOutputType == Slang::OT_Bitcode) &&
+      (Opts.mBitcodeStorage == BCST_JAVA_CODE) &&
+      !generateJavaBitcodeAccessor(Job, Messages)) {
+    return false;
+  }
+
+  return true;
+}
+
+void SlangRS::runReflection(ReflectionJob *Job) {
+  Job->Success = reflect(*Job, &Job->Messages);
+}
+
+void SlangRS::startReflection(ReflectionJob *Job) {
+  slangAssert((mPendingReflection == nullptr) &&
+              "Previous reflection still pending");
+
+  // The LLVM types of the exported types are computed lazily in the
+  // LLVMContext shared with the compilation of the next input file: create
+  // them now rather than concurrently from the reflection.
+  for (RSContext::ExportableList::iterator I = mRSContext->exportable_begin(),
+          E = mRSContext->exportable_end();
+       I != E;
+       I++) {
+    if ((*I)->getKind() == RSExportable::EX_TYPE)
+      static_cast<RSExportType *>(*I)->getLLVMType();
+  }
+
+  Job->Context = mRSContext;
+  Job->Definitions.swap(mNewDefinitions);
+  mRSContext = nullptr;
+  mPendingReflection = Job;
+
+#ifdef SLANG_RS_PIPELINE_REFLECTION
+  Job->Worker = std::thread(runReflection, Job);
+#else
+  runReflection(Job);
+#endif
+}
+
+bool SlangRS::finishPendingReflection() {
+  if (mPendingReflection == nullptr)
+    return true;
+
+  ReflectionJob *Job = mPendingReflection;
+  mPendingReflection = nullptr;
+#ifdef SLANG_RS_PIPELINE_REFLECTION
+  Job->Worker.join();
+#endif
+  bool Success = Job->Success;
+  keepDefinitions(&Job->Definitions);
+  Job->Messages.print();
+  delete Job->Context;
+  delete Job;
+
+  llvm::errs() << mDeferredDiagnostics;
+  mDeferredDiagnostics.clear();
+
+  return Success;
+}
+
+void SlangRS::keepDefinitions(std::list<RSExportRecordType*> *Definitions) {
+  // Take the ownership of the record types such that they won't be freed in
+  // ~RSContext().
+  for (std::list<RSExportRecordType*>::iterator I = Definitions->begin(),
+          E = Definitions->end();
+       I != E;
+       I++) {
+    (*I)->keep();
+  }
+  Definitions->clear();
+}
+
+void SlangRS::printDiagnostics(const std::string &Diagnostics) {
+  if (mPendingReflection != nullptr) {
+    mDeferredDiagnostics += Diagnostics;
+  } else {
+    llvm::errs() << Diagnostics;
+  }
+}
+
+bool SlangRS::compressBitcodeResource() {
+  const std::string &BCFile = getOutputFileName();
+  RSSlangReflectUtils::BitCodePayload Payload;
+  ReflectionMessages Messages;
+  bool Success =
+      RSSlangReflectUtils::ReadBitCodePayload(BCFile, true, mVerbose,
+                                              &Payload, &Messages);
+  Messages.print();
+  if (!Success)
+    return false;
+
+  std::ofstream OS(BCFile.c_str(), std::ios::out | std::ios::binary |
+                                       std::ios::trunc);
+  uint32_t Size = Payload.uncompressedSize;
+  const char Header[] = { static_cast<char>(Size >> 24),
+                          static_cast<char>(Size >> 16),
+                          static_cast<char>(Size >> 8),
+                          static_cast<char>(Size) };
+  OS.write(Header, sizeof(Header));
+  OS.write(Payload.data.data(), Payload.data.size());
+  OS.close();
+  if (!OS) {
+    fprintf(stderr, "Error: could not write file %s\n", BCFile.c_str());
+    return false;
+  }
+  return true;
+}
+
 bool SlangRS::checkODR(const char *CurInputFile) {
+  RSODRDatabase::SignatureList Signatures;
+
   for (RSContext::ExportableList::iterator I = mRSContext->exportable_begin(),
           E = mRSContext->exportable_end();
        I != E;
@@ -113,6 +297,14 @@ bool SlangRS::checkODR(const char *CurInputFile) {
     if (ERT->isArtificial())
       continue;
 
+    // Compute the signature before ERT->keep() detaches it from mRSContext.
+    if (!mODRDatabaseDir.empty()) {
+      RSODRDatabase::TypeSignature Sig;
+      Sig.TypeName = ERT->getName();
+      Sig.Signature = RSODRDatabase::GetSignature(ERT);
+      Signatures.push_back(Sig);
+    }
+
     // Key to lookup ERT in ReflectedDefinitions
     llvm::StringRef RDKey(ERT->getName());
     ReflectedDefinitionListTy::const_iterator RD =
@@ -171,13 +363,181 @@ bool SlangRS::checkODR(const char *CurInputFile) {
       if (!ReflectedDefinitions.insert(ME))
         delete ME;
 
-      // Take the ownership of ERT such that it won't be freed in ~RSContext().
-      ERT->keep();
+      // ERT is kept once the reflection no longer reads it: keep() detaches
+      // it from mRSContext (and its LLVM type).
+      mNewDefinitions.push_back(ERT);
     }
   }
+
+  if (!mODRDatabaseDir.empty())
+    return checkPersistentODR(CurInputFile, Signatures);
+
   return true;
 }
 
+bool SlangRS::checkPersistentODR(
+    const char *CurInputFile,
+    const RSODRDatabase::SignatureList &Types) {
+  // Struct layouts differ between 32-bit and 64-bit targets (e.g. RS object
+  // handles), so each bitness gets its own database.
+  const std::string DatabasePath =
+      JoinPath(mODRDatabaseDir,
+               mRSContext->getReflectJavaPackageName() +
+               (mRSContext->is64Bit() ? ".64" : ".32") + ".rsodr");
+
+  // The files read to compile CurInputFile. Their modification invalidates
+  // the entries recorded for it, including those of the types defined in a
+  // shared header.
+  RSODRDatabase::FileList Dependencies;
+  clang::SourceManager &SM = getSourceManager();
+  for (clang::SourceManager::fileinfo_iterator I = SM.fileinfo_begin(),
+          E = SM.fileinfo_end();
+       I != E;
+       I++) {
+    // Skip the buffers that are not backed by a file (e.g., the RS version
+    // header).
+    const char *Name = I->first->getName();
+    if (llvm::sys::fs::exists(Name))
+      Dependencies.push_back(Name);
+  }
+
+  RSODRDatabase Database(DatabasePath);
+  RSODRDatabase::ConflictList Conflicts;
+  std::string Error;
+
+  if (!Database.checkAndUpdate(CurInputFile, Types, Dependencies, &Conflicts,
+                               &Error)) {
+    getDiagnostics().Report(mDiagErrorODRDatabase) << DatabasePath << Error;
+    return false;
+  }
+
+  for (RSODRDatabase::ConflictList::const_iterator I = Conflicts.begin(),
+          E = Conflicts.end();
+       I != E;
+       I++) {
+    getDiagnostics().Report(mDiagErrorODR) << I->TypeName
+                                           << getInputFileName()
+                                           << I->File;
+  }
+
+  return Conflicts.empty();
+}
+
+namespace {
+
+typedef std::vector<const RSExportRecordType::Field*> FieldVector;
+
+// Return the number of bytes of @ET that hold data. Padding inside nested
+// records and the unused element of 3-element vectors are not counted.
+size_t GetUsedBytes(const RSExportType *ET) {
+  switch (ET->getClass()) {
+    case RSExportType::ExportClassConstantArray: {
+      const RSExportConstantArrayType *ECAT =
+          static_cast<const RSExportConstantArrayType*>(ET);
+      return ECAT->getSize() * GetUsedBytes(ECAT->getElementType());
+    }
+    case RSExportType::ExportClassRecord: {
+      const RSExportRecordType *ERT =
+          static_cast<const RSExportRecordType*>(ET);
+      size_t UsedBytes = 0;
+      for (RSExportRecordType::const_field_iterator
+              I = ERT->fields_begin(), E = ERT->fields_end();
+           I != E;
+           I++) {
+        UsedBytes += GetUsedBytes((*I)->getType());
+      }
+      return UsedBytes;
+    }
+    default: {
+      return ET->getStoreSize();
+    }
+  }
+}
+
+// Lay out the fields of @ERT in the order given by @Fields and return the
+// number of padding bytes of the resulting struct. Field alignments come from
+// the field declarations, so aligned attributes are honored.
+size_t ComputeRecordPadding(const RSExportRecordType *ERT,
+                            const FieldVector &Fields) {
+  size_t Offset = 0, MaxAlign = ERT->getAlignment();
+  for (FieldVector::const_iterator I = Fields.begin(), E = Fields.end();
+       I != E;
+       I++) {
+    size_t Align = (*I)->getAlignment();
+    Offset = llvm::RoundUpToAlignment(Offset, Align) +
+             (*I)->getType()->getAllocSize();
+    MaxAlign = std::max(MaxAlign, Align);
+  }
+  return llvm::RoundUpToAlignment(Offset, MaxAlign) - GetUsedBytes(ERT);
+}
+
+bool FieldHasGreaterAlignment(const RSExportRecordType::Field *A,
+                              const RSExportRecordType::Field *B) {
+  return A->getAlignment() > B->getAlignment();
+}
+
+bool RecordHasLessName(const RSExportRecordType *A,
+                       const RSExportRecordType *B) {
+  return A->getName() < B->getName();
+}
+
+}  // namespace
+
+void SlangRS::reportRecordLayouts() {
+  std::vector<const RSExportRecordType*> Records;
+  for (RSContext::const_export_type_iterator
+          I = mRSContext->export_types_begin(),
+          E = mRSContext->export_types_end();
+       I != E;
+       I++) {
+    const RSExportType *ET = I->getValue();
+    if (ET->getClass() != RSExportType::ExportClassRecord)
+      continue;
+    const RSExportRecordType *ERT = static_cast<const RSExportRecordType*>(ET);
+    if (!ERT->isArtificial())
+      Records.push_back(ERT);
+  }
+  // Keep the report stable regardless of the hashing in ExportTypeMap.
+  std::sort(Records.begin(), Records.end(), RecordHasLessName);
+
+  for (std::vector<const RSExportRecordType*>::const_iterator
+          I = Records.begin(), E = Records.end();
+       I != E;
+       I++) {
+    const RSExportRecordType *ERT = *I;
+    FieldVector Fields(ERT->fields_begin(), ERT->fields_end());
+
+    // The record size and the field offsets come from clang's record layout.
+    size_t Padding = ERT->getAllocSize() - GetUsedBytes(ERT);
+
+    printf("%s: struct '%s': size %zu, alignment %zu, padding %zu bytes\n",
+           getInputFileName().c_str(), ERT->getName().c_str(),
+           ERT->getAllocSize(), ERT->getAlignment(), Padding);
+
+    if (Padding == 0 || ERT->isPacked())
+      continue;
+
+    // Ordering the fields by decreasing alignment minimizes the padding for
+    // naturally aligned types. Ties keep their declaration order.
+    FieldVector Sorted(Fields);
+    std::stable_sort(Sorted.begin(), Sorted.end(), FieldHasGreaterAlignment);
+    size_t SortedPadding = ComputeRecordPadding(ERT, Sorted);
+    if (SortedPadding >= Padding) {
+      printf("  field order already minimizes padding\n");
+      continue;
+    }
+
+    printf("  suggested field order:");
+    for (FieldVector::const_iterator FI = Sorted.begin(), FE = Sorted.end();
+         FI != FE;
+         FI++) {
+      printf("%s %s", (FI == Sorted.begin()) ? "" : ",",
+             (*FI)->getName().c_str());
+    }
+    printf(" (padding %zu bytes)\n", SortedPadding);
+  }
+}
+
 void SlangRS::initDiagnostic() {
   clang::DiagnosticsEngine &DiagEngine = getDiagnostics();
 
@@ -206,6 +566,17 @@ void SlangRS::initDiagnostic() {
     DiagEngine.getCustomDiagID(
       clang::DiagnosticsEngine::Error,
       "target API level '%0' is out of range ('%1' - '%2')");
+
+  mDiagErrorODRDatabase =
+    DiagEngine.getCustomDiagID(
+      clang::DiagnosticsEngine::Error,
+      "unable to update ODR type database '%0': %1");
+
+  mDiagErrorCompressBitcodeTargetAPI =
+    DiagEngine.getCustomDiagID(
+      clang::DiagnosticsEngine::Error,
+      "compressed bitcode requires target API level '%1' or later for Java "
+      "reflection (target API level is '%0')");
 }
 
 void SlangRS::initPreprocessor() {
@@ -225,6 +596,7 @@ void SlangRS::initASTContext() {
                              &mPragmas,
                              mTargetAPI,
                              mVerbose);
+  mRSContext->setWarnUntiledReads(mWarnUntiledReads);
 }
 
 clang::ASTConsumer
@@ -267,7 +639,8 @@ bool SlangRS::IsLocInRSHeaderFile(const clang::SourceLocation &Loc,
 
 SlangRS::SlangRS()
   : Slang(), mRSContext(nullptr), mAllowRSPrefix(false), mTargetAPI(0),
-    mVerbose(false), mIsFilterscript(false) {
+    mVerbose(false), mIsFilterscript(false), mWarnUntiledReads(false),
+    mPendingReflection(nullptr) {
 }
 
 bool SlangRS::compile(
@@ -318,8 +691,24 @@ bool SlangRS::compile(
     return false;
   }
 
+  // Only the development runtime has FLOAT_16 Elements. Older scripts may
+  // still use "half" as an identifier.
+  setHalfSupport(mTargetAPI == SLANG_DEVELOPMENT_TARGET_API);
+
+  // The ScriptC constructor taking the bitcode, which the reflected Java uses
+  // to pass the inflated bitcode, appeared in L.
+  if (Opts.mCompressBitcode && (Opts.mBitcodeStorage != BCST_CPP_CODE) &&
+      (mTargetAPI < SLANG_L_TARGET_API)) {
+    getDiagnostics().Report(mDiagErrorCompressBitcodeTargetAPI) << mTargetAPI
+        << SLANG_L_TARGET_API;
+    return false;
+  }
+
   mVerbose = Opts.mVerbose;
 
+  mODRDatabaseDir = Opts.mODRDatabaseDir;
+  mWarnUntiledReads = Opts.mWarnUntiledReads;
+
   // Skip generation of warnings a second time if we are doing more than just
   // a single pass over the input file.
   bool SuppressAllWarnings = (Opts.mOutputType != Slang::OT_Dependency);
@@ -332,7 +721,7 @@ bool SlangRS::compile(
     Output32File = IOFile32Iter->second;
 
     // We suppress warnings (via reset) if we are doing a second compilation.
-    reset(CompileSecondTimeFor64Bit);
+    resetInput(CompileSecondTimeFor64Bit);
 
     if (!setInputSource(InputFile))
       return false;
@@ -347,6 +736,16 @@ bool SlangRS::compile(
     if (Slang::compile() > 0)
       return false;
 
+    // The previous input file was reflected while this one was compiled.
+    if (!finishPendingReflection())
+      return false;
+
+    if (Opts.mCompressBitcode &&
+        (Opts.mOutputType == Slang::OT_Bitcode) &&
+        (Opts.mBitcodeStorage == BCST_APK_RESOURCE) &&
+        !compressBitcodeResource())
+      return false;
+
     if (!Opts.mJavaReflectionPackageName.empty()) {
       mRSContext->setReflectJavaPackageName(Opts.mJavaReflectionPackageName);
     }
@@ -359,34 +758,30 @@ bool SlangRS::compile(
       // 64-bit path.
       doReflection = false;
     }
+    if (Opts.mLayoutReport && doReflection) {
+      reportRecordLayouts();
+    }
+
+    // Check the ODR before the reflection takes the RSContext over.
+    if (!checkODR(InputFile))
+      return false;
+
     if (Opts.mOutputType != Slang::OT_Dependency && doReflection) {
+      ReflectionJob *Job = new ReflectionJob();
+      Job->Opts = &Opts;
+      Job->InputFileName = getInputFileName();
+      Job->OutputFileName = getOutputFileName();
+      Job->Output32FileName = getOutput32FileName();
 
-      if (Opts.mBitcodeStorage == BCST_CPP_CODE) {
-          RSReflectionCpp R(mRSContext, Opts.mJavaReflectionPathBase,
-                            getInputFileName(), getOutputFileName());
-          if (!R.reflect()) {
-            return false;
-          }
-      } else {
+      if (Opts.mBitcodeStorage != BCST_CPP_CODE) {
         if (!Opts.mRSPackageName.empty()) {
           mRSContext->setRSPackageName(Opts.mRSPackageName);
         }
 
-        RSReflectionJava R(mRSContext, &mGeneratedFileNames,
-                           Opts.mJavaReflectionPathBase, getInputFileName(),
-                           getOutputFileName(),
-                           Opts.mBitcodeStorage == BCST_JAVA_CODE);
-        if (!R.reflect()) {
-          // TODO Is this needed or will the error message have been printed
-          // already? and why not for the C++ case?
-          fprintf(stderr, "RSContext::reflectToJava : failed to do reflection "
-                          "(%s)\n",
-                  R.getLastError());
-          return false;
-        }
-
+        RSReflectionJava::GetGeneratedClassNames(mRSContext, getInputFileName(),
+                                                 &Job->ClassNames);
         for (std::vector<std::string>::const_iterator
-                 I = mGeneratedFileNames.begin(), E = mGeneratedFileNames.end();
+                 I = Job->ClassNames.begin(), E = Job->ClassNames.end();
              I != E;
              I++) {
           std::string ReflectedName = RSSlangReflectUtils::ComputePackagedPath(
@@ -394,15 +789,9 @@ bool SlangRS::compile(
               (RealPackageName + OS_PATH_SEPARATOR_STR + *I).c_str());
           appendGeneratedFileName(ReflectedName + ".java");
         }
-
-        if ((Opts.mOutputType == Slang::OT_Bitcode) &&
-            (Opts.mBitcodeStorage == BCST_JAVA_CODE) &&
-            !generateJavaBitcodeAccessor(Opts.mJavaReflectionPathBase,
-                                         RealPackageName.c_str(),
-                                         mRSContext->getLicenseNote())) {
-          return false;
-        }
       }
+
+      startReflection(Job);
     }
 
     if (Opts.mEmitDependency) {
@@ -411,6 +800,16 @@ bool SlangRS::compile(
 
       setDepTargetBC(BCOutputFile);
 
+      // The companion assembly file of -reflect-c++-incbin pulls the bitcode
+      // in, so whatever assembles it must also depend on the bitcode.
+      std::string BitCodeAssemblyFile;
+      if ((Opts.mOutputType != Slang::OT_Dependency) && doReflection &&
+          (Opts.mBitcodeStorage == BCST_CPP_CODE) && Opts.mReflectCppIncbin) {
+        BitCodeAssemblyFile = RSReflectionCpp::GetBitCodeAssemblyFilePath(
+            Opts.mJavaReflectionPathBase, getInputFileName());
+        appendGeneratedFileName(BitCodeAssemblyFile);
+      }
+
       if (!setDepOutput(DepOutputFile))
         return false;
 
@@ -419,6 +818,16 @@ bool SlangRS::compile(
       }
       if (generateDepFile() > 0)
         return false;
+      if (!BitCodeAssemblyFile.empty()) {
+        std::ofstream DepFile(DepOutputFile, std::ios::out | std::ios::app);
+        DepFile << "\n" << BitCodeAssemblyFile << ": " << BCOutputFile << "\n";
+        DepFile.close();
+        if (!DepFile) {
+          getDiagnostics().Report(clang::diag::err_fe_error_opening)
+              << DepOutputFile << "failed to append the bitcode dependency";
+          return false;
+        }
+      }
       if (SuppressAllWarnings) {
         getDiagnostics().setSuppressAllDiagnostics(false);
       }
@@ -426,24 +835,30 @@ bool SlangRS::compile(
       DepFileIter++;
     }
 
-    if (!checkODR(InputFile))
-      return false;
-
     IOFile64Iter++;
     IOFile32Iter++;
   }
 
-  return true;
+  return finishPendingReflection();
 }
 
-void SlangRS::reset(bool SuppressWarnings) {
+void SlangRS::resetInput(bool SuppressWarnings) {
+  keepDefinitions(&mNewDefinitions);
   delete mRSContext;
   mRSContext = nullptr;
-  mGeneratedFileNames.clear();
   Slang::reset(SuppressWarnings);
 }
 
+void SlangRS::reset(bool SuppressWarnings) {
+  // Let the output of the pending reflection precede the diagnostics of the
+  // current input file.
+  finishPendingReflection();
+  resetInput(SuppressWarnings);
+}
+
 SlangRS::~SlangRS() {
+  finishPendingReflection();
+  keepDefinitions(&mNewDefinitions);
   delete mRSContext;
   for (ReflectedDefinitionListTy::iterator I = ReflectedDefinitions.begin(),
           E = ReflectedDefinitions.end();
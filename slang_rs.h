@@ -26,6 +26,7 @@
 
 #include "llvm/ADT/StringMap.h"
 
+#include "slang_rs_odr_database.h"
 #include "slang_rs_reflect_utils.h"
 #include "slang_version.h"
 
@@ -51,9 +52,24 @@ class SlangRS : public Slang {
   unsigned mDiagErrorInvalidOutputDepParameter;
   unsigned mDiagErrorODR;
   unsigned mDiagErrorTargetAPIRange;
+  unsigned mDiagErrorODRDatabase;
+  unsigned mDiagErrorCompressBitcodeTargetAPI;
 
-  // Collect generated filenames (without the .java) for dependency generation
-  std::vector<std::string> mGeneratedFileNames;
+  // Directory of the persistent ODR type databases (empty if disabled)
+  std::string mODRDatabaseDir;
+
+  // Warn about the kernel reads at data-dependent coordinates
+  bool mWarnUntiledReads;
+
+  // The reflection of an input file. It runs on a worker thread while the
+  // next input file is compiled, and owns the RSContext of its input file.
+  struct ReflectionJob;
+  ReflectionJob *mPendingReflection;
+
+  // The diagnostics of the input file whose reflection is pending. They are
+  // printed once the reflection has completed so that the output keeps the
+  // order of a sequential compilation.
+  std::string mDeferredDiagnostics;
 
   // FIXME: Should be std::list<RSExportable *> here. But currently we only
   //        check ODR on record type.
@@ -65,14 +81,51 @@ class SlangRS : public Slang {
   typedef llvm::StringMap<ReflectedDefinitionTy> ReflectedDefinitionListTy;
   ReflectedDefinitionListTy ReflectedDefinitions;
 
-  bool generateJavaBitcodeAccessor(const std::string &OutputPathBase,
-                                   const std::string &PackageName,
-                                   const std::string *LicenseNote);
+  // The record types of mRSContext that checkODR() added to
+  // ReflectedDefinitions but that are not kept yet.
+  std::list<RSExportRecordType*> mNewDefinitions;
+
+  // Keep (see RSExportable::keep()) and clear @Definitions.
+  static void keepDefinitions(std::list<RSExportRecordType*> *Definitions);
+
+  static bool generateJavaBitcodeAccessor(const ReflectionJob &Job,
+                                          ReflectionMessages *Messages);
+
+  // Reflect (and embed the bitcode of) the input file of Job, reporting the
+  // messages to Messages.
+  static bool reflect(const ReflectionJob &Job, ReflectionMessages *Messages);
+  static void runReflection(ReflectionJob *Job);
+
+  // Hand the current RSContext over to Job and start reflect(Job).
+  void startReflection(ReflectionJob *Job);
+
+  // Wait for the pending reflection (if any), then print its messages and the
+  // diagnostics deferred meanwhile. Returns false if the reflection failed.
+  bool finishPendingReflection();
+
+  // Reset the state of the current input file without waiting for the
+  // pending reflection.
+  void resetInput(bool SuppressWarnings);
+
+  // Replace the bitcode output file (a raw resource) by its zlib-compressed
+  // contents, preceded by the size of the bitcode as a big-endian 32-bit
+  // integer.
+  bool compressBitcodeResource();
 
   // CurInputFile is the pointer to a char array holding the input filename
   // and is valid before compile() ends.
   bool checkODR(const char *CurInputFile);
 
+  // Check the signatures @Types of the exported record types of the current
+  // input file against the persistent ODR type database of its reflection
+  // package, and record them there.
+  bool checkPersistentODR(const char *CurInputFile,
+                          const RSODRDatabase::SignatureList &Types);
+
+  // Print the size, alignment and padding of the exported structs of the
+  // current input file, and the field order that would minimize the padding.
+  void reportRecordLayouts();
+
   // Returns true if this is a Filterscript file.
   static bool isFilterscript(const char *Filename);
 
@@ -80,6 +133,7 @@ class SlangRS : public Slang {
   virtual void initDiagnostic();
   virtual void initPreprocessor();
   virtual void initASTContext();
+  virtual void printDiagnostics(const std::string &Diagnostics);
 
   virtual clang::ASTConsumer
   *createBackend(const clang::CodeGenOptions& CodeGenOpts,
@@ -16,19 +16,30 @@
 
 #include "slang_rs_backend.h"
 
+#include <iterator>
 #include <string>
 #include <vector>
 
 #include "clang/AST/ASTContext.h"
+#include "clang/AST/Attr.h"
 #include "clang/Frontend/CodeGenOptions.h"
 
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/ADT/SmallPtrSet.h"
 #include "llvm/ADT/Twine.h"
 #include "llvm/ADT/StringExtras.h"
 
+#include "llvm/Analysis/CFG.h"
+
+#include "llvm/IR/CallSite.h"
 #include "llvm/IR/Constant.h"
 #include "llvm/IR/Constants.h"
+#include "llvm/IR/DataLayout.h"
 #include "llvm/IR/DerivedTypes.h"
 #include "llvm/IR/Function.h"
+#include "llvm/IR/InstIterator.h"
+#include "llvm/IR/Instructions.h"
+#include "llvm/IR/IntrinsicInst.h"
 #include "llvm/IR/IRBuilder.h"
 #include "llvm/IR/Metadata.h"
 #include "llvm/IR/Module.h"
@@ -40,12 +51,506 @@
 #include "slang_rs_context.h"
 #include "slang_rs_export_foreach.h"
 #include "slang_rs_export_func.h"
+#include "slang_rs_export_reduce.h"
 #include "slang_rs_export_type.h"
 #include "slang_rs_export_var.h"
 #include "slang_rs_metadata.h"
 
 namespace slang {
 
+namespace {
+
+// Call @F with the parameters stored in the packet @Packet points to. The
+// parameters for which @isStructInput is true are passed by reference.
+llvm::CallInst *genUnpackedCall(llvm::IRBuilder<> *IB, llvm::Function *F,
+                                llvm::Value *Packet,
+                                const std::vector<bool> &isStructInput) {
+  llvm::Type *Int32Ty = llvm::Type::getInt32Ty(F->getContext());
+  llvm::SmallVector<llvm::Value*, 6> Params;
+  llvm::Value *Idx[2];
+
+  Idx[0] = llvm::ConstantInt::get(Int32Ty, 0);
+
+  // getelementptr and load instruction for all elements in the packet
+  for (size_t i = 0; i < isStructInput.size(); i++) {
+    // getelementptr
+    Idx[1] = llvm::ConstantInt::get(Int32Ty, i);
+
+    llvm::Value *Ptr = IB->CreateInBoundsGEP(Packet, Idx);
+
+    // Load is only required for non-struct ptrs
+    if (isStructInput[i]) {
+      Params.push_back(Ptr);
+    } else {
+      llvm::Value *V = IB->CreateLoad(Ptr);
+      Params.push_back(V);
+    }
+  }
+
+  llvm::CallInst *CI = IB->CreateCall(F, Params);
+  CI->setCallingConv(F->getCallingConv());
+  return CI;
+}
+
+typedef llvm::SmallPtrSet<llvm::Function*, 16> FunctionSet;
+
+// Adds to @Writers the functions that may modify the memory @Ptr points to,
+// i.e., those storing to it or passing it to the runtime. Returns false if the
+// address escapes, i.e., it is stored, converted to an integer, passed to a
+// function that is not analyzed or used in the initializer of another global,
+// since any function may then modify it.
+bool CollectWriters(llvm::Value *Ptr, FunctionSet *Writers,
+                    llvm::SmallPtrSet<llvm::Value*, 16> *Visited) {
+  if (!Visited->insert(Ptr))
+    return true;
+
+  for (llvm::Value::use_iterator UI = Ptr->use_begin(), UE = Ptr->use_end();
+       UI != UE;
+       UI++) {
+    llvm::User *U = UI->getUser();
+
+    if (llvm::isa<llvm::ConstantExpr>(U) ||
+        llvm::isa<llvm::GetElementPtrInst>(U) ||
+        llvm::isa<llvm::BitCastInst>(U) ||
+        llvm::isa<llvm::PHINode>(U) ||
+        llvm::isa<llvm::SelectInst>(U)) {
+      if (!CollectWriters(U, Writers, Visited))
+        return false;
+      continue;
+    }
+
+    llvm::Instruction *I = llvm::dyn_cast<llvm::Instruction>(U);
+    if (I == nullptr)
+      return false;
+
+    if (llvm::isa<llvm::LoadInst>(I) || llvm::isa<llvm::ICmpInst>(I))
+      continue;
+
+    // Copying from the variable does not modify it.
+    if (llvm::isa<llvm::MemTransferInst>(I) && (UI->getOperandNo() == 1))
+      continue;
+
+    llvm::Function *Parent = I->getParent()->getParent();
+
+    if (llvm::isa<llvm::StoreInst>(I)) {
+      // Storing the address itself (operand 0) lets it escape.
+      if (UI->getOperandNo() == 0)
+        return false;
+      Writers->insert(Parent);
+      continue;
+    }
+
+    if (llvm::isa<llvm::AtomicRMWInst>(I) ||
+        llvm::isa<llvm::AtomicCmpXchgInst>(I)) {
+      Writers->insert(Parent);
+      continue;
+    }
+
+    llvm::CallSite CS(I);
+    if (!CS)
+      return false;
+
+    // The arguments come first in the operands of calls and invokes.
+    unsigned ArgNo = UI->getOperandNo();
+    if (ArgNo >= CS.arg_size())
+      return false;
+
+    llvm::Function *Callee = llvm::dyn_cast<llvm::Function>(
+        CS.getCalledValue()->stripPointerCasts());
+    if (Callee == nullptr)
+      return false;
+
+    if (Callee->isDeclaration()) {
+      // The runtime functions (e.g., rsSetObject()) and the intrinsics do not
+      // keep the pointers they are passed.
+      Writers->insert(Parent);
+      continue;
+    }
+
+    // Follow the address into the callee.
+    if (Callee->isVarArg() || (ArgNo >= Callee->arg_size()))
+      return false;
+    llvm::Function::arg_iterator AI = Callee->arg_begin();
+    std::advance(AI, ArgNo);
+    if (!CollectWriters(&*AI, Writers, Visited))
+      return false;
+  }
+
+  return true;
+}
+
+// Adds @F and all the functions it may call to @Reachable. Returns false if
+// some of them is called indirectly.
+bool CollectCallees(llvm::Function *F, FunctionSet *Reachable) {
+  if ((F == nullptr) || F->isDeclaration() || !Reachable->insert(F))
+    return true;
+
+  bool Direct = true;
+  for (llvm::inst_iterator I = llvm::inst_begin(F), E = llvm::inst_end(F);
+       I != E;
+       I++) {
+    llvm::CallSite CS(&*I);
+    if (!CS || llvm::isa<llvm::IntrinsicInst>(&*I))
+      continue;
+
+    llvm::Function *Callee = llvm::dyn_cast<llvm::Function>(
+        CS.getCalledValue()->stripPointerCasts());
+    if (Callee == nullptr) {
+      Direct = false;
+    } else if (!CollectCallees(Callee, Reachable)) {
+      Direct = false;
+    }
+  }
+  return Direct;
+}
+
+// Returns the name of the RS function @Name, which is usually mangled since
+// the RS math functions are overloaded (e.g., "_Z3sinDv4_f" gives "sin").
+llvm::StringRef GetUnmangledName(llvm::StringRef Name) {
+  if (!Name.startswith("_Z"))
+    return Name;
+
+  llvm::StringRef Rest = Name.substr(2);
+  size_t NumDigits = Rest.find_first_not_of("0123456789");
+  unsigned Length;
+  if ((NumDigits == 0) || (NumDigits == llvm::StringRef::npos) ||
+      Rest.substr(0, NumDigits).getAsInteger(10, Length)) {
+    return Name;
+  }
+  return Rest.substr(NumDigits, Length);
+}
+
+bool IsTranscendentalFunc(llvm::StringRef Name) {
+  static const char *const TranscendentalFuncs[] = {
+    "acos", "acosh", "acospi", "asin", "asinh", "asinpi", "atan", "atan2",
+    "atan2pi", "atanh", "atanpi", "cbrt", "cos", "cosh", "cospi", "erf",
+    "erfc", "exp", "exp10", "exp2", "expm1", "hypot", "lgamma", "log",
+    "log10", "log1p", "log2", "logb", "pow", "pown", "powr", "rootn", "rsqrt",
+    "sin", "sincos", "sinh", "sinpi", "tan", "tanh", "tanpi", "tgamma"
+  };
+
+  Name = GetUnmangledName(Name);
+  // The native_*() and half_*() variants are cheaper, but still much more
+  // expensive than the arithmetic.
+  if (Name.startswith("native_"))
+    Name = Name.substr(7);
+  else if (Name.startswith("half_"))
+    Name = Name.substr(5);
+
+  for (size_t i = 0;
+       i < sizeof(TranscendentalFuncs) / sizeof(TranscendentalFuncs[0]);
+       i++) {
+    if (Name.equals(TranscendentalFuncs[i]))
+      return true;
+  }
+  return false;
+}
+
+bool IsTranscendentalIntrinsic(llvm::Intrinsic::ID ID) {
+  switch (ID) {
+    case llvm::Intrinsic::cos:
+    case llvm::Intrinsic::exp:
+    case llvm::Intrinsic::exp2:
+    case llvm::Intrinsic::log:
+    case llvm::Intrinsic::log10:
+    case llvm::Intrinsic::log2:
+    case llvm::Intrinsic::pow:
+    case llvm::Intrinsic::powi:
+    case llvm::Intrinsic::sin:
+      return true;
+    default:
+      return false;
+  }
+}
+
+bool IsLaneWiseIntrinsic(llvm::Intrinsic::ID ID) {
+  switch (ID) {
+    case llvm::Intrinsic::ceil:
+    case llvm::Intrinsic::copysign:
+    case llvm::Intrinsic::fabs:
+    case llvm::Intrinsic::floor:
+    case llvm::Intrinsic::fma:
+    case llvm::Intrinsic::fmuladd:
+    case llvm::Intrinsic::nearbyint:
+    case llvm::Intrinsic::rint:
+    case llvm::Intrinsic::sqrt:
+    case llvm::Intrinsic::trunc:
+      return true;
+    default:
+      return false;
+  }
+}
+
+bool IsScalarType(const llvm::Type *T) {
+  return T->isIntegerTy() || T->isFloatingPointTy();
+}
+
+// Returns true if the kernel @F can be widened by CreateWideKernel(), i.e., if
+// it is straight-line code made of lane-wise operations on scalars and of
+// loads of global variables (which are the same for all the lanes).
+// Otherwise, @Reason tells why.
+bool CanWidenKernel(const llvm::Function *F, std::string *Reason) {
+  if (F->size() != 1) {
+    Reason->assign("it has control flow");
+    return false;
+  }
+
+  for (llvm::const_inst_iterator I = llvm::inst_begin(F),
+          E = llvm::inst_end(F);
+       I != E;
+       I++) {
+    const llvm::Instruction *Inst = &*I;
+    if (llvm::isa<llvm::DbgInfoIntrinsic>(Inst) ||
+        llvm::isa<llvm::ReturnInst>(Inst)) {
+      continue;
+    }
+
+    if (const llvm::LoadInst *LI = llvm::dyn_cast<llvm::LoadInst>(Inst)) {
+      const llvm::Value *Ptr = LI->getPointerOperand();
+      if (LI->isVolatile() || !llvm::isa<llvm::Constant>(Ptr) ||
+          !IsScalarType(LI->getType())) {
+        Reason->assign("it loads from memory other than a scalar global");
+        return false;
+      }
+      continue;
+    }
+
+    bool Supported = llvm::isa<llvm::BinaryOperator>(Inst) ||
+                     llvm::isa<llvm::CastInst>(Inst) ||
+                     llvm::isa<llvm::CmpInst>(Inst) ||
+                     llvm::isa<llvm::SelectInst>(Inst);
+    if (const llvm::IntrinsicInst *II =
+            llvm::dyn_cast<llvm::IntrinsicInst>(Inst)) {
+      Supported = IsLaneWiseIntrinsic(II->getIntrinsicID());
+    }
+    if (!Supported) {
+      Reason->assign(std::string("it contains a '") + Inst->getOpcodeName() +
+                     "' instruction");
+      return false;
+    }
+
+    if (!IsScalarType(Inst->getType())) {
+      Reason->assign("it operates on non-scalar values");
+      return false;
+    }
+    for (unsigned i = 0; i < Inst->getNumOperands(); i++) {
+      const llvm::Value *Op = Inst->getOperand(i);
+      if (!IsScalarType(Op->getType()) && !llvm::isa<llvm::Function>(Op)) {
+        Reason->assign("it operates on non-scalar values");
+        return false;
+      }
+    }
+  }
+
+  return true;
+}
+
+// Creates the variant of a kernel that processes @Width consecutive cells at
+// once: each input cell and the result become a vector of @Width lanes, the x
+// coordinate is the one of the first lane and y is unchanged. The kernel must
+// pass CanWidenKernel().
+class KernelWidener {
+ private:
+  llvm::Module *mModule;
+  unsigned mWidth;
+  llvm::IRBuilder<> mBuilder;
+
+  // Values that are the same for all the lanes are kept scalar until used by
+  // a lane-wise operation.
+  llvm::DenseMap<llvm::Value*, llvm::Value*> mScalar;
+  llvm::DenseMap<llvm::Value*, llvm::Value*> mWide;
+
+  llvm::Value *getWide(llvm::Value *V) {
+    llvm::DenseMap<llvm::Value*, llvm::Value*>::iterator I = mWide.find(V);
+    if (I != mWide.end())
+      return I->second;
+
+    llvm::Value *W;
+    if (llvm::Constant *C = llvm::dyn_cast<llvm::Constant>(V)) {
+      W = llvm::ConstantVector::getSplat(mWidth, C);
+    } else {
+      slangAssert(mScalar.count(V) && "Unexpected operand in the kernel!");
+      W = mBuilder.CreateVectorSplat(mWidth, mScalar[V]);
+    }
+    mWide[V] = W;
+    return W;
+  }
+
+  void widenArguments(llvm::Function *F, llvm::Function *WideF) {
+    for (llvm::Function::arg_iterator AI = F->arg_begin(),
+            WAI = WideF->arg_begin(), AE = F->arg_end();
+         AI != AE;
+         AI++, WAI++) {
+      WAI->setName(AI->getName());
+      if (AI->getName().equals("x")) {
+        llvm::SmallVector<llvm::Constant*, 8> Lanes;
+        for (unsigned i = 0; i < mWidth; i++)
+          Lanes.push_back(llvm::ConstantInt::get(AI->getType(), i));
+        mWide[AI] = mBuilder.CreateAdd(
+            mBuilder.CreateVectorSplat(mWidth, WAI),
+            llvm::ConstantVector::get(Lanes), "x.lanes");
+      } else if (AI->getName().equals("y")) {
+        mScalar[AI] = WAI;
+      } else {
+        mWide[AI] = WAI;
+      }
+    }
+  }
+
+  void widenInstruction(llvm::Instruction *I) {
+    llvm::Value *New;
+
+    if (llvm::isa<llvm::DbgInfoIntrinsic>(I)) {
+      return;
+    } else if (llvm::ReturnInst *RI = llvm::dyn_cast<llvm::ReturnInst>(I)) {
+      if (RI->getReturnValue() != nullptr) {
+        mBuilder.CreateRet(getWide(RI->getReturnValue()));
+      } else {
+        mBuilder.CreateRetVoid();
+      }
+      return;
+    } else if (llvm::LoadInst *LI = llvm::dyn_cast<llvm::LoadInst>(I)) {
+      llvm::LoadInst *NewLI = mBuilder.CreateLoad(LI->getPointerOperand());
+      NewLI->setAlignment(LI->getAlignment());
+      mScalar[I] = NewLI;
+      return;
+    } else if (llvm::BinaryOperator *BO =
+                   llvm::dyn_cast<llvm::BinaryOperator>(I)) {
+      New = mBuilder.CreateBinOp(BO->getOpcode(), getWide(BO->getOperand(0)),
+                                 getWide(BO->getOperand(1)));
+    } else if (llvm::CastInst *CI = llvm::dyn_cast<llvm::CastInst>(I)) {
+      New = mBuilder.CreateCast(CI->getOpcode(), getWide(CI->getOperand(0)),
+                                llvm::VectorType::get(CI->getDestTy(),
+                                                      mWidth));
+    } else if (llvm::FCmpInst *CI = llvm::dyn_cast<llvm::FCmpInst>(I)) {
+      New = mBuilder.CreateFCmp(CI->getPredicate(),
+                                getWide(CI->getOperand(0)),
+                                getWide(CI->getOperand(1)));
+    } else if (llvm::ICmpInst *CI = llvm::dyn_cast<llvm::ICmpInst>(I)) {
+      New = mBuilder.CreateICmp(CI->getPredicate(),
+                                getWide(CI->getOperand(0)),
+                                getWide(CI->getOperand(1)));
+    } else if (llvm::SelectInst *SI = llvm::dyn_cast<llvm::SelectInst>(I)) {
+      New = mBuilder.CreateSelect(getWide(SI->getCondition()),
+                                  getWide(SI->getTrueValue()),
+                                  getWide(SI->getFalseValue()));
+    } else {
+      llvm::IntrinsicInst *II = llvm::cast<llvm::IntrinsicInst>(I);
+      llvm::SmallVector<llvm::Value*, 3> Args;
+      for (unsigned i = 0; i < II->getNumArgOperands(); i++)
+        Args.push_back(getWide(II->getArgOperand(i)));
+      llvm::Type *Tys[] = { Args[0]->getType() };
+      New = mBuilder.CreateCall(
+          llvm::Intrinsic::getDeclaration(mModule, II->getIntrinsicID(), Tys),
+          Args);
+    }
+
+    // Keep the fast-math flags of the scalar instruction.
+    if (llvm::isa<llvm::FPMathOperator>(I) &&
+        llvm::isa<llvm::Instruction>(New)) {
+      llvm::cast<llvm::Instruction>(New)->setFastMathFlags(
+          I->getFastMathFlags());
+    }
+    mWide[I] = New;
+  }
+
+ public:
+  KernelWidener(llvm::Module *M, unsigned Width)
+    : mModule(M), mWidth(Width), mBuilder(M->getContext()) {
+  }
+
+  llvm::Function *run(llvm::Function *F, const std::string &Name) {
+    std::vector<llvm::Type*> ParamTypes;
+    for (llvm::Function::arg_iterator AI = F->arg_begin(), AE = F->arg_end();
+         AI != AE;
+         AI++) {
+      if (AI->getName().equals("x") || AI->getName().equals("y"))
+        ParamTypes.push_back(AI->getType());
+      else
+        ParamTypes.push_back(llvm::VectorType::get(AI->getType(), mWidth));
+    }
+
+    llvm::Type *RetTy = F->getReturnType();
+    if (!RetTy->isVoidTy())
+      RetTy = llvm::VectorType::get(RetTy, mWidth);
+
+    llvm::Function *WideF = llvm::Function::Create(
+        llvm::FunctionType::get(RetTy, ParamTypes, false), F->getLinkage(),
+        Name, mModule);
+    WideF->setCallingConv(F->getCallingConv());
+    // The parameter attributes (e.g., zeroext) do not apply to vectors.
+    WideF->addAttributes(llvm::AttributeSet::FunctionIndex,
+                         F->getAttributes().getFnAttributes());
+
+    mBuilder.SetInsertPoint(
+        llvm::BasicBlock::Create(mModule->getContext(), "entry", WideF));
+
+    widenArguments(F, WideF);
+    for (llvm::inst_iterator I = llvm::inst_begin(F), E = llvm::inst_end(F);
+         I != E;
+         I++) {
+      widenInstruction(&*I);
+    }
+
+    return WideF;
+  }
+};
+
+// Static estimate of the work done by one kernel invocation, i.e. per cell.
+// The counts are those of a single pass over the code, so they are lower
+// bounds if the code has loops.
+struct KernelCost {
+  unsigned Instructions;
+  unsigned Loads;
+  unsigned Stores;
+  unsigned Transcendentals;
+  bool HasLoops;
+  // Whether some callee is unknown (indirect calls), in which case its cost
+  // is not part of the counts above.
+  bool HasUnknownCallees;
+
+  KernelCost()
+    : Instructions(0), Loads(0), Stores(0), Transcendentals(0),
+      HasLoops(false), HasUnknownCallees(false) {
+  }
+
+  void add(const llvm::Function *F) {
+    llvm::SmallVector<std::pair<const llvm::BasicBlock*,
+                                const llvm::BasicBlock*>, 4> Backedges;
+    llvm::FindFunctionBackedges(*F, Backedges);
+    if (!Backedges.empty())
+      HasLoops = true;
+
+    for (llvm::const_inst_iterator I = llvm::inst_begin(F),
+            E = llvm::inst_end(F);
+         I != E;
+         I++) {
+      if (llvm::isa<llvm::DbgInfoIntrinsic>(&*I))
+        continue;
+
+      Instructions++;
+
+      if (llvm::isa<llvm::LoadInst>(&*I)) {
+        Loads++;
+      } else if (llvm::isa<llvm::StoreInst>(&*I)) {
+        Stores++;
+      } else if (const llvm::IntrinsicInst *II =
+                     llvm::dyn_cast<llvm::IntrinsicInst>(&*I)) {
+        if (IsTranscendentalIntrinsic(II->getIntrinsicID()))
+          Transcendentals++;
+      } else if (const llvm::CallInst *CI =
+                     llvm::dyn_cast<llvm::CallInst>(&*I)) {
+        const llvm::Function *Callee = llvm::dyn_cast<llvm::Function>(
+            CI->getCalledValue()->stripPointerCasts());
+        if ((Callee != nullptr) && IsTranscendentalFunc(Callee->getName()))
+          Transcendentals++;
+      }
+    }
+  }
+};
+
+}  // namespace
+
 RSBackend::RSBackend(RSContext *Context,
                      clang::DiagnosticsEngine *DiagEngine,
                      const clang::CodeGenOptions &CodeGenOpts,
@@ -65,8 +570,15 @@ RSBackend::RSBackend(RSContext *Context,
     mExportFuncMetadata(nullptr),
     mExportForEachNameMetadata(nullptr),
     mExportForEachSignatureMetadata(nullptr),
+    mExportForEachPrecisionMetadata(nullptr),
+    mExportForEachFootprintMetadata(nullptr),
+    mExportReduceMetadata(nullptr),
     mExportTypeMetadata(nullptr),
     mRSObjectSlotsMetadata(nullptr),
+    mSpecializedVarsMetadata(nullptr),
+    mExportVarAccessMetadata(nullptr),
+    mExportForEachCostMetadata(nullptr),
+    mExportForEachVariantsMetadata(nullptr),
     mRefCount(mContext->getASTContext()),
     mASTChecker(Context, Context->getTargetAPI(), IsFilterscript) {
 }
@@ -75,13 +587,19 @@ RSBackend::RSBackend(RSContext *Context,
 void RSBackend::AnnotateFunction(clang::FunctionDecl *FD) {
   if (FD &&
       FD->hasBody() &&
-      !SlangRS::IsLocInRSHeaderFile(FD->getLocation(), mSourceMgr)) {
+      !mContext->isLocInRSHeaderFile(FD->getLocation())) {
     mRefCount.Init();
     mRefCount.Visit(FD->getBody());
   }
 }
 
 bool RSBackend::HandleTopLevelDecl(clang::DeclGroupRef D) {
+  // Index the user declarations so that later passes over the translation unit
+  // can skip the (many) declarations from the RS runtime headers.
+  for (clang::DeclGroupRef::iterator I = D.begin(), E = D.end(); I != E; I++) {
+    mContext->addTopLevelDecl(*I);
+  }
+
   // Disallow user-defined functions with prefix "rs"
   if (!mAllowRSPrefix) {
     // Iterate all function declarations in the program.
@@ -92,7 +610,7 @@ bool RSBackend::HandleTopLevelDecl(clang::DeclGroupRef D) {
         continue;
       if (!FD->getName().startswith("rs"))  // Check prefix
         continue;
-      if (!SlangRS::IsLocInRSHeaderFile(FD->getLocation(), mSourceMgr))
+      if (!mContext->isLocInRSHeaderFile(FD->getLocation()))
         mContext->ReportError(FD->getLocation(),
                               "invalid function name prefix, "
                               "\"rs\" is reserved: '%0'")
@@ -121,13 +639,37 @@ bool RSBackend::HandleTopLevelDecl(clang::DeclGroupRef D) {
     }
   }
 
+  // The functions of reduction kernels are only called by the runtime. Keep
+  // the static ones from being dropped as unused.
+  for (clang::DeclGroupRef::iterator I = D.begin(), E = D.end(); I != E; I++) {
+    clang::FunctionDecl *FD = llvm::dyn_cast<clang::FunctionDecl>(*I);
+    if (FD && FD->hasBody() &&
+        (FD->getStorageClass() == clang::SC_Static) &&
+        mContext->isReduceFunc(FD->getName())) {
+      FD->addAttr(clang::UsedAttr::CreateImplicit(FD->getASTContext()));
+    }
+  }
+
+  // A "#pragma rs fp_precision" applies to the function declaration following
+  // it, which must be a definition.
+  for (clang::DeclGroupRef::iterator I = D.begin(), E = D.end(); I != E; I++) {
+    clang::FunctionDecl *FD = llvm::dyn_cast<clang::FunctionDecl>(*I);
+    if ((FD == nullptr) || mContext->isLocInRSHeaderFile(FD->getLocation()))
+      continue;
+    if ((mContext->applyFunctionPrecision(FD) == "rs_fp_full") &&
+        mIsFilterscript) {
+      mContext->ReportError(FD->getLocation(),
+                            "Filterscript function %0() cannot use "
+                            "rs_fp_full precision")
+          << FD->getName();
+    }
+  }
+
   return Backend::HandleTopLevelDecl(D);
 }
 
 
 void RSBackend::HandleTranslationUnitPre(clang::ASTContext &C) {
-  clang::TranslationUnitDecl *TUDecl = C.getTranslationUnitDecl();
-
   // If we have an invalid RS/FS AST, don't check further.
   if (!mASTChecker.Validate()) {
     return;
@@ -167,10 +709,10 @@ void RSBackend::HandleTranslationUnitPre(clang::ASTContext &C) {
   }
 
   // Process any static function declarations
-  for (clang::DeclContext::decl_iterator I = TUDecl->decls_begin(),
-          E = TUDecl->decls_end(); I != E; I++) {
-    if ((I->getKind() >= clang::Decl::firstFunction) &&
-        (I->getKind() <= clang::Decl::lastFunction)) {
+  for (RSContext::const_user_decl_iterator I = mContext->user_decls_begin(),
+          E = mContext->user_decls_end(); I != E; I++) {
+    if (((*I)->getKind() >= clang::Decl::firstFunction) &&
+        ((*I)->getKind() <= clang::Decl::lastFunction)) {
       clang::FunctionDecl *FD = llvm::dyn_cast<clang::FunctionDecl>(*I);
       if (FD && !FD->isGlobal()) {
         AnnotateFunction(FD);
@@ -261,10 +803,240 @@ void RSBackend::dumpExportVarInfo(llvm::Module *M) {
           llvm::MDString::get(mLLVMContext, llvm::utostr_32(slotCount))));
     }
 
+    // Like #rs_object_slots, #rs_specialized_vars lists the slots of the
+    // variables of "#pragma rs specialize". Their values are final once the
+    // script has been specialized, so the device compiler may fold them.
+    if (EV->isSpecialized()) {
+      if (mSpecializedVarsMetadata == nullptr) {
+        mSpecializedVarsMetadata =
+            M->getOrInsertNamedMetadata(RS_SPECIALIZED_VARS_MN);
+      }
+      mSpecializedVarsMetadata->addOperand(llvm::MDNode::get(mLLVMContext,
+          llvm::MDString::get(mLLVMContext, llvm::utostr_32(slotCount))));
+    }
+
     slotCount++;
   }
 }
 
+void RSBackend::dumpExportVarAccessInfo(llvm::Module *M) {
+  // The functions run by the kernels (and, likewise, by the reduction
+  // kernels) may be executed concurrently with each other.
+  FunctionSet KernelFuncs;
+  bool AllKernelFuncs = false;
+  for (RSContext::const_export_foreach_iterator
+          I = mContext->export_foreach_begin(),
+          E = mContext->export_foreach_end();
+       I != E;
+       I++) {
+    if (!CollectCallees(M->getFunction((*I)->getName()), &KernelFuncs))
+      AllKernelFuncs = true;
+  }
+  for (RSContext::const_export_reduce_iterator
+          I = mContext->export_reduce_begin(),
+          E = mContext->export_reduce_end();
+       I != E;
+       I++) {
+    const std::string *Names[] = {
+      &(*I)->getAccumulatorName(), &(*I)->getInitializerName(),
+      &(*I)->getCombinerName(), &(*I)->getOutConverterName()
+    };
+    for (size_t i = 0; i < sizeof(Names) / sizeof(Names[0]); i++) {
+      if (!Names[i]->empty() &&
+          !CollectCallees(M->getFunction(*Names[i]), &KernelFuncs))
+        AllKernelFuncs = true;
+    }
+  }
+
+  if (mExportVarAccessMetadata == nullptr) {
+    mExportVarAccessMetadata =
+        M->getOrInsertNamedMetadata(RS_EXPORT_VAR_ACCESS_MN);
+  }
+
+  llvm::Function *Dtor = M->getFunction(".rs.dtor");
+
+  for (RSContext::const_export_var_iterator I = mContext->export_vars_begin(),
+          E = mContext->export_vars_end();
+       I != E;
+       I++) {
+    unsigned Access = RS_EXPORT_VAR_ACCESS_READ_ONLY;
+    FunctionSet Writers;
+    llvm::SmallPtrSet<llvm::Value*, 16> Visited;
+
+    llvm::GlobalVariable *GV = M->getNamedGlobal((*I)->getName());
+    if ((GV == nullptr) || !CollectWriters(GV, &Writers, &Visited)) {
+      Access = RS_EXPORT_VAR_ACCESS_WRITTEN_BY_KERNELS;
+    } else {
+      // The destructor only releases the RS objects once the script is gone.
+      Writers.erase(Dtor);
+      for (FunctionSet::const_iterator WI = Writers.begin(),
+              WE = Writers.end();
+           WI != WE;
+           WI++) {
+        if (AllKernelFuncs || KernelFuncs.count(*WI)) {
+          Access = RS_EXPORT_VAR_ACCESS_WRITTEN_BY_KERNELS;
+          break;
+        }
+        Access = RS_EXPORT_VAR_ACCESS_WRITTEN_BY_INVOKABLES;
+      }
+    }
+
+    mExportVarAccessMetadata->addOperand(llvm::MDNode::get(mLLVMContext,
+        llvm::MDString::get(mLLVMContext, llvm::utostr_32(Access))));
+  }
+}
+
+void RSBackend::annotateExportForEachParams(llvm::Module *M) {
+  const llvm::DataLayout *DL = mContext->getDataLayout();
+
+  for (RSContext::const_export_foreach_iterator
+          I = mContext->export_foreach_begin(),
+          E = mContext->export_foreach_end();
+       I != E;
+       I++) {
+    const RSExportForEach *EFE = *I;
+    if (EFE->isDummyRoot() || EFE->isKernelStyle())
+      continue;
+
+    llvm::Function *F = M->getFunction(EFE->getName());
+    if (F == nullptr)
+      continue;
+
+    llvm::SmallVector<const clang::ParmVarDecl*, 2> Params(
+        EFE->getIns().begin(), EFE->getIns().end());
+    if (EFE->hasOut())
+      Params.push_back(EFE->getOut());
+
+    for (size_t i = 0; i < Params.size(); i++) {
+      unsigned Index = Params[i]->getFunctionScopeIndex();
+      if (Index >= F->arg_size())
+        continue;
+
+      llvm::Function::arg_iterator A = F->arg_begin();
+      std::advance(A, Index);
+      llvm::PointerType *PT = llvm::dyn_cast<llvm::PointerType>(A->getType());
+      if (PT == nullptr)
+        continue;
+
+      // The input and output allocations are distinct, and the runtime
+      // passes the address of the current cell of each of them.
+      llvm::AttrBuilder B;
+      B.addAttribute(llvm::Attribute::NoAlias);
+
+      // The allocations are (at least) 16-byte aligned, hence every cell is
+      // aligned on the largest power of 2 (up to 16) dividing the cell size.
+      llvm::Type *CellTy = PT->getElementType();
+      if (CellTy->isSized()) {
+        uint64_t Size = DL->getTypeAllocSize(CellTy);
+        unsigned Align = 16;
+        while ((Size % Align) != 0)
+          Align /= 2;
+        if (Align > 1)
+          B.addAlignmentAttr(Align);
+      }
+
+      A->addAttr(llvm::AttributeSet::get(mLLVMContext, Index + 1, B));
+    }
+  }
+}
+
+void RSBackend::dumpExportForEachCostInfo(llvm::Module *M) {
+  if (mExportForEachCostMetadata == nullptr) {
+    mExportForEachCostMetadata =
+        M->getOrInsertNamedMetadata(RS_EXPORT_FOREACH_COST_MN);
+  }
+
+  llvm::SmallVector<llvm::Value*, 6> ExportForEachCost;
+
+  for (RSContext::const_export_foreach_iterator
+          I = mContext->export_foreach_begin(),
+          E = mContext->export_foreach_end();
+       I != E;
+       I++) {
+    // The cost of the helpers that were not inlined is added to the one of
+    // the kernel, once per helper.
+    KernelCost Cost;
+    FunctionSet Funcs;
+    if (!CollectCallees(M->getFunction((*I)->getName()), &Funcs))
+      Cost.HasUnknownCallees = true;
+    for (FunctionSet::const_iterator FI = Funcs.begin(), FE = Funcs.end();
+         FI != FE;
+         FI++) {
+      Cost.add(*FI);
+    }
+
+    ExportForEachCost.push_back(
+        llvm::MDString::get(mLLVMContext, llvm::utostr_32(Cost.Instructions)));
+    ExportForEachCost.push_back(
+        llvm::MDString::get(mLLVMContext, llvm::utostr_32(Cost.Loads)));
+    ExportForEachCost.push_back(
+        llvm::MDString::get(mLLVMContext, llvm::utostr_32(Cost.Stores)));
+    ExportForEachCost.push_back(
+        llvm::MDString::get(mLLVMContext,
+                            llvm::utostr_32(Cost.Transcendentals)));
+    ExportForEachCost.push_back(
+        llvm::MDString::get(mLLVMContext, Cost.HasLoops ? "1" : "0"));
+    ExportForEachCost.push_back(
+        llvm::MDString::get(mLLVMContext,
+                            Cost.HasUnknownCallees ? "1" : "0"));
+
+    mExportForEachCostMetadata->addOperand(
+        llvm::MDNode::get(mLLVMContext, ExportForEachCost));
+    ExportForEachCost.clear();
+  }
+}
+
+void RSBackend::createExportForEachVariants(llvm::Module *M) {
+  static const unsigned Widths[] = { 4, 8 };
+
+  // One entry per kernel (in #rs_export_foreach_name order), listing the
+  // width and the name of each of its variants
+  std::vector<llvm::SmallVector<llvm::Value*, 4> > Variants;
+  bool HasVariants = false;
+
+  for (RSContext::const_export_foreach_iterator
+          I = mContext->export_foreach_begin(),
+          E = mContext->export_foreach_end();
+       I != E;
+       I++) {
+    const RSExportForEach *EFE = *I;
+    Variants.push_back(llvm::SmallVector<llvm::Value*, 4>());
+    if (!EFE->isMultiversioned())
+      continue;
+
+    llvm::Function *F = M->getFunction(EFE->getName());
+    std::string Reason;
+    if ((F == nullptr) || !CanWidenKernel(F, &Reason)) {
+      mContext->ReportWarning("Kernel %0() is not multiversioned since %1")
+          << EFE->getName() << Reason;
+      continue;
+    }
+
+    for (size_t i = 0; i < sizeof(Widths) / sizeof(Widths[0]); i++) {
+      std::string Name =
+          ".rs.vec" + llvm::utostr_32(Widths[i]) + "." + EFE->getName();
+      KernelWidener(M, Widths[i]).run(F, Name);
+
+      Variants.back().push_back(
+          llvm::MDString::get(mLLVMContext, llvm::utostr_32(Widths[i])));
+      Variants.back().push_back(llvm::MDString::get(mLLVMContext, Name));
+    }
+    HasVariants = true;
+  }
+
+  if (!HasVariants)
+    return;
+
+  if (mExportForEachVariantsMetadata == nullptr) {
+    mExportForEachVariantsMetadata =
+        M->getOrInsertNamedMetadata(RS_EXPORT_FOREACH_VARIANTS_MN);
+  }
+  for (size_t i = 0; i < Variants.size(); i++) {
+    mExportForEachVariantsMetadata->addOperand(
+        llvm::MDNode::get(mLLVMContext, Variants[i]));
+  }
+}
+
 void RSBackend::dumpExportFunctionInfo(llvm::Module *M) {
   if (mExportFuncMetadata == nullptr)
     mExportFuncMetadata =
@@ -272,6 +1044,21 @@ void RSBackend::dumpExportFunctionInfo(llvm::Module *M) {
 
   llvm::SmallVector<llvm::Value*, 1> ExportFuncInfo;
 
+  // The functions listed in "#pragma rs batch_invoke", along with the
+  // parameter packet type and the by-reference parameters of their helper.
+  struct BatchedFunc {
+    const RSExportFunc *EF;
+    llvm::Function *F;
+    llvm::StructType *PacketTy;
+    std::vector<bool> isStructInput;
+
+    BatchedFunc(const RSExportFunc *EF, llvm::Function *F,
+                llvm::StructType *PacketTy,
+                const std::vector<bool> &isStructInput)
+        : EF(EF), F(F), PacketTy(PacketTy), isStructInput(isStructInput) { }
+  };
+  std::vector<BatchedFunc> BatchedFuncs;
+
   for (RSContext::const_export_func_iterator
           I = mContext->export_funcs_begin(),
           E = mContext->export_funcs_end();
@@ -355,36 +1142,10 @@ void RSBackend::dumpExportFunctionInfo(llvm::Module *M) {
           llvm::BasicBlock *BB =
               llvm::BasicBlock::Create(mLLVMContext, "entry", HelperFunction);
           llvm::IRBuilder<> *IB = new llvm::IRBuilder<>(BB);
-          llvm::SmallVector<llvm::Value*, 6> Params;
-          llvm::Value *Idx[2];
-
-          Idx[0] =
-              llvm::ConstantInt::get(llvm::Type::getInt32Ty(mLLVMContext), 0);
-
-          // getelementptr and load instruction for all elements in
-          // parameter .p
-          for (size_t i = 0; i < EF->getNumParameters(); i++) {
-            // getelementptr
-            Idx[1] = llvm::ConstantInt::get(
-              llvm::Type::getInt32Ty(mLLVMContext), i);
-
-            llvm::Value *Ptr = NULL;
-
-            Ptr = IB->CreateInBoundsGEP(HelperFunctionParameter, Idx);
-
-            // Load is only required for non-struct ptrs
-            if (isStructInput[i]) {
-                Params.push_back(Ptr);
-            } else {
-                llvm::Value *V = IB->CreateLoad(Ptr);
-                Params.push_back(V);
-            }
-          }
 
           // Call and pass the all elements as parameter to F
-          llvm::CallInst *CI = IB->CreateCall(F, Params);
-
-          CI->setCallingConv(F->getCallingConv());
+          llvm::CallInst *CI = genUnpackedCall(IB, F, HelperFunctionParameter,
+                                               isStructInput);
 
           if (F->getReturnType() == llvm::Type::getVoidTy(mLLVMContext))
             IB->CreateRetVoid();
@@ -393,6 +1154,11 @@ void RSBackend::dumpExportFunctionInfo(llvm::Module *M) {
 
           delete IB;
         }
+
+        if (EF->isBatched()) {
+          BatchedFuncs.push_back(
+              BatchedFunc(EF, F, HelperFunctionParameterTy, isStructInput));
+        }
       }
 
       ExportFuncInfo.push_back(
@@ -403,8 +1169,78 @@ void RSBackend::dumpExportFunctionInfo(llvm::Module *M) {
         llvm::MDNode::get(mLLVMContext, ExportFuncInfo));
     ExportFuncInfo.clear();
   }
+
+  // The batch helpers are exported after all the other functions so that the
+  // slots of the latter don't depend on the batch_invoke pragmas. A batch
+  // helper gets an array of parameter packets and, as any invokable, the
+  // size in bytes of its parameter buffer:
+  //
+  //   void .helper_batch_<fn>(packet *p, uint32_t size) {
+  //     for (uint32_t i = 0; i < size / sizeof(packet); i++)
+  //       <fn>(p[i].param0, p[i].param1, ...);
+  //   }
+  for (std::vector<BatchedFunc>::const_iterator I = BatchedFuncs.begin(),
+           E = BatchedFuncs.end();
+       I != E;
+       I++) {
+    const std::string HelperFunctionName(".helper_batch_" + I->EF->getName());
+    llvm::Type *Int32Ty = llvm::Type::getInt32Ty(mLLVMContext);
+
+    llvm::Type *Params[] = {
+      llvm::PointerType::getUnqual(I->PacketTy), Int32Ty
+    };
+    llvm::FunctionType *HelperFunctionType =
+        llvm::FunctionType::get(llvm::Type::getVoidTy(mLLVMContext), Params,
+                                /* IsVarArgs = */false);
+    llvm::Function *HelperFunction =
+        llvm::Function::Create(HelperFunctionType,
+                               llvm::GlobalValue::ExternalLinkage,
+                               HelperFunctionName,
+                               M);
+    HelperFunction->addFnAttr(llvm::Attribute::NoInline);
+    HelperFunction->setCallingConv(I->F->getCallingConv());
+
+    llvm::Function::arg_iterator AI = HelperFunction->arg_begin();
+    llvm::Argument *Packets = &(*AI++);
+    llvm::Argument *Size = &(*AI);
+
+    llvm::BasicBlock *Entry =
+        llvm::BasicBlock::Create(mLLVMContext, "entry", HelperFunction);
+    llvm::BasicBlock *Loop =
+        llvm::BasicBlock::Create(mLLVMContext, "loop", HelperFunction);
+    llvm::BasicBlock *Exit =
+        llvm::BasicBlock::Create(mLLVMContext, "exit", HelperFunction);
+    llvm::IRBuilder<> *IB = new llvm::IRBuilder<>(Entry);
+
+    llvm::Value *PacketSize = llvm::ConstantInt::get(
+        Int32Ty, I->EF->getParamPacketType()->getAllocSize());
+    llvm::Value *Count = IB->CreateUDiv(Size, PacketSize, "count");
+    llvm::Value *Zero = llvm::ConstantInt::get(Int32Ty, 0);
+    IB->CreateCondBr(IB->CreateICmpEQ(Count, Zero), Exit, Loop);
+
+    IB->SetInsertPoint(Loop);
+    llvm::PHINode *Index = IB->CreatePHI(Int32Ty, 2, "i");
+    Index->addIncoming(Zero, Entry);
+    llvm::Value *Packet = IB->CreateInBoundsGEP(Packets, Index, "packet");
+    genUnpackedCall(IB, I->F, Packet, I->isStructInput);
+    llvm::Value *Next =
+        IB->CreateAdd(Index, llvm::ConstantInt::get(Int32Ty, 1), "next");
+    Index->addIncoming(Next, Loop);
+    IB->CreateCondBr(IB->CreateICmpEQ(Next, Count), Exit, Loop);
+
+    IB->SetInsertPoint(Exit);
+    IB->CreateRetVoid();
+    delete IB;
+
+    ExportFuncInfo.push_back(
+        llvm::MDString::get(mLLVMContext, HelperFunctionName.c_str()));
+    mExportFuncMetadata->addOperand(
+        llvm::MDNode::get(mLLVMContext, ExportFuncInfo));
+    ExportFuncInfo.clear();
+  }
 }
 
+
 void RSBackend::dumpExportForEachInfo(llvm::Module *M) {
   if (mExportForEachNameMetadata == nullptr) {
     mExportForEachNameMetadata =
@@ -417,6 +1253,8 @@ void RSBackend::dumpExportForEachInfo(llvm::Module *M) {
 
   llvm::SmallVector<llvm::Value*, 1> ExportForEachName;
   llvm::SmallVector<llvm::Value*, 1> ExportForEachInfo;
+  bool HasKernelPrecision = false;
+  bool HasFootprint = false;
 
   for (RSContext::const_export_foreach_iterator
           I = mContext->export_foreach_begin(),
@@ -439,6 +1277,119 @@ void RSBackend::dumpExportForEachInfo(llvm::Module *M) {
     mExportForEachSignatureMetadata->addOperand(
         llvm::MDNode::get(mLLVMContext, ExportForEachInfo));
     ExportForEachInfo.clear();
+
+    if (!EFE->getPrecision().empty())
+      HasKernelPrecision = true;
+    if (!EFE->getFootprints().empty())
+      HasFootprint = true;
+  }
+
+  // Likewise, the footprints are only emitted if some kernel is a stencil.
+  if (HasFootprint)
+    dumpExportForEachFootprintInfo(M);
+
+  // Only emitted if some kernel has its own precision. There is then one
+  // entry per kernel (in #rs_export_foreach_name order), which is empty if
+  // the kernel uses the precision of the file.
+  if (!HasKernelPrecision)
+    return;
+
+  if (mExportForEachPrecisionMetadata == nullptr) {
+    mExportForEachPrecisionMetadata =
+        M->getOrInsertNamedMetadata(RS_EXPORT_FOREACH_PRECISION_MN);
+  }
+
+  llvm::SmallVector<llvm::Value*, 1> ExportForEachPrecision;
+
+  for (RSContext::const_export_foreach_iterator
+          I = mContext->export_foreach_begin(),
+          E = mContext->export_foreach_end();
+       I != E;
+       I++) {
+    ExportForEachPrecision.push_back(
+        llvm::MDString::get(mLLVMContext, (*I)->getPrecision()));
+
+    mExportForEachPrecisionMetadata->addOperand(
+        llvm::MDNode::get(mLLVMContext, ExportForEachPrecision));
+    ExportForEachPrecision.clear();
+  }
+}
+
+void RSBackend::dumpExportForEachFootprintInfo(llvm::Module *M) {
+  if (mExportForEachFootprintMetadata == nullptr) {
+    mExportForEachFootprintMetadata =
+        M->getOrInsertNamedMetadata(RS_EXPORT_FOREACH_FOOTPRINT_MN);
+  }
+
+  llvm::SmallVector<llvm::Value*, 5> ExportForEachFootprint;
+
+  for (RSContext::const_export_foreach_iterator
+          I = mContext->export_foreach_begin(),
+          E = mContext->export_foreach_end();
+       I != E;
+       I++) {
+    const RSExportForEach::FootprintVec &Footprints = (*I)->getFootprints();
+    for (size_t i = 0; i < Footprints.size(); i++) {
+      const RSExportForEach::Footprint &F = Footprints[i];
+      ExportForEachFootprint.push_back(
+          llvm::MDString::get(mLLVMContext, F.Allocation));
+      ExportForEachFootprint.push_back(
+          llvm::MDString::get(mLLVMContext, llvm::itostr(F.MinX)));
+      ExportForEachFootprint.push_back(
+          llvm::MDString::get(mLLVMContext, llvm::itostr(F.MaxX)));
+      ExportForEachFootprint.push_back(
+          llvm::MDString::get(mLLVMContext, llvm::itostr(F.MinY)));
+      ExportForEachFootprint.push_back(
+          llvm::MDString::get(mLLVMContext, llvm::itostr(F.MaxY)));
+    }
+
+    mExportForEachFootprintMetadata->addOperand(
+        llvm::MDNode::get(mLLVMContext, ExportForEachFootprint));
+    ExportForEachFootprint.clear();
+  }
+}
+
+void RSBackend::dumpExportReduceInfo(llvm::Module *M) {
+  if (mExportReduceMetadata == nullptr) {
+    mExportReduceMetadata = M->getOrInsertNamedMetadata(RS_EXPORT_REDUCE_MN);
+  }
+
+  const llvm::DataLayout *DL = mContext->getDataLayout();
+  llvm::SmallVector<llvm::Value*, 8> ExportReduceInfo;
+
+  for (RSContext::const_export_reduce_iterator
+          I = mContext->export_reduce_begin(),
+          E = mContext->export_reduce_end();
+       I != E;
+       I++) {
+    const RSExportReduce *ER = *I;
+    const RSExportType *AccumType = ER->getAccumulatorType();
+
+    // The functions (an empty name if not given), then the layout of the
+    // per-thread accumulators and the number of inputs. The entries are
+    // indexed by the RS_EXPORT_REDUCE_* constants.
+    const std::string *Strings[] = {
+      &ER->getName(), &ER->getAccumulatorName(), &ER->getInitializerName(),
+      &ER->getCombinerName(), &ER->getOutConverterName()
+    };
+    for (unsigned i = 0; i < sizeof(Strings) / sizeof(Strings[0]); i++) {
+      ExportReduceInfo.push_back(
+          llvm::MDString::get(mLLVMContext, Strings[i]->c_str()));
+    }
+    ExportReduceInfo.push_back(
+        llvm::MDString::get(mLLVMContext,
+                            llvm::utostr_32(AccumType->getAllocSize())));
+    ExportReduceInfo.push_back(
+        llvm::MDString::get(mLLVMContext,
+                            llvm::utostr_32(DL->getABITypeAlignment(
+                                AccumType->getLLVMType()))));
+    ExportReduceInfo.push_back(
+        llvm::MDString::get(mLLVMContext,
+                            llvm::utostr_32(ER->getInTypes().size())));
+
+    mExportReduceMetadata->addOperand(
+        llvm::MDNode::get(mLLVMContext, ExportReduceInfo));
+    ExportReduceInfo.clear();
   }
 }
 
@@ -512,13 +1463,32 @@ void RSBackend::HandleTranslationUnitPost(llvm::Module *M) {
   if (mContext->hasExportFunc())
     dumpExportFunctionInfo(M);
 
-  if (mContext->hasExportForEach())
+  if (mContext->hasExportForEach()) {
     dumpExportForEachInfo(M);
+    annotateExportForEachParams(M);
+  }
+
+  if (mContext->hasExportReduce())
+    dumpExportReduceInfo(M);
 
   if (mContext->hasExportType())
     dumpExportTypeInfo(M);
 }
 
+void RSBackend::HandleTranslationUnitOptimized(llvm::Module *M) {
+  // The exported entities are incomplete if the translation unit is invalid.
+  if (mDiagEngine.hasErrorOccurred())
+    return;
+
+  if (mContext->hasExportVar())
+    dumpExportVarAccessInfo(M);
+
+  if (mContext->hasExportForEach()) {
+    dumpExportForEachCostInfo(M);
+    createExportForEachVariants(M);
+  }
+}
+
 RSBackend::~RSBackend() {
 }
 
@@ -54,8 +54,15 @@ class RSBackend : public Backend {
   llvm::NamedMDNode *mExportFuncMetadata;
   llvm::NamedMDNode *mExportForEachNameMetadata;
   llvm::NamedMDNode *mExportForEachSignatureMetadata;
+  llvm::NamedMDNode *mExportForEachPrecisionMetadata;
+  llvm::NamedMDNode *mExportForEachFootprintMetadata;
+  llvm::NamedMDNode *mExportReduceMetadata;
   llvm::NamedMDNode *mExportTypeMetadata;
   llvm::NamedMDNode *mRSObjectSlotsMetadata;
+  llvm::NamedMDNode *mSpecializedVarsMetadata;
+  llvm::NamedMDNode *mExportVarAccessMetadata;
+  llvm::NamedMDNode *mExportForEachCostMetadata;
+  llvm::NamedMDNode *mExportForEachVariantsMetadata;
 
   RSObjectRefCount mRefCount;
 
@@ -66,7 +73,15 @@ class RSBackend : public Backend {
   void dumpExportVarInfo(llvm::Module *M);
   void dumpExportFunctionInfo(llvm::Module *M);
   void dumpExportForEachInfo(llvm::Module *M);
+  void dumpExportForEachFootprintInfo(llvm::Module *M);
+  // Mark the in/out pointers of the old-style kernels noalias and aligned.
+  void annotateExportForEachParams(llvm::Module *M);
+  void dumpExportReduceInfo(llvm::Module *M);
   void dumpExportTypeInfo(llvm::Module *M);
+  void dumpExportVarAccessInfo(llvm::Module *M);
+  void dumpExportForEachCostInfo(llvm::Module *M);
+  // Emit the variants of the kernels listed in "#pragma rs multiversion".
+  void createExportForEachVariants(llvm::Module *M);
 
  protected:
   virtual unsigned int getTargetAPI() const {
@@ -79,6 +94,8 @@ class RSBackend : public Backend {
 
   virtual void HandleTranslationUnitPost(llvm::Module *M);
 
+  virtual void HandleTranslationUnitOptimized(llvm::Module *M);
+
  public:
   RSBackend(RSContext *Context,
             clang::DiagnosticsEngine *DiagEngine,
@@ -218,7 +218,7 @@ void RSCheckAST::ValidateVarDecl(clang::VarDecl *VD) {
 
 
 void RSCheckAST::VisitDeclStmt(clang::DeclStmt *DS) {
-  if (!SlangRS::IsLocInRSHeaderFile(DS->getLocStart(), mSM)) {
+  if (!Context->isLocInRSHeaderFile(DS->getLocStart())) {
     for (clang::DeclStmt::decl_iterator I = DS->decl_begin(),
                                         E = DS->decl_end();
          I != E;
@@ -259,7 +259,7 @@ void RSCheckAST::VisitExpr(clang::Expr *E) {
   // array accesses rely heavily on them and they are valid.
   E = E->IgnoreImpCasts();
   if (mIsFilterscript &&
-      !SlangRS::IsLocInRSHeaderFile(E->getExprLoc(), mSM) &&
+      !Context->isLocInRSHeaderFile(E->getExprLoc()) &&
       !RSExportType::ValidateType(Context, C, E->getType(), nullptr, E->getExprLoc(),
                                   mTargetAPI, mIsFilterscript)) {
     mValid = false;
@@ -271,20 +271,19 @@ void RSCheckAST::VisitExpr(clang::Expr *E) {
 
 
 bool RSCheckAST::Validate() {
-  clang::TranslationUnitDecl *TUDecl = C.getTranslationUnitDecl();
-  for (clang::DeclContext::decl_iterator DI = TUDecl->decls_begin(),
-          DE = TUDecl->decls_end();
+  // Declarations from the RS runtime headers were already filtered out when
+  // the top-level declarations were indexed.
+  for (RSContext::const_user_decl_iterator DI = Context->user_decls_begin(),
+          DE = Context->user_decls_end();
        DI != DE;
        DI++) {
-    if (!SlangRS::IsLocInRSHeaderFile(DI->getLocStart(), mSM)) {
-      if (clang::VarDecl *VD = llvm::dyn_cast<clang::VarDecl>(*DI)) {
-        ValidateVarDecl(VD);
-      } else if (clang::FunctionDecl *FD =
-            llvm::dyn_cast<clang::FunctionDecl>(*DI)) {
-        ValidateFunctionDecl(FD);
-      } else if (clang::Stmt *Body = (*DI)->getBody()) {
-        Visit(Body);
-      }
+    if (clang::VarDecl *VD = llvm::dyn_cast<clang::VarDecl>(*DI)) {
+      ValidateVarDecl(VD);
+    } else if (clang::FunctionDecl *FD =
+          llvm::dyn_cast<clang::FunctionDecl>(*DI)) {
+      ValidateFunctionDecl(FD);
+    } else if (clang::Stmt *Body = (*DI)->getBody()) {
+      Visit(Body);
     }
   }
 
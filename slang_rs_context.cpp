@@ -19,12 +19,14 @@
 #include <string>
 
 #include "clang/AST/ASTContext.h"
+#include "clang/AST/Attr.h"
 #include "clang/AST/Decl.h"
 #include "clang/AST/DeclBase.h"
 #include "clang/AST/Mangle.h"
 #include "clang/AST/Type.h"
 
 #include "clang/Basic/Linkage.h"
+#include "clang/Basic/SourceManager.h"
 #include "clang/Basic/TargetInfo.h"
 
 #include "llvm/IR/LLVMContext.h"
@@ -32,13 +34,16 @@
 
 #include "slang.h"
 #include "slang_assert.h"
+#include "slang_rs.h"
 #include "slang_rs_export_foreach.h"
 #include "slang_rs_export_func.h"
+#include "slang_rs_export_reduce.h"
 #include "slang_rs_export_type.h"
 #include "slang_rs_export_var.h"
 #include "slang_rs_exportable.h"
 #include "slang_rs_pragma_handler.h"
 #include "slang_rs_reflection.h"
+#include "slang_version.h"
 
 namespace slang {
 
@@ -53,6 +58,7 @@ RSContext::RSContext(clang::Preprocessor &PP,
       mPragmas(Pragmas),
       mTargetAPI(TargetAPI),
       mVerbose(Verbose),
+      mWarnUntiledReads(false),
       mDataLayout(nullptr),
       mLLVMContext(llvm::getGlobalContext()),
       mLicenseNote(nullptr),
@@ -92,6 +98,12 @@ bool RSContext::processExportFunc(const clang::FunctionDecl *FD) {
     return true;
   }
 
+  // The functions of reduction kernels are only reachable through the
+  // reduction kernels themselves (see processExportReduce()).
+  if (isReduceFunc(FD->getName())) {
+    return true;
+  }
+
   if (FD->getStorageClass() != clang::SC_None) {
     fprintf(stderr, "RSContext::processExportFunc : cannot export extern or "
                     "static function '%s'\n", FD->getName().str().c_str());
@@ -120,7 +132,7 @@ bool RSContext::processExportFunc(const clang::FunctionDecl *FD) {
 }
 
 
-bool RSContext::processExportType(const llvm::StringRef &Name) {
+RSExportType *RSContext::createExportType(const llvm::StringRef &Name) {
   clang::TranslationUnitDecl *TUDecl = mCtx.getTranslationUnitDecl();
 
   slangAssert(TUDecl != nullptr && "Translation unit declaration (top-level "
@@ -130,7 +142,7 @@ bool RSContext::processExportType(const llvm::StringRef &Name) {
   if (II == nullptr)
     // TODO(zonr): alert identifier @Name mark as an exportable type cannot be
     //             found
-    return false;
+    return nullptr;
 
   clang::DeclContext::lookup_const_result R = TUDecl->lookup(II);
   RSExportType *ET = nullptr;
@@ -161,7 +173,333 @@ bool RSContext::processExportType(const llvm::StringRef &Name) {
       ET = RSExportType::Create(this, T);
   }
 
-  return (ET != nullptr);
+  return ET;
+}
+
+bool RSContext::processExportType(const llvm::StringRef &Name) {
+  return (createExportType(Name) != nullptr);
+}
+
+// Only fields whose values can be moved in bulk between a Java (or C++) array
+// of primitives and an Allocation of the field's element are supported.
+static bool IsSoAFieldType(const RSExportType *ET) {
+  if ((ET->getClass() != RSExportType::ExportClassPrimitive) &&
+      (ET->getClass() != RSExportType::ExportClassVector))
+    return false;
+
+  switch (static_cast<const RSExportPrimitiveType*>(ET)->getType()) {
+    case DataTypeFloat16:
+    case DataTypeFloat32:
+    case DataTypeFloat64:
+    case DataTypeSigned8:
+    case DataTypeSigned16:
+    case DataTypeSigned32:
+    case DataTypeSigned64:
+    case DataTypeUnsigned8:
+    case DataTypeUnsigned16:
+    case DataTypeUnsigned32:
+    case DataTypeUnsigned64:
+      return true;
+    default:
+      return false;
+  }
+}
+
+bool RSContext::processExportSoAType(const llvm::StringRef &Name) {
+  RSExportType *ET = createExportType(Name);
+  if (ET == nullptr)
+    return false;
+
+  if (ET->getClass() != RSExportType::ExportClassRecord) {
+    ReportError("export_type_soa requires a struct type, but '%0' is not a "
+                "struct") << Name;
+    return false;
+  }
+
+  const RSExportRecordType *ERT = static_cast<const RSExportRecordType*>(ET);
+  bool valid = true;
+  for (RSExportRecordType::const_field_iterator FI = ERT->fields_begin(),
+           FE = ERT->fields_end();
+       FI != FE;
+       FI++) {
+    if (!IsSoAFieldType((*FI)->getType())) {
+      ReportError("field '%0' of struct '%1' cannot be exported in "
+                  "structure-of-arrays layout (only numeric scalar and vector "
+                  "fields are supported)")
+          << (*FI)->getName() << ERT->getName();
+      valid = false;
+    }
+  }
+
+  if (!valid)
+    return false;
+
+  mExportSoATypes.push_back(ERT);
+  collectSoABindings(ERT);
+  return true;
+}
+
+bool RSContext::processBatchInvokeFunc(const llvm::StringRef &Name) {
+  // Every overload of the function is batched.
+  bool Found = false;
+  for (ExportFuncList::iterator I = mExportFuncs.begin(),
+           E = mExportFuncs.end();
+       I != E;
+       I++) {
+    RSExportFunc *EF = *I;
+    if (EF->getName(/* mangle = */false) != Name)
+      continue;
+
+    // The packets are counted from the size of the parameter buffer.
+    if (!EF->hasParam()) {
+      ReportError("batch_invoke requires a function with parameters, but "
+                  "'%0' has none") << Name;
+      return false;
+    }
+    EF->mBatched = true;
+    Found = true;
+  }
+
+  if (!Found) {
+    ReportError("batch_invoke requires an exported function, but '%0' is "
+                "not one") << Name;
+  }
+  return Found;
+}
+
+bool RSContext::processSpecializeVar(const llvm::StringRef &Name) {
+  // specialize() needs the runtime to fold the values into the kernels.
+  if (mTargetAPI != SLANG_DEVELOPMENT_TARGET_API) {
+    ReportError("specialized variable '%0' is not supported in SDK levels "
+                "%1-%2")
+        << Name << SLANG_MINIMUM_TARGET_API << SLANG_MAXIMUM_TARGET_API;
+    return false;
+  }
+
+  for (ExportVarList::iterator I = mExportVars.begin(), E = mExportVars.end();
+       I != E;
+       I++) {
+    RSExportVar *EV = *I;
+    if (EV->getName() != Name)
+      continue;
+
+    if (EV->isConst()) {
+      ReportError("specialize requires a non-const variable, but '%0' is "
+                  "const") << Name;
+      return false;
+    }
+
+    // Only scalars and vectors are worth folding into the kernels. Objects
+    // and bound pointers are not values the device compiler could use.
+    const RSExportType *ET = EV->getType();
+    if (((ET->getClass() != RSExportType::ExportClassPrimitive) &&
+         (ET->getClass() != RSExportType::ExportClassVector)) ||
+        static_cast<const RSExportPrimitiveType*>(ET)->isRSObjectType()) {
+      ReportError("specialize requires a variable of scalar or vector type, "
+                  "but '%0' is of type '%1'") << Name << ET->getName();
+      return false;
+    }
+
+    EV->mSpecialized = true;
+    return true;
+  }
+
+  ReportError("specialize requires an exported variable, but '%0' is not "
+              "one") << Name;
+  return false;
+}
+
+bool RSContext::processMultiversionKernel(const llvm::StringRef &Name) {
+  for (ExportForEachList::iterator I = mExportForEach.begin(),
+           E = mExportForEach.end();
+       I != E;
+       I++) {
+    RSExportForEach *EFE = *I;
+    if (EFE->isDummyRoot() || (EFE->getName() != Name))
+      continue;
+
+    if (!EFE->isKernelStyle()) {
+      ReportError("multiversion requires a kernel taking its input by value, "
+                  "but '%0' uses pointer parameters") << Name;
+      return false;
+    }
+
+    // Each lane of a variant holds one cell, so only scalar cells can be
+    // packed into the vectors.
+    const RSExportForEach::InTypeVec &InTypes = EFE->getInTypes();
+    bool ScalarCells = true;
+    for (size_t i = 0; i < InTypes.size(); i++) {
+      if (InTypes[i]->getClass() != RSExportType::ExportClassPrimitive)
+        ScalarCells = false;
+    }
+    if ((EFE->getOutType() != nullptr) &&
+        (EFE->getOutType()->getClass() != RSExportType::ExportClassPrimitive)) {
+      ScalarCells = false;
+    }
+    if (!ScalarCells) {
+      ReportError("multiversion requires a kernel with scalar inputs and "
+                  "output, but '%0' is not one") << Name;
+      return false;
+    }
+
+    EFE->mMultiversioned = true;
+    return true;
+  }
+
+  ReportError("multiversion requires a kernel, but '%0' is not one") << Name;
+  return false;
+}
+
+bool RSContext::hasSpecializedExportVar() const {
+  for (ExportVarList::const_iterator I = mExportVars.begin(),
+           E = mExportVars.end();
+       I != E;
+       I++) {
+    if ((*I)->isSpecialized())
+      return true;
+  }
+  return false;
+}
+
+void RSContext::addReduce(const ReduceSpec &Spec) {
+  for (ReduceSpecList::const_iterator I = mReduceSpecs.begin(),
+           E = mReduceSpecs.end();
+       I != E;
+       I++) {
+    if (I->Name == Spec.Name) {
+      ReportError(Spec.Loc, "reduction kernel '%0' is already defined")
+          << Spec.Name;
+      return;
+    }
+  }
+
+  mReduceSpecs.push_back(Spec);
+  mReduceFuncs.insert(Spec.Accumulator);
+  if (!Spec.Initializer.empty())
+    mReduceFuncs.insert(Spec.Initializer);
+  if (!Spec.Combiner.empty())
+    mReduceFuncs.insert(Spec.Combiner);
+  if (!Spec.OutConverter.empty())
+    mReduceFuncs.insert(Spec.OutConverter);
+}
+
+bool RSContext::processExportReduce(
+    const ReduceSpec &Spec,
+    const llvm::StringMap<const clang::FunctionDecl*> &ReduceFuncDecls) {
+  if (mTargetAPI != SLANG_DEVELOPMENT_TARGET_API) {
+    ReportError(Spec.Loc, "reduction kernel '%0' is not supported in SDK "
+                          "levels %1-%2")
+        << Spec.Name << SLANG_MINIMUM_TARGET_API << SLANG_MAXIMUM_TARGET_API;
+    return false;
+  }
+
+  const std::string *Names[] = {
+    &Spec.Accumulator, &Spec.Initializer, &Spec.Combiner, &Spec.OutConverter
+  };
+  const clang::FunctionDecl *FDs[] = { nullptr, nullptr, nullptr, nullptr };
+  bool valid = true;
+
+  for (unsigned i = 0; i < sizeof(Names) / sizeof(Names[0]); i++) {
+    if (Names[i]->empty())
+      continue;
+
+    llvm::StringMap<const clang::FunctionDecl*>::const_iterator I =
+        ReduceFuncDecls.find(*Names[i]);
+    if (I == ReduceFuncDecls.end()) {
+      ReportError(Spec.Loc, "reduction kernel '%0' refers to undefined "
+                            "function %1()")
+          << Spec.Name << *Names[i];
+      valid = false;
+      continue;
+    }
+
+    // A static function is only emitted because RSBackend marks it as used,
+    // which it can only do if the pragma was seen first.
+    FDs[i] = I->getValue();
+    if ((FDs[i]->getStorageClass() == clang::SC_Static) &&
+        !FDs[i]->hasAttr<clang::UsedAttr>()) {
+      ReportError(FDs[i]->getLocation(), "static function %0() must be "
+                                         "defined after the pragma of "
+                                         "reduction kernel '%1'")
+          << *Names[i] << Spec.Name;
+      valid = false;
+    }
+  }
+
+  if (!valid)
+    return false;
+
+  RSExportReduce *ER =
+      RSExportReduce::Create(this, Spec, FDs[0], FDs[1], FDs[2], FDs[3]);
+  if (ER == nullptr)
+    return false;
+
+  mExportReduce.push_back(ER);
+  return true;
+}
+
+// Returns the exported variable @Name if it can hold the array of field @F,
+// i.e., if it is a non-const pointer to the type of @F.
+static const RSExportVar *
+FindSoAFieldVar(const RSContext::ExportVarList &Vars, const std::string &Name,
+                const RSExportRecordType::Field *F) {
+  for (RSContext::ExportVarList::const_iterator I = Vars.begin(),
+           E = Vars.end();
+       I != E;
+       I++) {
+    const RSExportVar *EV = *I;
+    if (EV->getName() != Name)
+      continue;
+
+    const RSExportType *ET = EV->getType();
+    if (EV->isConst() || (ET->getClass() != RSExportType::ExportClassPointer))
+      return nullptr;
+
+    const RSExportType *PointeeType =
+        static_cast<const RSExportPointerType*>(ET)->getPointeeType();
+    if (PointeeType->getName() != F->getType()->getName())
+      return nullptr;
+
+    return EV;
+  }
+  return nullptr;
+}
+
+void RSContext::collectSoABindings(const RSExportRecordType *ERT) {
+  if (ERT->getFields().empty())
+    return;
+
+  // Every group contains a variable for the first field, so use those
+  // variables to find the candidate prefixes.
+  const std::string FirstSuffix = "_" + ERT->getFields().front()->getName();
+
+  for (ExportVarList::const_iterator I = mExportVars.begin(),
+           E = mExportVars.end();
+       I != E;
+       I++) {
+    llvm::StringRef VarName((*I)->getName());
+    if ((VarName.size() <= FirstSuffix.size()) ||
+        !VarName.endswith(FirstSuffix))
+      continue;
+
+    SoABinding B;
+    B.Type = ERT;
+    B.Prefix = VarName.drop_back(FirstSuffix.size());
+
+    for (RSExportRecordType::const_field_iterator FI = ERT->fields_begin(),
+             FE = ERT->fields_end();
+         FI != FE;
+         FI++) {
+      const RSExportVar *EV =
+          FindSoAFieldVar(mExportVars, B.Prefix + "_" + (*FI)->getName(), *FI);
+      if (EV == nullptr)
+        break;
+      B.FieldVars.push_back(EV);
+    }
+
+    if (B.FieldVars.size() == ERT->getFields().size())
+      mSoABindings.push_back(B);
+  }
 }
 
 
@@ -200,6 +538,73 @@ void RSContext::cleanupForEach() {
 }
 
 
+bool RSContext::isLocInRSHeaderFile(const clang::SourceLocation &Loc) {
+  if (Loc.isInvalid())
+    return false;
+
+  const clang::SourceManager &SM = mPP.getSourceManager();
+  clang::FileID FID = SM.getFileID(SM.getExpansionLoc(Loc));
+
+  llvm::DenseMap<unsigned, bool>::const_iterator I =
+      mRSHeaderFileIDs.find(FID.getHashValue());
+  if (I != mRSHeaderFileIDs.end())
+    return I->second;
+
+  bool IsRSHeader = SlangRS::IsLocInRSHeaderFile(Loc, SM);
+  mRSHeaderFileIDs[FID.getHashValue()] = IsRSHeader;
+  return IsRSHeader;
+}
+
+void RSContext::addTopLevelDecl(clang::Decl *D) {
+  clang::SourceLocation Loc = D->getLocation();
+  if (Loc.isInvalid() || isLocInRSHeaderFile(Loc))
+    return;
+  mUserDecls.push_back(D);
+}
+
+std::string
+RSContext::applyFunctionPrecision(const clang::FunctionDecl *FD) {
+  const clang::SourceManager *SM = getSourceManager();
+  std::string Precision;
+
+  while (!mPendingFunctionPrecisions.empty() &&
+         SM->isBeforeInTranslationUnit(
+             mPendingFunctionPrecisions.front().first, FD->getLocStart())) {
+    if (!Precision.empty()) {
+      ReportWarning(mPendingFunctionPrecisions.front().first,
+                    "fp_precision pragma overrides the previous one, which "
+                    "is not followed by a function definition");
+    }
+    Precision = mPendingFunctionPrecisions.front().second;
+    mPendingFunctionPrecisions.pop_front();
+  }
+
+  if (Precision.empty())
+    return Precision;
+
+  // Keep a pragma preceding a prototype from reaching the next, unrelated,
+  // function definition.
+  if (!FD->isThisDeclarationADefinition()) {
+    ReportWarning(FD->getLocation(),
+                  "fp_precision pragma ignored for %0(), which is not a "
+                  "function definition")
+        << FD->getName();
+    return "";
+  }
+
+  mFunctionPrecisions[FD] = Precision;
+  return Precision;
+}
+
+std::string
+RSContext::getFunctionPrecision(const clang::FunctionDecl *FD) const {
+  llvm::DenseMap<const clang::FunctionDecl*, std::string>::const_iterator I =
+      mFunctionPrecisions.find(FD);
+  if (I == mFunctionPrecisions.end())
+    return "";
+  return I->second;
+}
+
 bool RSContext::processExport() {
   bool valid = true;
 
@@ -207,20 +612,30 @@ bool RSContext::processExport() {
     return false;
   }
 
-  // Export variable
-  clang::TranslationUnitDecl *TUDecl = mCtx.getTranslationUnitDecl();
-  for (clang::DeclContext::decl_iterator DI = TUDecl->decls_begin(),
-           DE = TUDecl->decls_end();
+  // The definitions of the functions of the reduction kernels, static or not
+  llvm::StringMap<const clang::FunctionDecl*> ReduceFuncDecls;
+
+  // Export variable. Only user declarations need to be visited, since the RS
+  // runtime headers never define anything to be exported.
+  for (const_user_decl_iterator DI = user_decls_begin(),
+           DE = user_decls_end();
        DI != DE;
        DI++) {
-    if (DI->getKind() == clang::Decl::Var) {
+    if ((*DI)->getKind() == clang::Decl::Function) {
+      clang::FunctionDecl *FD = (clang::FunctionDecl*) (*DI);
+      if (isReduceFunc(FD->getName()) && FD->isThisDeclarationADefinition()) {
+        ReduceFuncDecls[FD->getName()] = FD;
+      }
+    }
+
+    if ((*DI)->getKind() == clang::Decl::Var) {
       clang::VarDecl *VD = (clang::VarDecl*) (*DI);
       if (VD->getFormalLinkage() == clang::ExternalLinkage) {
         if (!processExportVar(VD)) {
           valid = false;
         }
       }
-    } else if (DI->getKind() == clang::Decl::Function) {
+    } else if ((*DI)->getKind() == clang::Decl::Function) {
       // Export functions
       clang::FunctionDecl *FD = (clang::FunctionDecl*) (*DI);
       if (FD->getFormalLinkage() == clang::ExternalLinkage) {
@@ -235,6 +650,52 @@ bool RSContext::processExport() {
     cleanupForEach();
   }
 
+  for (ReduceSpecList::const_iterator I = mReduceSpecs.begin(),
+           E = mReduceSpecs.end();
+       I != E;
+       I++) {
+    if (!processExportReduce(*I, ReduceFuncDecls)) {
+      valid = false;
+    }
+  }
+
+  // The per-function precisions are only recorded for the kernels.
+  for (FunctionPrecisionList::const_iterator
+           I = mPendingFunctionPrecisions.begin(),
+           E = mPendingFunctionPrecisions.end();
+       I != E;
+       I++) {
+    ReportWarning(I->first,
+                  "fp_precision pragma is not followed by a function "
+                  "definition");
+  }
+  for (const_user_decl_iterator DI = user_decls_begin(),
+           DE = user_decls_end();
+       DI != DE;
+       DI++) {
+    const clang::FunctionDecl *FD =
+        llvm::dyn_cast<clang::FunctionDecl>(*DI);
+    if ((FD == nullptr) || (mFunctionPrecisions.count(FD) == 0))
+      continue;
+
+    bool IsKernel = false;
+    for (ExportForEachList::const_iterator FI = mExportForEach.begin(),
+             FE = mExportForEach.end();
+         FI != FE;
+         FI++) {
+      if ((*FI)->getName() == FD->getName()) {
+        IsKernel = true;
+        break;
+      }
+    }
+    if (!IsKernel) {
+      ReportWarning(FD->getLocation(),
+                    "fp_precision pragma ignored for %0(), which is not a "
+                    "kernel")
+          << FD->getName();
+    }
+  }
+
   // Finally, export type forcely set to be exported by user
   for (NeedExportTypeSet::const_iterator EI = mNeedExportTypes.begin(),
            EE = mNeedExportTypes.end();
@@ -245,6 +706,44 @@ bool RSContext::processExport() {
     }
   }
 
+  for (NeedExportTypeSet::const_iterator EI = mNeedBatchInvokeFuncs.begin(),
+           EE = mNeedBatchInvokeFuncs.end();
+       EI != EE;
+       EI++) {
+    if (!processBatchInvokeFunc(EI->getKey())) {
+      valid = false;
+    }
+  }
+
+  for (NeedExportTypeSet::const_iterator EI = mNeedSpecializeVars.begin(),
+           EE = mNeedSpecializeVars.end();
+       EI != EE;
+       EI++) {
+    if (!processSpecializeVar(EI->getKey())) {
+      valid = false;
+    }
+  }
+
+  for (NeedExportTypeSet::const_iterator EI = mNeedMultiversionKernels.begin(),
+           EE = mNeedMultiversionKernels.end();
+       EI != EE;
+       EI++) {
+    if (!processMultiversionKernel(EI->getKey())) {
+      valid = false;
+    }
+  }
+
+  // Types in structure-of-arrays layout are validated once all the exported
+  // variables are known, since their per-field variables are bound together.
+  for (NeedExportTypeSet::const_iterator EI = mNeedExportSoATypes.begin(),
+           EE = mNeedExportSoATypes.end();
+       EI != EE;
+       EI++) {
+    if (!processExportSoAType(EI->getKey())) {
+      valid = false;
+    }
+  }
+
   return valid;
 }
 
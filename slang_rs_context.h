@@ -21,10 +21,13 @@
 #include <list>
 #include <map>
 #include <string>
+#include <utility>
+#include <vector>
 
 #include "clang/Lex/Preprocessor.h"
 #include "clang/AST/Mangle.h"
 
+#include "llvm/ADT/DenseMap.h"
 #include "llvm/ADT/StringSet.h"
 #include "llvm/ADT/StringMap.h"
 
@@ -36,6 +39,7 @@ namespace llvm {
 }   // namespace llvm
 
 namespace clang {
+  class Decl;
   class VarDecl;
   class ASTContext;
   class TargetInfo;
@@ -48,7 +52,9 @@ namespace slang {
   class RSExportVar;
   class RSExportFunc;
   class RSExportForEach;
+  class RSExportReduce;
   class RSExportType;
+  class RSExportRecordType;
 
 class RSContext {
   typedef llvm::StringSet<> NeedExportVarSet;
@@ -60,7 +66,35 @@ class RSContext {
   typedef std::list<RSExportVar*> ExportVarList;
   typedef std::list<RSExportFunc*> ExportFuncList;
   typedef std::list<RSExportForEach*> ExportForEachList;
+  typedef std::list<RSExportReduce*> ExportReduceList;
   typedef llvm::StringMap<RSExportType*> ExportTypeMap;
+  typedef std::vector<clang::Decl*> UserDeclList;
+  typedef std::list<const RSExportRecordType*> ExportSoATypeList;
+
+  // A group of exported pointer variables named <Prefix>_<field name>, one
+  // per field of a struct exported with "#pragma rs export_type_soa". Each of
+  // them holds the array of one field, so the group as a whole stores the
+  // struct in structure-of-arrays layout.
+  struct SoABinding {
+    const RSExportRecordType *Type;
+    std::string Prefix;
+    // The variable of each field, in field order
+    std::vector<const RSExportVar*> FieldVars;
+  };
+  typedef std::list<SoABinding> SoABindingList;
+
+  // The functions making up a reduction kernel, as named by
+  // "#pragma rs reduce(<Name>) accumulator(...) ...". Only the accumulator is
+  // mandatory, the other functions are empty if they were not given.
+  struct ReduceSpec {
+    std::string Name;
+    std::string Accumulator;
+    std::string Initializer;
+    std::string Combiner;
+    std::string OutConverter;
+    clang::SourceLocation Loc;
+  };
+  typedef std::list<ReduceSpec> ReduceSpecList;
 
  private:
   clang::Preprocessor &mPP;
@@ -69,15 +103,37 @@ class RSContext {
   // Precision specified via pragma, either rs_fp_full or rs_fp_relaxed. If
   // empty, rs_fp_full is assumed.
   std::string mPrecision;
+  // The "#pragma rs fp_precision" not yet given to a function definition, in
+  // source order. The parser may lex the pragmas following a definition before
+  // that definition reaches the backend, so they are matched by location.
+  typedef std::list<std::pair<clang::SourceLocation, std::string> >
+      FunctionPrecisionList;
+  FunctionPrecisionList mPendingFunctionPrecisions;
+  // Precisions of the functions defined after a "#pragma rs fp_precision".
+  // They override mPrecision for these functions.
+  llvm::DenseMap<const clang::FunctionDecl*, std::string> mFunctionPrecisions;
   unsigned int mTargetAPI;
   bool mVerbose;
 
+  // Whether to warn about the kernel reads that keep the runtime from tiling
+  // the allocation (see RSExportForEach::collectFootprints()).
+  bool mWarnUntiledReads;
+
   llvm::DataLayout *mDataLayout;
   llvm::LLVMContext &mLLVMContext;
 
   ExportableList mExportables;
 
   NeedExportTypeSet mNeedExportTypes;
+  NeedExportTypeSet mNeedExportSoATypes;
+  NeedExportTypeSet mNeedBatchInvokeFuncs;
+  NeedExportTypeSet mNeedSpecializeVars;
+  NeedExportTypeSet mNeedMultiversionKernels;
+
+  ReduceSpecList mReduceSpecs;
+  // The names of all the functions referenced by mReduceSpecs. They are not
+  // reflected as invokables nor as kernels.
+  llvm::StringSet<> mReduceFuncs;
 
   std::string *mLicenseNote;
   std::string mReflectJavaPackageName;
@@ -91,16 +147,36 @@ class RSContext {
 
   bool mIs64Bit;
 
+  // Maps a FileID (by its hash value) to whether that file is one of the RS
+  // runtime headers. Each file is classified once, on first lookup.
+  llvm::DenseMap<unsigned, bool> mRSHeaderFileIDs;
+
+  // Top-level declarations coming from user files (i.e., not from the RS
+  // runtime headers), in the order they were parsed.
+  UserDeclList mUserDecls;
+
   bool processExportVar(const clang::VarDecl *VD);
   bool processExportFunc(const clang::FunctionDecl *FD);
+  RSExportType *createExportType(const llvm::StringRef &Name);
   bool processExportType(const llvm::StringRef &Name);
+  bool processExportSoAType(const llvm::StringRef &Name);
+  void collectSoABindings(const RSExportRecordType *ERT);
+  bool processBatchInvokeFunc(const llvm::StringRef &Name);
+  bool processSpecializeVar(const llvm::StringRef &Name);
+  bool processMultiversionKernel(const llvm::StringRef &Name);
+  bool processExportReduce(
+      const ReduceSpec &Spec,
+      const llvm::StringMap<const clang::FunctionDecl*> &ReduceFuncDecls);
 
   void cleanupForEach();
 
   ExportVarList mExportVars;
   ExportFuncList mExportFuncs;
   ExportForEachList mExportForEach;
+  ExportReduceList mExportReduce;
   ExportTypeMap mExportTypes;
+  ExportSoATypeList mExportSoATypes;
+  SoABindingList mSoABindings;
 
  public:
   RSContext(clang::Preprocessor &PP,
@@ -130,6 +206,12 @@ class RSContext {
   inline bool getVerbose() const {
     return mVerbose;
   }
+  inline void setWarnUntiledReads(bool Warn) {
+    mWarnUntiledReads = Warn;
+  }
+  inline bool getWarnUntiledReads() const {
+    return mWarnUntiledReads;
+  }
   inline bool is64Bit() const {
     return mIs64Bit;
   }
@@ -142,6 +224,27 @@ class RSContext {
   inline void addExportType(const std::string &S) {
     mNeedExportTypes.insert(S);
   }
+  inline void addExportSoAType(const std::string &S) {
+    mNeedExportTypes.insert(S);
+    mNeedExportSoATypes.insert(S);
+  }
+
+  inline void addBatchInvokeFunc(const std::string &S) {
+    mNeedBatchInvokeFuncs.insert(S);
+  }
+
+  inline void addSpecializeVar(const std::string &S) {
+    mNeedSpecializeVars.insert(S);
+  }
+
+  inline void addMultiversionKernel(const std::string &S) {
+    mNeedMultiversionKernels.insert(S);
+  }
+
+  void addReduce(const ReduceSpec &Spec);
+  inline bool isReduceFunc(const llvm::StringRef &Name) const {
+    return mReduceFuncs.count(Name) != 0;
+  }
 
   inline void setReflectJavaPackageName(const std::string &S) {
     mReflectJavaPackageName = S;
@@ -156,6 +259,22 @@ class RSContext {
 
   inline const std::string &getRSPackageName() const { return mRSPackageName; }
 
+  // Returns true if @Loc is located in one of the RS runtime headers.
+  bool isLocInRSHeaderFile(const clang::SourceLocation &Loc);
+
+  // Record a top-level declaration. Declarations from the RS runtime headers
+  // and compiler-synthesized declarations (without a valid location) are
+  // skipped.
+  void addTopLevelDecl(clang::Decl *D);
+
+  typedef UserDeclList::const_iterator const_user_decl_iterator;
+  const_user_decl_iterator user_decls_begin() const {
+    return mUserDecls.begin();
+  }
+  const_user_decl_iterator user_decls_end() const {
+    return mUserDecls.end();
+  }
+
   bool processExport();
   inline void newExportable(RSExportable *E) {
     if (E != nullptr)
@@ -179,6 +298,8 @@ class RSContext {
   inline bool hasExportVar() const {
     return !mExportVars.empty();
   }
+  // Whether some exported variable is listed in "#pragma rs specialize"
+  bool hasSpecializedExportVar() const;
 
   typedef ExportFuncList::const_iterator const_export_func_iterator;
   const_export_func_iterator export_funcs_begin() const {
@@ -198,6 +319,15 @@ class RSContext {
   }
   inline bool hasExportForEach() const { return !mExportForEach.empty(); }
 
+  typedef ExportReduceList::const_iterator const_export_reduce_iterator;
+  const_export_reduce_iterator export_reduce_begin() const {
+    return mExportReduce.begin();
+  }
+  const_export_reduce_iterator export_reduce_end() const {
+    return mExportReduce.end();
+  }
+  inline bool hasExportReduce() const { return !mExportReduce.empty(); }
+
   typedef ExportTypeMap::iterator export_type_iterator;
   typedef ExportTypeMap::const_iterator const_export_type_iterator;
   export_type_iterator export_types_begin() { return mExportTypes.begin(); }
@@ -217,6 +347,23 @@ class RSContext {
     return mExportTypes.find(TypeName);
   }
 
+  typedef ExportSoATypeList::const_iterator const_export_soa_type_iterator;
+  const_export_soa_type_iterator export_soa_types_begin() const {
+    return mExportSoATypes.begin();
+  }
+  const_export_soa_type_iterator export_soa_types_end() const {
+    return mExportSoATypes.end();
+  }
+  inline bool hasExportSoAType() const { return !mExportSoATypes.empty(); }
+
+  typedef SoABindingList::const_iterator const_soa_binding_iterator;
+  const_soa_binding_iterator soa_bindings_begin() const {
+    return mSoABindings.begin();
+  }
+  const_soa_binding_iterator soa_bindings_end() const {
+    return mSoABindings.end();
+  }
+
   // Insert the specified Typename/Type pair into the map. If the key already
   // exists in the map, return false and ignore the request, otherwise insert it
   // and return true.
@@ -239,6 +386,19 @@ class RSContext {
   void setPrecision(const std::string &P) { mPrecision = P; }
   std::string getPrecision() { return mPrecision; }
 
+  void addFunctionPrecision(const std::string &P,
+                            const clang::SourceLocation &Loc) {
+    mPendingFunctionPrecisions.push_back(std::make_pair(Loc, P));
+  }
+  // Give the last pending "#pragma rs fp_precision" preceding the function
+  // declaration @FD to @FD. The pragmas are consumed even if @FD is not a
+  // definition, in which case they are ignored with a warning. Returns the
+  // precision given to @FD, or an empty string if there is none.
+  std::string applyFunctionPrecision(const clang::FunctionDecl *FD);
+  // Returns the precision @FD was given by "#pragma rs fp_precision", or an
+  // empty string if it uses the precision of the file.
+  std::string getFunctionPrecision(const clang::FunctionDecl *FD) const;
+
   // Report an error or a warning to the user.
   template <unsigned N>
   clang::DiagnosticBuilder Report(clang::DiagnosticsEngine::Level Level,
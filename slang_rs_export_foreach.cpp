@@ -16,13 +16,17 @@
 
 #include "slang_rs_export_foreach.h"
 
+#include <algorithm>
 #include <string>
 
 #include "clang/AST/ASTContext.h"
 #include "clang/AST/Attr.h"
 #include "clang/AST/Decl.h"
+#include "clang/AST/Expr.h"
 #include "clang/AST/TypeLoc.h"
 
+#include "llvm/ADT/APSInt.h"
+#include "llvm/ADT/StringSet.h"
 #include "llvm/IR/DerivedTypes.h"
 
 #include "slang_assert.h"
@@ -32,6 +36,125 @@
 
 namespace slang {
 
+namespace {
+
+// Appends to @Accesses the calls to rsGetElementAt() and rsGetElementAt_*()
+// found in @S.
+void CollectElementAccesses(
+    clang::Stmt *S, llvm::SmallVectorImpl<const clang::CallExpr*> *Accesses) {
+  if (S == nullptr)
+    return;
+
+  if (const clang::CallExpr *CE = llvm::dyn_cast<clang::CallExpr>(S)) {
+    const clang::FunctionDecl *Callee = CE->getDirectCallee();
+    if ((Callee != nullptr) && (CE->getNumArgs() >= 2) &&
+        (Callee->getIdentifier() != nullptr)) {
+      llvm::StringRef Name = Callee->getName();
+      if (Name.equals("rsGetElementAt") || Name.startswith("rsGetElementAt_"))
+        Accesses->push_back(CE);
+    }
+  }
+
+  for (clang::Stmt::child_iterator I = S->child_begin(), E = S->child_end();
+       I != E;
+       I++) {
+    CollectElementAccesses(*I, Accesses);
+  }
+}
+
+// Returns the global rs_allocation variable referred to by @E, if any.
+const clang::VarDecl *GetGlobalAllocation(const clang::Expr *E) {
+  const clang::DeclRefExpr *DRE =
+      llvm::dyn_cast<clang::DeclRefExpr>(E->IgnoreParenImpCasts());
+  if (DRE == nullptr)
+    return nullptr;
+
+  const clang::VarDecl *VD = llvm::dyn_cast<clang::VarDecl>(DRE->getDecl());
+  if ((VD == nullptr) || !VD->hasGlobalStorage())
+    return nullptr;
+  return VD;
+}
+
+// Returns true if @S may modify the variable @VD, i.e., assigns it, increments
+// or decrements it, or takes its address.
+bool IsModified(clang::Stmt *S, const clang::VarDecl *VD) {
+  if (S == nullptr)
+    return false;
+
+  const clang::Expr *Target = nullptr;
+  if (const clang::BinaryOperator *BO =
+          llvm::dyn_cast<clang::BinaryOperator>(S)) {
+    if (BO->isAssignmentOp())
+      Target = BO->getLHS();
+  } else if (const clang::UnaryOperator *UO =
+                 llvm::dyn_cast<clang::UnaryOperator>(S)) {
+    if (UO->isIncrementDecrementOp() ||
+        (UO->getOpcode() == clang::UO_AddrOf))
+      Target = UO->getSubExpr();
+  }
+  if (Target != nullptr) {
+    const clang::DeclRefExpr *DRE =
+        llvm::dyn_cast<clang::DeclRefExpr>(Target->IgnoreParenImpCasts());
+    if ((DRE != nullptr) && (DRE->getDecl() == VD))
+      return true;
+  }
+
+  for (clang::Stmt::child_iterator I = S->child_begin(), E = S->child_end();
+       I != E;
+       I++) {
+    if (IsModified(*I, VD))
+      return true;
+  }
+  return false;
+}
+
+// Returns true if @E is the coordinate @Coord plus or minus a constant, which
+// is then stored in @Offset. Returns false if the kernel does not iterate over
+// the dimension (@Coord is null): a constant coordinate is then an absolute
+// one, not an offset.
+bool GetCoordOffset(const clang::ASTContext &C, const clang::Expr *E,
+                    const clang::ParmVarDecl *Coord, int *Offset) {
+  if (Coord == nullptr)
+    return false;
+
+  E = E->IgnoreParenImpCasts();
+  if (const clang::DeclRefExpr *DRE = llvm::dyn_cast<clang::DeclRefExpr>(E)) {
+    *Offset = 0;
+    return (DRE->getDecl() == Coord);
+  }
+
+  const clang::BinaryOperator *BO = llvm::dyn_cast<clang::BinaryOperator>(E);
+  if ((BO == nullptr) ||
+      ((BO->getOpcode() != clang::BO_Add) &&
+       (BO->getOpcode() != clang::BO_Sub))) {
+    return false;
+  }
+
+  // The constant is evaluated before its conversion to the (unsigned) type of
+  // the coordinate so that "x + (-1)" gives -1.
+  llvm::APSInt Delta;
+  int Base;
+  if (BO->getRHS()->IgnoreParenImpCasts()->EvaluateAsInt(Delta, C) &&
+      GetCoordOffset(C, BO->getLHS(), Coord, &Base)) {
+    if (BO->getOpcode() == clang::BO_Sub)
+      Delta = -Delta;
+  } else if ((BO->getOpcode() == clang::BO_Add) &&
+             BO->getLHS()->IgnoreParenImpCasts()->EvaluateAsInt(Delta, C) &&
+             GetCoordOffset(C, BO->getRHS(), Coord, &Base)) {
+    // "constant + x"
+  } else {
+    return false;
+  }
+
+  if (Delta.getMinSignedBits() > 16)
+    return false;
+
+  *Offset = Base + static_cast<int>(Delta.getSExtValue());
+  return true;
+}
+
+}  // namespace
+
 // This function takes care of additional validation and construction of
 // parameters related to forEach_* reflection.
 bool RSExportForEach::validateAndConstructParams(
@@ -334,6 +457,88 @@ bool RSExportForEach::setSignatureMetadata(RSContext *Context,
   return valid;
 }
 
+void RSExportForEach::collectFootprints(RSContext *Context,
+                                        const clang::FunctionDecl *FD) {
+  const clang::ASTContext &C = Context->getASTContext();
+  llvm::SmallVector<const clang::CallExpr*, 8> Accesses;
+  llvm::StringSet<> DataDependent;
+
+  CollectElementAccesses(FD->getBody(), &Accesses);
+
+  // A coordinate parameter the kernel modifies is no longer the coordinate
+  // of the cell being computed, so the reads at it are data dependent.
+  const clang::ParmVarDecl *X = mX;
+  const clang::ParmVarDecl *Y = mY;
+  if ((X != nullptr) && IsModified(FD->getBody(), X))
+    X = nullptr;
+  if ((Y != nullptr) && IsModified(FD->getBody(), Y))
+    Y = nullptr;
+
+  for (size_t i = 0; i < Accesses.size(); i++) {
+    const clang::CallExpr *CE = Accesses[i];
+    const clang::VarDecl *VD = GetGlobalAllocation(CE->getArg(0));
+    if (VD == nullptr)
+      continue;
+
+    // All the threads reading the same cell is neither a stencil nor a
+    // data-dependent access.
+    unsigned NumCoords = CE->getNumArgs() - 1;
+    bool Uniform = true;
+    for (unsigned j = 1; j <= NumCoords; j++) {
+      if (!CE->getArg(j)->isEvaluatable(C))
+        Uniform = false;
+    }
+    if (Uniform)
+      continue;
+
+    // The z coordinate is not an iteration parameter (yet), so any 3D access
+    // is data dependent.
+    int DX = 0, DY = 0;
+    bool Stencil = (NumCoords <= 2) &&
+                   GetCoordOffset(C, CE->getArg(1), X, &DX) &&
+                   ((NumCoords < 2) ||
+                    GetCoordOffset(C, CE->getArg(2), Y, &DY));
+
+    if (!Stencil) {
+      if (Context->getWarnUntiledReads() &&
+          !DataDependent.count(VD->getName())) {
+        DataDependent.insert(VD->getName());
+        Context->ReportWarning(CE->getLocStart(),
+                               "Kernel %0() reads allocation '%1' at "
+                               "data-dependent coordinates, which prevents "
+                               "the runtime from tiling it")
+            << FD->getName() << VD->getName();
+      }
+      continue;
+    }
+
+    size_t j = 0;
+    while ((j < mFootprints.size()) &&
+           (mFootprints[j].Allocation != VD->getName())) {
+      j++;
+    }
+    if (j == mFootprints.size()) {
+      Footprint F = { VD->getName(), DX, DX, DY, DY };
+      mFootprints.push_back(F);
+      continue;
+    }
+
+    Footprint &F = mFootprints[j];
+    F.MinX = std::min(F.MinX, DX);
+    F.MaxX = std::max(F.MaxX, DX);
+    F.MinY = std::min(F.MinY, DY);
+    F.MaxY = std::max(F.MaxY, DY);
+  }
+
+  for (size_t j = 0; j < mFootprints.size();) {
+    if (DataDependent.count(mFootprints[j].Allocation)) {
+      mFootprints.erase(mFootprints.begin() + j);
+    } else {
+      j++;
+    }
+  }
+}
+
 RSExportForEach *RSExportForEach::Create(RSContext *Context,
                                          const clang::FunctionDecl *FD) {
   slangAssert(Context && FD);
@@ -348,6 +553,10 @@ RSExportForEach *RSExportForEach::Create(RSContext *Context,
     return nullptr;
   }
 
+  FE->mPrecision = Context->getFunctionPrecision(FD);
+
+  FE->collectFootprints(Context, FD);
+
   clang::ASTContext &Ctx = Context->getASTContext();
 
   std::string Id = CreateDummyName("helper_foreach_param", FE->getName());
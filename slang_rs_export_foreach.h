@@ -37,6 +37,8 @@ namespace slang {
 // Base class for reflecting control-side forEach (currently for root()
 // functions that fit appropriate criteria)
 class RSExportForEach : public RSExportable {
+  friend class RSContext;
+
  public:
 
   typedef llvm::SmallVectorImpl<const clang::ParmVarDecl*> InVec;
@@ -45,6 +47,16 @@ class RSExportForEach : public RSExportable {
   typedef InVec::const_iterator InIter;
   typedef InTypeVec::const_iterator InTypeIter;
 
+  // The neighborhood of the current cell that a kernel reads from a global
+  // allocation, i.e., the range of the constant offsets that it adds to its x
+  // and y coordinates when calling rsGetElementAt*().
+  struct Footprint {
+    std::string Allocation;
+    int MinX, MaxX;
+    int MinY, MaxY;
+  };
+  typedef llvm::SmallVectorImpl<Footprint> FootprintVec;
+
  private:
   std::string mName;
   RSExportRecordType *mParamPacketType;
@@ -66,6 +78,17 @@ class RSExportForEach : public RSExportable {
 
   bool mDummyRoot;
 
+  // Whether the kernel is listed in "#pragma rs multiversion"
+  bool mMultiversioned;
+
+  // Precision given by "#pragma rs fp_precision", empty if the kernel uses
+  // the precision of the file.
+  std::string mPrecision;
+
+  // The footprint of each allocation that is only read at constant offsets
+  // of the coordinates
+  llvm::SmallVector<Footprint, 2> mFootprints;
+
   // TODO(all): Add support for LOD/face when we have them
   RSExportForEach(RSContext *Context, const llvm::StringRef &Name)
     : RSExportable(Context, RSExportable::EX_FOREACH),
@@ -73,7 +96,7 @@ class RSExportForEach : public RSExportable {
       mOutType(nullptr), numParams(0), mSignatureMetadata(0),
       mOut(nullptr), mUsrData(nullptr), mX(nullptr), mY(nullptr),
       mResultType(clang::QualType()), mHasReturnType(false),
-      mIsKernelStyle(false), mDummyRoot(false) {
+      mIsKernelStyle(false), mDummyRoot(false), mMultiversioned(false) {
   }
 
   bool validateAndConstructParams(RSContext *Context,
@@ -91,6 +114,10 @@ class RSExportForEach : public RSExportable {
 
   bool setSignatureMetadata(RSContext *Context,
                             const clang::FunctionDecl *FD);
+
+  // Warns about the allocations read at data-dependent coordinates, whose
+  // footprint is unknown.
+  void collectFootprints(RSContext *Context, const clang::FunctionDecl *FD);
  public:
   static RSExportForEach *Create(RSContext *Context,
                                  const clang::FunctionDecl *FD);
@@ -125,6 +152,11 @@ class RSExportForEach : public RSExportable {
     return mIns;
   }
 
+  // The output pointer parameter of an old-style kernel (if any)
+  inline const clang::ParmVarDecl *getOut() const {
+    return mOut;
+  }
+
   inline const InTypeVec& getInTypes() const {
     return mInTypes;
   }
@@ -145,6 +177,24 @@ class RSExportForEach : public RSExportable {
     return mDummyRoot;
   }
 
+  inline bool isKernelStyle() const {
+    return mIsKernelStyle;
+  }
+
+  // The backend then also emits the variants of the kernel processing 4 and
+  // 8 cells at once (if its code allows it).
+  inline bool isMultiversioned() const {
+    return mMultiversioned;
+  }
+
+  inline const std::string &getPrecision() const {
+    return mPrecision;
+  }
+
+  inline const FootprintVec &getFootprints() const {
+    return mFootprints;
+  }
+
   typedef RSExportRecordType::const_field_iterator const_param_iterator;
 
   inline const_param_iterator params_begin() const {
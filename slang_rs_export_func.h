@@ -49,6 +49,8 @@ class RSExportFunc : public RSExportable {
   std::string mMangledName;
   bool mShouldMangle;
   RSExportRecordType *mParamPacketType;
+  // Whether the function is listed in "#pragma rs batch_invoke"
+  bool mBatched;
 
   RSExportFunc(RSContext *Context, const llvm::StringRef &Name,
                const clang::FunctionDecl *FD)
@@ -56,7 +58,8 @@ class RSExportFunc : public RSExportable {
       mName(Name.data(), Name.size()),
       mMangledName(),
       mShouldMangle(false),
-      mParamPacketType(nullptr) {
+      mParamPacketType(nullptr),
+      mBatched(false) {
 
     mShouldMangle = Context->getMangleContext().shouldMangleDeclName(FD);
 
@@ -96,6 +99,10 @@ class RSExportFunc : public RSExportable {
   inline const RSExportRecordType *getParamPacketType() const
     { return mParamPacketType; }
 
+  // A batched function gets an additional invokable, .helper_batch_<name>,
+  // that calls it once per parameter packet of an array.
+  inline bool isBatched() const { return mBatched; }
+
   // Check whether the given ParamsPacket type (in LLVM type) is "size
   // equivalent" to the one obtained from getParamPacketType(). If the @Params
   // is nullptr, means there must be no any parameters.
@@ -0,0 +1,307 @@
+/*
+ * Copyright 2014, The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "slang_rs_export_reduce.h"
+
+#include <string>
+
+#include "clang/AST/ASTContext.h"
+#include "clang/AST/Decl.h"
+
+#include "slang_assert.h"
+#include "slang_rs_context.h"
+#include "slang_rs_export_type.h"
+
+namespace slang {
+
+namespace {
+
+// The result is returned by value from the reflected reduce_<name>(), so it
+// must be a scalar or a vector that the reflected code knows how to unpack.
+bool IsValidResultType(const RSExportType *ET) {
+  if ((ET->getClass() != RSExportType::ExportClassPrimitive) &&
+      (ET->getClass() != RSExportType::ExportClassVector)) {
+    return false;
+  }
+
+  switch (static_cast<const RSExportPrimitiveType *>(ET)->getType()) {
+    case DataTypeFloat16:
+    case DataTypeFloat32:
+    case DataTypeFloat64:
+    case DataTypeSigned8:
+    case DataTypeSigned16:
+    case DataTypeSigned32:
+    case DataTypeSigned64:
+    case DataTypeUnsigned8:
+    case DataTypeUnsigned16:
+    case DataTypeUnsigned32:
+    case DataTypeUnsigned64:
+    case DataTypeBoolean:
+      return true;
+    default:
+      return false;
+  }
+}
+
+// Returns the type pointed to by @QT if @QT is a pointer whose pointee has the
+// given constness, or a null type otherwise.
+clang::QualType GetPointeeType(clang::QualType QT, bool IsConst) {
+  QT = QT.getCanonicalType();
+  if (!QT->isPointerType()) {
+    return clang::QualType();
+  }
+  clang::QualType PointeeType = QT->getPointeeType();
+  if (PointeeType.isConstQualified() != IsConst) {
+    return clang::QualType();
+  }
+  return PointeeType.getUnqualifiedType();
+}
+
+}  // namespace
+
+bool RSExportReduce::validateAndConstructAccumulator(
+    RSContext *Context, const clang::FunctionDecl *FD,
+    clang::QualType *AccumType) {
+  slangAssert(Context && FD && AccumType);
+  clang::ASTContext &C = Context->getASTContext();
+  bool valid = true;
+
+  if (FD->getReturnType().getCanonicalType() != C.VoidTy) {
+    Context->ReportError(FD->getLocation(),
+                         "Accumulator %0() of reduction kernel '%1' is "
+                         "required to return a void type")
+        << FD->getName() << mName;
+    valid = false;
+  }
+
+  if (FD->getNumParams() < 2) {
+    Context->ReportError(FD->getLocation(),
+                         "Accumulator %0() of reduction kernel '%1' must have "
+                         "an accumulator pointer parameter followed by at "
+                         "least one input parameter")
+        << FD->getName() << mName;
+    return false;
+  }
+
+  const clang::ParmVarDecl *AccumPVD = FD->getParamDecl(0);
+  *AccumType = GetPointeeType(AccumPVD->getType(), false);
+  if (AccumType->isNull()) {
+    Context->ReportError(AccumPVD->getLocation(),
+                         "Parameter '%0' of accumulator %1() must be a "
+                         "non-const pointer to the accumulator type")
+        << AccumPVD->getName() << FD->getName();
+    return false;
+  }
+
+  // The accumulators are allocated, copied and discarded by the runtime, which
+  // knows nothing about reference counting.
+  if ((*AccumType)->isPointerType() ||
+      RSExportPrimitiveType::IsRSObjectType(AccumType->getTypePtr())) {
+    Context->ReportError(AccumPVD->getLocation(),
+                         "Reduction kernel '%0' cannot use accumulator type "
+                         "'%1'")
+        << mName << AccumType->getAsString();
+    return false;
+  }
+
+  mAccumulatorType = RSExportType::Create(Context, AccumType->getTypePtr());
+  if (mAccumulatorType == nullptr) {
+    Context->ReportError(AccumPVD->getLocation(),
+                         "Reduction kernel '%0' cannot use accumulator type "
+                         "'%1'")
+        << mName << AccumType->getAsString();
+    return false;
+  }
+
+  for (unsigned i = 1; i < FD->getNumParams(); i++) {
+    const clang::ParmVarDecl *PVD = FD->getParamDecl(i);
+    clang::QualType QT = PVD->getType().getCanonicalType();
+    llvm::StringRef ParamName = PVD->getName();
+
+    if (ParamName.equals("x") || ParamName.equals("y") ||
+        ParamName.equals("z")) {
+      Context->ReportError(PVD->getLocation(),
+                           "Accumulator %0() of reduction kernel '%1' cannot "
+                           "have the special parameter '%2'")
+          << FD->getName() << mName << ParamName;
+      valid = false;
+      continue;
+    }
+
+    if (QT->isPointerType()) {
+      Context->ReportError(PVD->getLocation(),
+                           "Input parameter '%0' of accumulator %1() cannot "
+                           "be of pointer type: '%2'")
+          << ParamName << FD->getName() << PVD->getType().getAsString();
+      valid = false;
+      continue;
+    }
+
+    if (RSExportPrimitiveType::IsRSObjectType(QT.getTypePtr())) {
+      Context->ReportError(PVD->getLocation(),
+                           "Input parameter '%0' of accumulator %1() cannot "
+                           "be of RS object type: '%2'")
+          << ParamName << FD->getName() << PVD->getType().getAsString();
+      valid = false;
+      continue;
+    }
+
+    const RSExportType *InType = RSExportType::Create(Context,
+                                                      QT.getTypePtr());
+    if (InType == nullptr) {
+      valid = false;
+      continue;
+    }
+    mInTypes.push_back(InType);
+    mInNames.push_back(ParamName.str());
+  }
+
+  // Without a combiner, the accumulator folds the accumulators of the other
+  // threads as if they were input cells.
+  if (valid && mCombinerName.empty()) {
+    if ((FD->getNumParams() != 2) ||
+        !C.hasSameUnqualifiedType(FD->getParamDecl(1)->getType(),
+                                  *AccumType)) {
+      Context->ReportError(FD->getLocation(),
+                           "Reduction kernel '%0' requires a combiner since "
+                           "its accumulator %1() does not take a single input "
+                           "of the accumulator type '%2'")
+          << mName << FD->getName() << AccumType->getAsString();
+      valid = false;
+    }
+  }
+
+  return valid;
+}
+
+bool RSExportReduce::validateInitializer(RSContext *Context,
+                                         const clang::FunctionDecl *FD,
+                                         clang::QualType AccumType) {
+  slangAssert(Context && FD);
+  clang::ASTContext &C = Context->getASTContext();
+
+  if ((FD->getReturnType().getCanonicalType() != C.VoidTy) ||
+      (FD->getNumParams() != 1) ||
+      (GetPointeeType(FD->getParamDecl(0)->getType(), false) != AccumType)) {
+    Context->ReportError(FD->getLocation(),
+                         "Initializer %0() of reduction kernel '%1' must be "
+                         "of type 'void %0(%2 *)'")
+        << FD->getName() << mName << AccumType.getAsString();
+    return false;
+  }
+
+  return true;
+}
+
+bool RSExportReduce::validateCombiner(RSContext *Context,
+                                      const clang::FunctionDecl *FD,
+                                      clang::QualType AccumType) {
+  slangAssert(Context && FD);
+  clang::ASTContext &C = Context->getASTContext();
+
+  if ((FD->getReturnType().getCanonicalType() != C.VoidTy) ||
+      (FD->getNumParams() != 2) ||
+      (GetPointeeType(FD->getParamDecl(0)->getType(), false) != AccumType) ||
+      (GetPointeeType(FD->getParamDecl(1)->getType(), true) != AccumType)) {
+    Context->ReportError(FD->getLocation(),
+                         "Combiner %0() of reduction kernel '%1' must be of "
+                         "type 'void %0(%2 *, const %2 *)'")
+        << FD->getName() << mName << AccumType.getAsString();
+    return false;
+  }
+
+  return true;
+}
+
+bool RSExportReduce::validateAndConstructOutConverter(
+    RSContext *Context, const clang::FunctionDecl *FD,
+    clang::QualType AccumType) {
+  slangAssert(Context && FD);
+  clang::ASTContext &C = Context->getASTContext();
+
+  clang::QualType ResultType;
+  if (FD->getNumParams() == 2) {
+    ResultType = GetPointeeType(FD->getParamDecl(0)->getType(), false);
+  }
+
+  if ((FD->getReturnType().getCanonicalType() != C.VoidTy) ||
+      ResultType.isNull() ||
+      (GetPointeeType(FD->getParamDecl(1)->getType(), true) != AccumType)) {
+    Context->ReportError(FD->getLocation(),
+                         "Outconverter %0() of reduction kernel '%1' must be "
+                         "of type 'void %0(ResultType *, const %2 *)'")
+        << FD->getName() << mName << AccumType.getAsString();
+    return false;
+  }
+
+  if (ResultType->isPointerType() ||
+      RSExportPrimitiveType::IsRSObjectType(ResultType.getTypePtr())) {
+    return true;  // Reported by Create() as an invalid result type.
+  }
+
+  mResultType = RSExportType::Create(Context, ResultType.getTypePtr());
+  return true;
+}
+
+RSExportReduce *RSExportReduce::Create(
+    RSContext *Context, const RSContext::ReduceSpec &Spec,
+    const clang::FunctionDecl *Accumulator,
+    const clang::FunctionDecl *Initializer,
+    const clang::FunctionDecl *Combiner,
+    const clang::FunctionDecl *OutConverter) {
+  slangAssert(Context && Accumulator);
+
+  RSExportReduce *ER = new RSExportReduce(Context, Spec);
+
+  clang::QualType AccumType;
+  if (!ER->validateAndConstructAccumulator(Context, Accumulator, &AccumType)) {
+    return nullptr;
+  }
+
+  bool valid = true;
+  if (Initializer &&
+      !ER->validateInitializer(Context, Initializer, AccumType)) {
+    valid = false;
+  }
+  if (Combiner && !ER->validateCombiner(Context, Combiner, AccumType)) {
+    valid = false;
+  }
+
+  if (OutConverter) {
+    if (!ER->validateAndConstructOutConverter(Context, OutConverter,
+                                              AccumType)) {
+      return nullptr;
+    }
+  } else {
+    ER->mResultType = ER->mAccumulatorType;
+  }
+
+  if ((ER->mResultType == nullptr) || !IsValidResultType(ER->mResultType)) {
+    Context->ReportError(Spec.Loc,
+                         "Reduction kernel '%0' must produce a scalar or a "
+                         "vector result")
+        << ER->mName;
+    valid = false;
+  }
+
+  if (!valid) {
+    return nullptr;
+  }
+
+  return ER;
+}
+
+}  // namespace slang
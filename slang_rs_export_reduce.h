@@ -0,0 +1,131 @@
+/*
+ * Copyright 2014, The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef _FRAMEWORKS_COMPILE_SLANG_SLANG_RS_EXPORT_REDUCE_H_  // NOLINT
+#define _FRAMEWORKS_COMPILE_SLANG_SLANG_RS_EXPORT_REDUCE_H_
+
+#include <string>
+
+#include "llvm/ADT/SmallVector.h"
+
+#include "clang/AST/Type.h"
+
+#include "slang_rs_context.h"
+#include "slang_rs_exportable.h"
+
+namespace clang {
+  class FunctionDecl;
+}  // namespace clang
+
+namespace slang {
+
+class RSExportType;
+
+// A reduction kernel declared with
+//
+//   #pragma rs reduce(<name>) accumulator(<fn>) [initializer(<fn>)]
+//                             [combiner(<fn>)] [outconverter(<fn>)]
+//
+// with the functions:
+//
+//   void accumulator(T *accum, In1 in1, ..., InN inN);
+//   void initializer(T *accum);                    // zeroes accum if absent
+//   void combiner(T *accum, const T *other);       // accumulator if absent
+//   void outconverter(R *result, const T *accum);  // copies accum if absent
+//
+// Every thread folds its share of the input cells into a private accumulator
+// of type T, the accumulators are then combined and finally converted to the
+// result of type R.
+class RSExportReduce : public RSExportable {
+ public:
+  typedef llvm::SmallVectorImpl<const RSExportType*> InTypeVec;
+  typedef llvm::SmallVectorImpl<std::string> InNameVec;
+
+ private:
+  std::string mName;
+
+  std::string mAccumulatorName;
+  std::string mInitializerName;
+  std::string mCombinerName;
+  std::string mOutConverterName;
+
+  const RSExportType *mAccumulatorType;
+  const RSExportType *mResultType;
+
+  // The type and the name of each input of the accumulator
+  llvm::SmallVector<const RSExportType*, 4> mInTypes;
+  llvm::SmallVector<std::string, 4> mInNames;
+
+  RSExportReduce(RSContext *Context, const RSContext::ReduceSpec &Spec)
+    : RSExportable(Context, RSExportable::EX_REDUCE),
+      mName(Spec.Name), mAccumulatorName(Spec.Accumulator),
+      mInitializerName(Spec.Initializer), mCombinerName(Spec.Combiner),
+      mOutConverterName(Spec.OutConverter), mAccumulatorType(nullptr),
+      mResultType(nullptr) {
+  }
+
+  // Also returns the accumulator type T in @AccumType.
+  bool validateAndConstructAccumulator(RSContext *Context,
+                                       const clang::FunctionDecl *FD,
+                                       clang::QualType *AccumType);
+
+  bool validateInitializer(RSContext *Context, const clang::FunctionDecl *FD,
+                           clang::QualType AccumType);
+
+  bool validateCombiner(RSContext *Context, const clang::FunctionDecl *FD,
+                        clang::QualType AccumType);
+
+  bool validateAndConstructOutConverter(RSContext *Context,
+                                        const clang::FunctionDecl *FD,
+                                        clang::QualType AccumType);
+
+ public:
+  // The functions of @Spec that were not given are nullptr.
+  static RSExportReduce *Create(RSContext *Context,
+                                const RSContext::ReduceSpec &Spec,
+                                const clang::FunctionDecl *Accumulator,
+                                const clang::FunctionDecl *Initializer,
+                                const clang::FunctionDecl *Combiner,
+                                const clang::FunctionDecl *OutConverter);
+
+  inline const std::string &getName() const { return mName; }
+
+  inline const std::string &getAccumulatorName() const {
+    return mAccumulatorName;
+  }
+  inline const std::string &getInitializerName() const {
+    return mInitializerName;
+  }
+  inline const std::string &getCombinerName() const { return mCombinerName; }
+  inline const std::string &getOutConverterName() const {
+    return mOutConverterName;
+  }
+
+  // The type T of the per-thread accumulators
+  inline const RSExportType *getAccumulatorType() const {
+    return mAccumulatorType;
+  }
+
+  // The type R of the value returned by reduce_<name>()
+  inline const RSExportType *getResultType() const { return mResultType; }
+
+  inline const InTypeVec &getInTypes() const { return mInTypes; }
+  inline const InNameVec &getInNames() const { return mInNames; }
+};  // RSExportReduce
+
+}  // namespace slang
+
+#endif  // _FRAMEWORKS_COMPILE_SLANG_SLANG_RS_EXPORT_REDUCE_H_  NOLINT
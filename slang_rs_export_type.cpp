@@ -47,7 +47,9 @@ namespace {
  * as specified by the corresponding DataType enum.
  */
 static RSReflectionType gReflectionTypes[] = {
-    {PrimitiveDataType, "FLOAT_16", "F16", 16, "half", "half", "Half", "Half", false},
+    // Neither Java nor the C++ API has a half-precision type, so half values
+    // are reflected as their raw IEEE 754 binary16 bits.
+    {PrimitiveDataType, "FLOAT_16", "F16", 16, "uint16_t", "short", "UShort", "Short", false},
     {PrimitiveDataType, "FLOAT_32", "F32", 32, "float", "float", "Float", "Float", false},
     {PrimitiveDataType, "FLOAT_64", "F64", 64, "double", "double", "Double", "Double",false},
     {PrimitiveDataType, "SIGNED_8", "I8", 8, "int8_t", "byte", "Byte", "Byte", false},
@@ -130,6 +132,8 @@ BuiltinInfo BuiltinInfoTable[] = {
      {"long", "long2", "long3", "long4"}},
     {clang::BuiltinType::LongLong, DataTypeSigned64,
      {"long", "long2", "long3", "long4"}},
+    {clang::BuiltinType::Half, DataTypeFloat16,
+     {"half", "half2", "half3", "half4"}},
     {clang::BuiltinType::Float, DataTypeFloat32,
      {"float", "float2", "float3", "float4"}},
     {clang::BuiltinType::Double, DataTypeFloat64,
@@ -1111,6 +1115,10 @@ llvm::Type *RSExportPrimitiveType::convertToLLVMType() const {
   }
 
   switch (mType) {
+    case DataTypeFloat16: {
+      return llvm::Type::getHalfTy(C);
+      break;
+    }
     case DataTypeFloat32: {
       return llvm::Type::getFloatTy(C);
       break;
@@ -1424,7 +1432,8 @@ RSExportRecordType *RSExportRecordType::Create(RSContext *Context,
                              RD->hasAttr<clang::PackedAttr>(),
                              mIsArtificial,
                              RL->getDataSize().getQuantity(),
-                             RL->getSize().getQuantity());
+                             RL->getSize().getQuantity(),
+                             RL->getAlignment().getQuantity());
   unsigned int Index = 0;
 
   for (clang::RecordDecl::field_iterator FI = RD->field_begin(),
@@ -1446,7 +1455,9 @@ RSExportRecordType *RSExportRecordType::Create(RSContext *Context,
     if (ET != nullptr) {
       ERT->mFields.push_back(
           new Field(ET, FD->getName(), ERT,
-                    static_cast<size_t>(RL->getFieldOffset(Index) >> 3)));
+                    static_cast<size_t>(RL->getFieldOffset(Index) >> 3),
+                    Context->getASTContext().getDeclAlign(
+                        FD).getQuantity()));
     } else {
       Context->ReportError(RD->getLocation(),
                            "field type cannot be exported: '%0.%1'")
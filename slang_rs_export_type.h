@@ -512,22 +512,28 @@ class RSExportRecordType : public RSExportType {
     const RSExportRecordType *mParent;
     // Offset in the container
     size_t mOffset;
+    // Alignment of the field declaration, including aligned attributes (in
+    // bytes)
+    size_t mAlignment;
 
    public:
     Field(const RSExportType *T,
           const llvm::StringRef &Name,
           const RSExportRecordType *Parent,
-          size_t Offset)
+          size_t Offset,
+          size_t Alignment)
         : mType(T),
           mName(Name.data(), Name.size()),
           mParent(Parent),
-          mOffset(Offset) {
+          mOffset(Offset),
+          mAlignment(Alignment) {
     }
 
     inline const RSExportRecordType *getParent() const { return mParent; }
     inline const RSExportType *getType() const { return mType; }
     inline const std::string &getName() const { return mName; }
     inline size_t getOffsetInParent() const { return mOffset; }
+    inline size_t getAlignment() const { return mAlignment; }
   };
 
   typedef std::list<const Field*>::const_iterator const_field_iterator;
@@ -547,18 +553,21 @@ class RSExportRecordType : public RSExportType {
   bool mIsArtificial;
   size_t mStoreSize;
   size_t mAllocSize;
+  size_t mAlignment;
 
   RSExportRecordType(RSContext *Context,
                      const llvm::StringRef &Name,
                      bool IsPacked,
                      bool IsArtificial,
                      size_t StoreSize,
-                     size_t AllocSize)
+                     size_t AllocSize,
+                     size_t Alignment)
       : RSExportType(Context, ExportClassRecord, Name),
         mIsPacked(IsPacked),
         mIsArtificial(IsArtificial),
         mStoreSize(StoreSize),
-        mAllocSize(AllocSize) {
+        mAllocSize(AllocSize),
+        mAlignment(Alignment) {
   }
 
   // @RT was normalized by calling RSExportType::NormalizeType() before calling
@@ -578,6 +587,7 @@ class RSExportRecordType : public RSExportType {
   inline bool isArtificial() const { return mIsArtificial; }
   virtual size_t getStoreSize() const { return mStoreSize; }
   virtual size_t getAllocSize() const { return mAllocSize; }
+  inline size_t getAlignment() const { return mAlignment; }
 
   virtual std::string getElementName() const {
     return "ScriptField_" + getName();
@@ -34,6 +34,7 @@ RSExportVar::RSExportVar(RSContext *Context,
       mET(ET),
       mIsConst(false),
       mIsUnsigned(false),
+      mSpecialized(false),
       mArraySize(0),
       mNumInits(0) {
   // mInit - Evaluate initializer expression
@@ -38,6 +38,8 @@ class RSExportVar : public RSExportable {
   const RSExportType *mET;
   bool mIsConst;
   bool mIsUnsigned;
+  // Whether the variable is listed in "#pragma rs specialize"
+  bool mSpecialized;
 
   clang::Expr::EvalResult mInit;
 
@@ -54,6 +56,10 @@ class RSExportVar : public RSExportable {
   inline const RSExportType *getType() const { return mET; }
   inline bool isConst() const { return mIsConst; }
   inline bool isUnsigned() const { return mIsUnsigned; }
+  // The value of a specialized variable is set before the first launch and
+  // never changes afterwards, so the device compiler may fold it into the
+  // code of the script.
+  inline bool isSpecialized() const { return mSpecialized; }
 
   inline const clang::APValue &getInit() const { return mInit.Val; }
 
@@ -29,8 +29,50 @@
 
 #define RS_OBJECT_SLOTS_MN "#rs_object_slots"
 
+#define RS_SPECIALIZED_VARS_MN "#rs_specialized_vars"
+
+// How the script code may modify each exported variable (one entry per
+// variable, in #rs_export_var order)
+#define RS_EXPORT_VAR_ACCESS_MN "#rs_export_var_access"
+#define RS_EXPORT_VAR_ACCESS_READ_ONLY 0
+#define RS_EXPORT_VAR_ACCESS_WRITTEN_BY_INVOKABLES 1
+#define RS_EXPORT_VAR_ACCESS_WRITTEN_BY_KERNELS 2
+
+// Static cost estimates of the kernels (one entry per kernel, in
+// #rs_export_foreach_name order), each made of
+// <instructions, loads, stores, transcendental calls, has loops (0/1),
+//  has unknown callees (0/1)>
+#define RS_EXPORT_FOREACH_COST_MN "#rs_export_foreach_cost"
+
+// Variants of the multiversioned kernels processing several cells at once (one
+// entry per kernel, in #rs_export_foreach_name order), each made of
+// <width, variant function name> pairs
+#define RS_EXPORT_FOREACH_VARIANTS_MN "#rs_export_foreach_variants"
+
 #define RS_EXPORT_FOREACH_NAME_MN "#rs_export_foreach_name"
 
 #define RS_EXPORT_FOREACH_MN "#rs_export_foreach"
 
+#define RS_EXPORT_FOREACH_PRECISION_MN "#rs_export_foreach_precision"
+
+// Stencil footprints of the kernels (one entry per kernel, in
+// #rs_export_foreach_name order), each made of
+// <allocation, min dx, max dx, min dy, max dy> tuples
+#define RS_EXPORT_FOREACH_FOOTPRINT_MN "#rs_export_foreach_footprint"
+
+#define RS_EXPORT_REDUCE_MN "#rs_export_reduce"
+#define RS_EXPORT_REDUCE_NAME 0
+#define RS_EXPORT_REDUCE_ACCUMULATOR 1
+#define RS_EXPORT_REDUCE_INITIALIZER 2
+#define RS_EXPORT_REDUCE_COMBINER 3
+#define RS_EXPORT_REDUCE_OUTCONVERTER 4
+#define RS_EXPORT_REDUCE_ACCUMULATOR_SIZE 5
+#define RS_EXPORT_REDUCE_ACCUMULATOR_ALIGN 6
+#define RS_EXPORT_REDUCE_NUM_INPUTS 7
+
+// Parameter attributes that the older readers do not support, stripped from
+// the functions (one entry per function, made of its name followed by
+// <argument number, "readnone" or "readonly"> pairs)
+#define RS_PARAM_ATTRS_MN "#rs_param_attrs"
+
 #endif  // _FRAMEWORKS_COMPILE_SLANG_SLANG_RS_METADATA_H_  NOLINT
@@ -0,0 +1,331 @@
+/*
+ * Copyright 2014, The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "slang_rs_odr_database.h"
+
+#include <list>
+#include <sstream>
+#include <string>
+#include <system_error>
+
+#include "llvm/ADT/SmallString.h"
+#include "llvm/ADT/StringExtras.h"
+#include "llvm/ADT/StringRef.h"
+
+#include "llvm/Support/ErrorOr.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/LockFileManager.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/Path.h"
+#include "llvm/Support/raw_ostream.h"
+
+#include "slang_assert.h"
+#include "slang_rs_export_type.h"
+#include "slang_utils.h"
+
+namespace slang {
+
+namespace {
+
+void AppendTypeSignature(std::ostream &OS, const RSExportType *ET) {
+  switch (ET->getClass()) {
+    case RSExportType::ExportClassPointer: {
+      AppendTypeSignature(
+          OS, static_cast<const RSExportPointerType*>(ET)->getPointeeType());
+      OS << "*";
+      break;
+    }
+    case RSExportType::ExportClassConstantArray: {
+      const RSExportConstantArrayType *ECAT =
+          static_cast<const RSExportConstantArrayType*>(ET);
+      AppendTypeSignature(OS, ECAT->getElementType());
+      OS << "[" << ECAT->getSize() << "]";
+      break;
+    }
+    default: {
+      // Nested records are referred to by name; their own definition is
+      // recorded (and checked) separately.
+      OS << ET->getName();
+      break;
+    }
+  }
+}
+
+// Returns the modification time of @File, or 0 if it cannot be determined.
+uint64_t GetFileTimestamp(const std::string &File) {
+  llvm::sys::fs::file_status Status;
+  if (llvm::sys::fs::status(File, Status) || !llvm::sys::fs::exists(Status))
+    return 0;
+  return Status.getLastModificationTime().toEpochTime();
+}
+
+}  // namespace
+
+std::string RSODRDatabase::GetSignature(const RSExportRecordType *ERT) {
+  std::stringstream Sig;
+  Sig << ERT->getAllocSize() << "{";
+  for (RSExportRecordType::const_field_iterator I = ERT->fields_begin(),
+           E = ERT->fields_end();
+       I != E;
+       I++) {
+    const RSExportRecordType::Field *F = *I;
+    Sig << F->getName() << ":";
+    AppendTypeSignature(Sig, F->getType());
+    Sig << "@" << F->getOffsetInParent() << ";";
+  }
+  Sig << "}";
+  return Sig.str();
+}
+
+bool RSODRDatabase::load(std::string *Error) {
+  mEntries.clear();
+  mDependencies.clear();
+
+  llvm::ErrorOr<std::unique_ptr<llvm::MemoryBuffer>> MBOrErr =
+      llvm::MemoryBuffer::getFile(mPath);
+  if (std::error_code EC = MBOrErr.getError()) {
+    // A missing database is simply an empty one.
+    if (EC == std::errc::no_such_file_or_directory)
+      return true;
+    Error->assign(EC.message());
+    return false;
+  }
+
+  llvm::StringRef Buffer = MBOrErr.get()->getBuffer();
+  while (!Buffer.empty()) {
+    std::pair<llvm::StringRef, llvm::StringRef> Line = Buffer.split('\n');
+    Buffer = Line.second;
+    if (Line.first.empty())
+      continue;
+
+    // Malformed lines (e.g., in the format of an older llvm-rs-cc) are
+    // ignored, and dropped on the next save().
+    llvm::SmallVector<llvm::StringRef, 4> Columns;
+    Line.first.split(Columns, "\t", /* MaxSplit = */3);
+    if (Columns.size() != 4)
+      continue;
+
+    if (Columns[0] == "type") {
+      Entry E;
+      E.TypeName = Columns[1];
+      E.Signature = Columns[2];
+      E.File = Columns[3];
+      mEntries.push_back(E);
+    } else if (Columns[0] == "file") {
+      Dependency D;
+      if (Columns[1].getAsInteger(10, D.Timestamp))
+        continue;
+      D.Path = Columns[2];
+      D.File = Columns[3];
+      mDependencies.push_back(D);
+    }
+  }
+
+  return true;
+}
+
+bool RSODRDatabase::save(std::string *Error) {
+  llvm::SmallString<256> TmpPath;
+  int FD;
+  std::error_code EC =
+      llvm::sys::fs::createUniqueFile(mPath + "-%%%%%%%%", FD, TmpPath);
+  if (EC) {
+    Error->assign(EC.message());
+    return false;
+  }
+
+  {
+    llvm::raw_fd_ostream OS(FD, /* shouldClose = */true);
+    for (std::list<Entry>::const_iterator I = mEntries.begin(),
+             E = mEntries.end();
+         I != E;
+         I++) {
+      OS << "type\t" << I->TypeName << "\t" << I->Signature << "\t"
+         << I->File << "\n";
+    }
+    for (std::list<Dependency>::const_iterator I = mDependencies.begin(),
+             E = mDependencies.end();
+         I != E;
+         I++) {
+      OS << "file\t" << I->Timestamp << "\t" << I->Path << "\t" << I->File
+         << "\n";
+    }
+    OS.close();
+    if (OS.has_error()) {
+      OS.clear_error();
+      llvm::sys::fs::remove(TmpPath.str());
+      Error->assign("failed to write " + TmpPath.str().str());
+      return false;
+    }
+  }
+
+  EC = llvm::sys::fs::rename(TmpPath.str(), mPath);
+  if (EC) {
+    llvm::sys::fs::remove(TmpPath.str());
+    Error->assign(EC.message());
+    return false;
+  }
+
+  return true;
+}
+
+bool RSODRDatabase::isStale(const std::string &File) const {
+  bool HasDependencies = false;
+  for (std::list<Dependency>::const_iterator I = mDependencies.begin(),
+           E = mDependencies.end();
+       I != E;
+       I++) {
+    if (I->File != File)
+      continue;
+    if (GetFileTimestamp(I->Path) != I->Timestamp)
+      return true;
+    HasDependencies = true;
+  }
+  // Without the files it read, the entries of File cannot be trusted.
+  return !HasDependencies;
+}
+
+bool RSODRDatabase::checkAndUpdateLocked(const std::string &File,
+                                         const SignatureList &Types,
+                                         const FileList &Dependencies,
+                                         ConflictList *Conflicts,
+                                         std::string *Error) {
+  if (!load(Error))
+    return false;
+
+  std::list<Entry> NewEntries;
+
+  for (SignatureList::const_iterator TI = Types.begin(), TE = Types.end();
+       TI != TE;
+       TI++) {
+    Entry New;
+    New.TypeName = TI->TypeName;
+    New.Signature = TI->Signature;
+    New.File = File;
+
+    for (std::list<Entry>::const_iterator I = mEntries.begin(),
+             E = mEntries.end();
+         I != E;
+         I++) {
+      if ((I->TypeName == New.TypeName) &&
+          (I->Signature != New.Signature) &&
+          (I->File != File) &&
+          !isStale(I->File)) {
+        Conflict C;
+        C.TypeName = New.TypeName;
+        C.File = I->File;
+        Conflicts->push_back(C);
+        break;
+      }
+    }
+
+    NewEntries.push_back(New);
+  }
+
+  // Leave the database untouched so that the other definition stays the
+  // reference one until this file is fixed.
+  if (!Conflicts->empty())
+    return true;
+
+  // Replace the entries of @File and drop those of deleted files.
+  for (std::list<Entry>::iterator I = mEntries.begin(), E = mEntries.end();
+       I != E;) {
+    if ((I->File == File) || !llvm::sys::fs::exists(I->File)) {
+      I = mEntries.erase(I);
+    } else {
+      I++;
+    }
+  }
+  mEntries.splice(mEntries.end(), NewEntries);
+
+  for (std::list<Dependency>::iterator I = mDependencies.begin(),
+           E = mDependencies.end();
+       I != E;) {
+    if ((I->File == File) || !llvm::sys::fs::exists(I->File)) {
+      I = mDependencies.erase(I);
+    } else {
+      I++;
+    }
+  }
+  for (FileList::const_iterator I = Dependencies.begin(),
+           E = Dependencies.end();
+       I != E;
+       I++) {
+    Dependency D;
+    D.Path = *I;
+    D.Timestamp = GetFileTimestamp(D.Path);
+    D.File = File;
+    mDependencies.push_back(D);
+  }
+
+  return save(Error);
+}
+
+bool RSODRDatabase::checkAndUpdate(const std::string &File,
+                                   const SignatureList &Types,
+                                   const FileList &Dependencies,
+                                   ConflictList *Conflicts,
+                                   std::string *Error) {
+  slangAssert((Conflicts != nullptr) && (Error != nullptr) &&
+              "Invalid parameter!");
+
+  if (!SlangUtils::CreateDirectoryWithParents(
+          llvm::sys::path::parent_path(mPath), Error))
+    return false;
+
+  // Entries are keyed by absolute path so that invocations from different
+  // working directories agree on the identity of a source file.
+  llvm::SmallString<256> AbsFile(File);
+  if (std::error_code EC = llvm::sys::fs::make_absolute(AbsFile)) {
+    Error->assign(EC.message());
+    return false;
+  }
+  FileList AbsDependencies;
+  for (FileList::const_iterator I = Dependencies.begin(),
+           E = Dependencies.end();
+       I != E;
+       I++) {
+    llvm::SmallString<256> AbsDependency(*I);
+    if (std::error_code EC = llvm::sys::fs::make_absolute(AbsDependency)) {
+      Error->assign(EC.message());
+      return false;
+    }
+    AbsDependencies.push_back(AbsDependency.str());
+  }
+
+  while (true) {
+    llvm::LockFileManager Lock(mPath);
+    switch (Lock) {
+      case llvm::LockFileManager::LFS_Error: {
+        Error->assign("unable to lock " + mPath);
+        return false;
+      }
+      case llvm::LockFileManager::LFS_Owned: {
+        // The lock is released when Lock goes out of scope.
+        return checkAndUpdateLocked(AbsFile.str(), Types, AbsDependencies,
+                                    Conflicts, Error);
+      }
+      case llvm::LockFileManager::LFS_Shared: {
+        // Another llvm-rs-cc is updating the database. Wait for it and then
+        // try to acquire the lock again.
+        Lock.waitForUnlock();
+        break;
+      }
+    }
+  }
+}
+
+}  // namespace slang
@@ -0,0 +1,124 @@
+/*
+ * Copyright 2014, The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef _FRAMEWORKS_COMPILE_SLANG_SLANG_RS_ODR_DATABASE_H_  // NOLINT
+#define _FRAMEWORKS_COMPILE_SLANG_SLANG_RS_ODR_DATABASE_H_
+
+#include <list>
+#include <string>
+
+#include "llvm/Support/DataTypes.h"
+
+namespace slang {
+
+class RSExportRecordType;
+
+// RSODRDatabase is an on-disk store of the exported record type signatures of
+// one reflection package. It lets the ODR check of SlangRS::checkODR() span
+// multiple llvm-rs-cc invocations (e.g. parallel or incremental builds).
+//
+// The store is a text file with one line per (type, defining file) pair and
+// one line per file read by each source file (the source file itself and the
+// headers it includes):
+//
+//   type \t <type name> \t <signature> \t <source path>
+//   file \t <mtime> \t <path of the file read> \t <source path>
+//
+// where the paths are absolute.
+//
+// Every access is a read-modify-write performed while holding a lock file
+// (<database>.lock), and the new contents are written to a temporary file that
+// is then renamed over the old one, so concurrent writers never observe a
+// partially written store.
+class RSODRDatabase {
+ public:
+  struct Entry {
+    std::string TypeName;
+    std::string Signature;
+    std::string File;
+  };
+
+  struct Dependency {
+    uint64_t Timestamp;
+    std::string Path;
+    // The source file reading Path
+    std::string File;
+  };
+
+  struct Conflict {
+    std::string TypeName;
+    // The other source file holding an incompatible definition
+    std::string File;
+  };
+
+  // The name and the signature (see GetSignature()) of a record type. They are
+  // computed up front since the RSContext of the record type may be gone by
+  // the time the database is accessed.
+  struct TypeSignature {
+    std::string TypeName;
+    std::string Signature;
+  };
+
+  typedef std::list<TypeSignature> SignatureList;
+  typedef std::list<std::string> FileList;
+  typedef std::list<Conflict> ConflictList;
+
+ private:
+  std::string mPath;
+  std::list<Entry> mEntries;
+  std::list<Dependency> mDependencies;
+
+  bool load(std::string *Error);
+  bool save(std::string *Error);
+
+  // The entries of @File are stale if @File or any of the headers it includes
+  // was removed or modified since they were recorded. Stale entries never
+  // cause an ODR violation since the file is going to be recompiled (or is
+  // gone). This matters for the types defined in a header shared by several
+  // source files: the first one recompiled must not conflict with the others.
+  bool isStale(const std::string &File) const;
+
+  bool checkAndUpdateLocked(const std::string &File,
+                            const SignatureList &Types,
+                            const FileList &Dependencies,
+                            ConflictList *Conflicts,
+                            std::string *Error);
+
+ public:
+  // @Path - the database file, usually <dir>/<package>.<32|64>.rsodr.
+  explicit RSODRDatabase(const std::string &Path) : mPath(Path) { }
+
+  // Compute the layout signature (field names, field types and offsets, and
+  // the allocation size) of @ERT.
+  static std::string GetSignature(const RSExportRecordType *ERT);
+
+  // Check the record types defined by the input @File against the definitions
+  // recorded by the other (up-to-date) source files of the package. The
+  // conflicting definitions are appended to @Conflicts. If there is no
+  // conflict, the entries of @File are replaced by @Types, and the files it
+  // read by @Dependencies (which includes @File).
+  //
+  // Returns false (and sets @Error) only if the database cannot be accessed.
+  bool checkAndUpdate(const std::string &File,
+                      const SignatureList &Types,
+                      const FileList &Dependencies,
+                      ConflictList *Conflicts,
+                      std::string *Error);
+};
+
+}  // namespace slang
+
+#endif  // _FRAMEWORKS_COMPILE_SLANG_SLANG_RS_ODR_DATABASE_H_  NOLINT
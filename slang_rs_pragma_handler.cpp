@@ -50,6 +50,185 @@ class RSExportTypePragmaHandler : public RSPragmaHandler {
   }
 };
 
+class RSExportTypeSoAPragmaHandler : public RSPragmaHandler {
+ private:
+  void handleItem(const std::string &Item) {
+    mContext->addPragma(this->getName(), Item);
+    mContext->addExportSoAType(Item);
+  }
+
+ public:
+  RSExportTypeSoAPragmaHandler(llvm::StringRef Name, RSContext *Context)
+      : RSPragmaHandler(Name, Context) { }
+
+  void HandlePragma(clang::Preprocessor &PP,
+                    clang::PragmaIntroducerKind Introducer,
+                    clang::Token &FirstToken) {
+    this->handleItemListPragma(PP, FirstToken);
+  }
+};
+
+class RSBatchInvokePragmaHandler : public RSPragmaHandler {
+ private:
+  void handleItem(const std::string &Item) {
+    mContext->addPragma(this->getName(), Item);
+    mContext->addBatchInvokeFunc(Item);
+  }
+
+ public:
+  RSBatchInvokePragmaHandler(llvm::StringRef Name, RSContext *Context)
+      : RSPragmaHandler(Name, Context) { }
+
+  void HandlePragma(clang::Preprocessor &PP,
+                    clang::PragmaIntroducerKind Introducer,
+                    clang::Token &FirstToken) {
+    this->handleItemListPragma(PP, FirstToken);
+  }
+};
+
+class RSMultiversionPragmaHandler : public RSPragmaHandler {
+ private:
+  void handleItem(const std::string &Item) {
+    mContext->addPragma(this->getName(), Item);
+    mContext->addMultiversionKernel(Item);
+  }
+
+ public:
+  RSMultiversionPragmaHandler(llvm::StringRef Name, RSContext *Context)
+      : RSPragmaHandler(Name, Context) { }
+
+  void HandlePragma(clang::Preprocessor &PP,
+                    clang::PragmaIntroducerKind Introducer,
+                    clang::Token &FirstToken) {
+    this->handleItemListPragma(PP, FirstToken);
+  }
+};
+
+class RSSpecializePragmaHandler : public RSPragmaHandler {
+ private:
+  void handleItem(const std::string &Item) {
+    mContext->addPragma(this->getName(), Item);
+    mContext->addSpecializeVar(Item);
+  }
+
+ public:
+  RSSpecializePragmaHandler(llvm::StringRef Name, RSContext *Context)
+      : RSPragmaHandler(Name, Context) { }
+
+  void HandlePragma(clang::Preprocessor &PP,
+                    clang::PragmaIntroducerKind Introducer,
+                    clang::Token &FirstToken) {
+    this->handleItemListPragma(PP, FirstToken);
+  }
+};
+
+// Handles
+//
+//   #pragma rs reduce(<name>) accumulator(<fn>) [initializer(<fn>)]
+//                             [combiner(<fn>)] [outconverter(<fn>)]
+//
+// The clauses naming the functions may appear in any order.
+class RSReducePragmaHandler : public RSPragmaHandler {
+ private:
+  void reportError(clang::Preprocessor &PP, clang::SourceLocation Loc,
+                   const char *Message) {
+    PP.Diag(Loc, PP.getDiagnostics().getCustomDiagID(
+                     clang::DiagnosticsEngine::Error, Message));
+  }
+
+  // Lexes "(<identifier>)" into @Identifier. Returns false, after reporting an
+  // error, if the tokens do not match.
+  bool lexParenthesizedIdentifier(clang::Preprocessor &PP, clang::Token &Tok,
+                                  std::string *Identifier) {
+    PP.LexUnexpandedToken(Tok);
+    if (Tok.isNot(clang::tok::l_paren)) {
+      reportError(PP, Tok.getLocation(), "expected a '('");
+      return false;
+    }
+    PP.LexUnexpandedToken(Tok);
+    if (Tok.isNot(clang::tok::identifier)) {
+      reportError(PP, Tok.getLocation(), "expected a function name");
+      return false;
+    }
+    *Identifier = PP.getSpelling(Tok);
+    PP.LexUnexpandedToken(Tok);
+    if (Tok.isNot(clang::tok::r_paren)) {
+      reportError(PP, Tok.getLocation(), "expected a ')'");
+      return false;
+    }
+    return true;
+  }
+
+  void skipToEnd(clang::Preprocessor &PP, clang::Token &Tok) {
+    while (Tok.isNot(clang::tok::eod)) {
+      PP.LexUnexpandedToken(Tok);
+    }
+  }
+
+ public:
+  RSReducePragmaHandler(llvm::StringRef Name, RSContext *Context)
+      : RSPragmaHandler(Name, Context) { }
+
+  void HandlePragma(clang::Preprocessor &PP,
+                    clang::PragmaIntroducerKind Introducer,
+                    clang::Token &FirstToken) {
+    clang::Token &PragmaToken = FirstToken;
+    RSContext::ReduceSpec Spec;
+    Spec.Loc = PragmaToken.getLocation();
+
+    // Lex the name of the reduction kernel
+    if (!lexParenthesizedIdentifier(PP, PragmaToken, &Spec.Name)) {
+      skipToEnd(PP, PragmaToken);
+      return;
+    }
+
+    while (true) {
+      PP.LexUnexpandedToken(PragmaToken);
+      if (PragmaToken.is(clang::tok::eod))
+        break;
+
+      std::string *Function = nullptr;
+      if (PragmaToken.is(clang::tok::identifier)) {
+        std::string Clause = PP.getSpelling(PragmaToken);
+        if (Clause == "accumulator") {
+          Function = &Spec.Accumulator;
+        } else if (Clause == "initializer") {
+          Function = &Spec.Initializer;
+        } else if (Clause == "combiner") {
+          Function = &Spec.Combiner;
+        } else if (Clause == "outconverter") {
+          Function = &Spec.OutConverter;
+        }
+      }
+
+      if (Function == nullptr) {
+        reportError(PP, PragmaToken.getLocation(),
+                    "expected one of accumulator, initializer, combiner or "
+                    "outconverter");
+        skipToEnd(PP, PragmaToken);
+        return;
+      }
+      if (!Function->empty()) {
+        reportError(PP, PragmaToken.getLocation(),
+                    "function of reduction kernel specified more than once");
+        skipToEnd(PP, PragmaToken);
+        return;
+      }
+      if (!lexParenthesizedIdentifier(PP, PragmaToken, Function)) {
+        skipToEnd(PP, PragmaToken);
+        return;
+      }
+    }
+
+    if (Spec.Accumulator.empty()) {
+      reportError(PP, Spec.Loc, "reduction kernel requires an accumulator");
+      return;
+    }
+
+    mContext->addReduce(Spec);
+  }
+};
+
 class RSJavaPackageNamePragmaHandler : public RSPragmaHandler {
  public:
   RSJavaPackageNamePragmaHandler(llvm::StringRef Name, RSContext *Context)
@@ -207,6 +386,58 @@ public:
   }
 };
 
+// Handles "#pragma rs fp_precision(<precision>)", where <precision> is one of
+// rs_fp_full, rs_fp_relaxed or rs_fp_imprecise. Unlike the pragmas above, it
+// only applies to the function defined next.
+class RSFunctionPrecisionPragmaHandler : public RSPragmaHandler {
+ public:
+  RSFunctionPrecisionPragmaHandler(llvm::StringRef Name, RSContext *Context)
+      : RSPragmaHandler(Name, Context) {}
+
+  void HandlePragma(clang::Preprocessor &PP,
+                    clang::PragmaIntroducerKind Introducer,
+                    clang::Token &FirstToken) {
+    clang::Token &PragmaToken = FirstToken;
+    clang::SourceLocation Loc = PragmaToken.getLocation();
+    std::string Precision;
+
+    // Lex "(<precision>)"
+    PP.LexUnexpandedToken(PragmaToken);
+    if (PragmaToken.is(clang::tok::l_paren)) {
+      PP.LexUnexpandedToken(PragmaToken);
+      if (PragmaToken.is(clang::tok::identifier)) {
+        Precision = PP.getSpelling(PragmaToken);
+        PP.LexUnexpandedToken(PragmaToken);
+        if (PragmaToken.isNot(clang::tok::r_paren)) {
+          Precision.clear();
+        }
+      }
+    }
+
+    while (PragmaToken.isNot(clang::tok::eod)) {
+      PP.LexUnexpandedToken(PragmaToken);
+    }
+
+    if (Precision == "rs_fp_imprecise") {
+      PP.Diag(Loc, PP.getDiagnostics().getCustomDiagID(
+                       clang::DiagnosticsEngine::Warning,
+                       "rs_fp_imprecise is deprecated.  Assuming "
+                       "rs_fp_relaxed instead."));
+      Precision = "rs_fp_relaxed";
+    }
+
+    if ((Precision != "rs_fp_full") && (Precision != "rs_fp_relaxed")) {
+      PP.Diag(Loc, PP.getDiagnostics().getCustomDiagID(
+                       clang::DiagnosticsEngine::Error,
+                       "expected fp_precision(rs_fp_full) or "
+                       "fp_precision(rs_fp_relaxed)"));
+      return;
+    }
+
+    mContext->addFunctionPrecision(Precision, Loc);
+  }
+};
+
 }  // namespace
 
 void RSPragmaHandler::handleItemListPragma(clang::Preprocessor &PP,
@@ -346,6 +577,29 @@ void AddPragmaHandlers(clang::Preprocessor &PP, RSContext *RsContext) {
   PP.AddPragmaHandler("rs",
                       new RSExportTypePragmaHandler("export_type", RsContext));
 
+  // For #pragma rs export_type_soa
+  PP.AddPragmaHandler(
+      "rs", new RSExportTypeSoAPragmaHandler("export_type_soa", RsContext));
+
+  // For #pragma rs batch_invoke
+  PP.AddPragmaHandler(
+      "rs", new RSBatchInvokePragmaHandler("batch_invoke", RsContext));
+
+  // For #pragma rs specialize
+  PP.AddPragmaHandler(
+      "rs", new RSSpecializePragmaHandler("specialize", RsContext));
+
+  // For #pragma rs multiversion
+  PP.AddPragmaHandler(
+      "rs", new RSMultiversionPragmaHandler("multiversion", RsContext));
+
+  // For #pragma rs reduce
+  PP.AddPragmaHandler("rs", new RSReducePragmaHandler("reduce", RsContext));
+
+  // For #pragma rs fp_precision
+  PP.AddPragmaHandler(
+      "rs", new RSFunctionPrecisionPragmaHandler("fp_precision", RsContext));
+
   // For #pragma rs java_package_name
   PP.AddPragmaHandler(
       "rs", new RSJavaPackageNamePragmaHandler("java_package_name", RsContext));
@@ -16,12 +16,18 @@
 
 #include "slang_rs_reflect_utils.h"
 
+#include <algorithm>
 #include <cstdio>
 #include <cstring>
 #include <string>
-#include <iomanip>
+#include <system_error>
 
+#include "llvm/ADT/SmallVector.h"
 #include "llvm/ADT/StringRef.h"
+#include "llvm/Support/Compression.h"
+#include "llvm/Support/ErrorOr.h"
+#include "llvm/Support/Format.h"
+#include "llvm/Support/MemoryBuffer.h"
 
 #include "os_sep.h"
 #include "slang_assert.h"
@@ -127,36 +133,43 @@ static bool GenerateAccessorMethod(
   return true;
 }
 
-// Java method size must not exceed 64k,
-// so we have to split the bitcode into multiple segments.
-static bool GenerateSegmentMethod(const char *buff, int blen, int bitwidth,
-                                  int seg_num, GeneratedFile &out) {
-  out.indent() << "private static byte[] getSegment" << bitwidth << "_"
-               << seg_num << "()";
-  out.startBlock();
-  out.indent() << "byte[] data = {";
+// Each segment is a Java string constant holding one char per bitcode byte
+// (i.e. its Latin-1 decoding), which javac and dx store verbatim in the
+// constant pool instead of compiling one array store per byte. The class file
+// stores a constant as modified UTF-8 where a char takes at most 2 bytes, and
+// a constant must not exceed 64k, so each segment holds less than 32k bytes.
+static const int SEG_SIZE = 0x4000;
+
+static void GenerateSegmentConstant(const char *buff, int blen, int bitwidth,
+                                    int seg_num, GeneratedFile &out) {
+  out.indent() << "private static final String segment" << bitwidth << "_"
+               << seg_num << " =";
   out.increaseIndent();
 
-  const int kEntriesPerLine = 16;
-  int position = kEntriesPerLine;  // We start with a new line and indent.
-  for (int written = 0; written < blen; written++) {
-    if (++position >= kEntriesPerLine) {
-      out << "\n";
-      out.indent();
-      position = 0;
-    } else {
-      out << " ";
+  // Split the literal into constant concatenations to keep the lines short.
+  const int kBytesPerLine = 64;
+  for (int written = 0; written < blen; written += kBytesPerLine) {
+    out << ((written == 0) ? "\n" : " +\n");
+    out.indent() << "\"";
+    int line_end = std::min(written + kBytesPerLine, blen);
+    for (int i = written; i < line_end; i++) {
+      unsigned char c = static_cast<unsigned char>(buff[i]);
+      if ((c >= 0x20) && (c < 0x7f) && (c != '"') && (c != '\\')) {
+        out << c;
+      } else {
+        // Always use 3 digits so that the escape never swallows the next
+        // char, e.g. "\0001" rather than "\01".
+        char escape[5];
+        snprintf(escape, sizeof(escape), "\\%03o", c);
+        out << escape;
+      }
     }
-    out << std::setw(4) << static_cast<int>(buff[written]) << ",";
+    out << "\"";
   }
-  out << "\n";
+  out << ";\n";
 
   out.decreaseIndent();
-  out.indent() << "};\n";
-  out.indent() << "return data;\n";
-  out.endBlock();
-
-  return true;
+  out << "\n";
 }
 
 static bool GenerateJavaCodeAccessorMethodForBitwidth(
@@ -168,9 +181,10 @@ static bool GenerateJavaCodeAccessorMethodForBitwidth(
     filename = context.bc64FileName;
   }
 
-  FILE *pfin = fopen(filename.c_str(), "rb");
-  if (pfin == nullptr) {
-    fprintf(stderr, "Error: could not read file %s\n", filename.c_str());
+  RSSlangReflectUtils::BitCodePayload payload;
+  if (!RSSlangReflectUtils::ReadBitCodePayload(filename, context.compress,
+                                               context.verbose, &payload,
+                                               context.messages)) {
     return false;
   }
 
@@ -178,34 +192,71 @@ static bool GenerateJavaCodeAccessorMethodForBitwidth(
   GenerateAccessorMethod(context, bitwidth, out);
 
   // output the data
-  // make sure the generated function for a segment won't break the Javac
-  // size limitation (64K).
-  static const int SEG_SIZE = 0x2000;
-  char *buff = new char[SEG_SIZE];
-  int read_length;
+  const char *buff = payload.data.data();
+  int total_length = payload.data.size();
   int seg_num = 0;
-  int total_length = 0;
-  while ((read_length = fread(buff, 1, SEG_SIZE, pfin)) > 0) {
-    GenerateSegmentMethod(buff, read_length, bitwidth, seg_num, out);
+  for (int offset = 0; offset < total_length; offset += SEG_SIZE) {
+    GenerateSegmentConstant(buff + offset,
+                            std::min(SEG_SIZE, total_length - offset),
+                            bitwidth, seg_num, out);
     ++seg_num;
-    total_length += read_length;
   }
-  delete[] buff;
-  fclose(pfin);
 
   // output the internal accessor method
   out.indent() << "private static int bitCode" << bitwidth << "Length = "
-               << total_length << ";\n\n";
+               << payload.uncompressedSize << ";\n";
+  if (payload.compressed) {
+    out.indent() << "private static int bitCode" << bitwidth
+                 << "CompressedLength = " << total_length << ";\n";
+  }
+  out << "\n";
+  // String.getBytes(int, int, byte[], int) keeps the low 8 bits of each char,
+  // which is exactly the Latin-1 encoding, and writes straight into the
+  // destination without any charset lookup or intermediate array.
+  out.indent() << "@SuppressWarnings(\"deprecation\")\n";
   out.indent() << "private static byte[] getBitCode" << bitwidth
                << "Internal()";
   out.startBlock();
-  out.indent() << "byte[] bc = new byte[bitCode" << bitwidth << "Length];\n";
+  const char *data = "bc";
+  if (payload.compressed) {
+    data = "z";
+    out.indent() << "byte[] z = new byte[bitCode" << bitwidth
+                 << "CompressedLength];\n";
+  } else {
+    out.indent() << "byte[] bc = new byte[bitCode" << bitwidth
+                 << "Length];\n";
+  }
   out.indent() << "int offset = 0;\n";
-  out.indent() << "byte[] seg;\n";
   for (int i = 0; i < seg_num; ++i) {
-    out.indent() << "seg = getSegment" << bitwidth << "_" << i << "();\n";
-    out.indent() << "System.arraycopy(seg, 0, bc, offset, seg.length);\n";
-    out.indent() << "offset += seg.length;\n";
+    out.indent() << "segment" << bitwidth << "_" << i
+                 << ".getBytes(0, segment" << bitwidth << "_" << i
+                 << ".length(), " << data << ", offset);\n";
+    out.indent() << "offset += segment" << bitwidth << "_" << i
+                 << ".length();\n";
+  }
+  if (payload.compressed) {
+    out.indent() << "byte[] bc = new byte[bitCode" << bitwidth
+                 << "Length];\n";
+    out.indent() << "java.util.zip.Inflater inflater = "
+                    "new java.util.zip.Inflater();\n";
+    out.indent() << "try {\n";
+    out.indent() << "    inflater.setInput(z);\n";
+    out.indent() << "    int length = inflater.inflate(bc);\n";
+    // The end of the stream may only be seen by a further inflate().
+    out.indent() << "    if (!inflater.finished()) {\n";
+    out.indent() << "        length += inflater.inflate(new byte[1]);\n";
+    out.indent() << "    }\n";
+    out.indent() << "    if ((length != bc.length) || !inflater.finished()) "
+                    "{\n";
+    out.indent() << "        throw new RuntimeException(\"Corrupted bitcode\");"
+                    "\n";
+    out.indent() << "    }\n";
+    out.indent() << "} catch (java.util.zip.DataFormatException e) {\n";
+    out.indent() << "    throw new RuntimeException(\"Corrupted bitcode\", "
+                    "e);\n";
+    out.indent() << "} finally {\n";
+    out.indent() << "    inflater.end();\n";
+    out.indent() << "}\n";
   }
   out.indent() << "return bc;\n";
   out.endBlock();
@@ -263,7 +314,8 @@ bool RSSlangReflectUtils::GenerateJavaBitCodeAccessor(
       ComputePackagedPath(context.reflectPath, context.packageName);
   if (!SlangUtils::CreateDirectoryWithParents(llvm::StringRef(output_path),
                                               nullptr)) {
-    fprintf(stderr, "Error: could not create dir %s\n", output_path.c_str());
+    context.messages->err() << "Error: could not create dir " << output_path
+                            << "\n";
     return false;
   }
 
@@ -273,7 +325,8 @@ bool RSSlangReflectUtils::GenerateJavaBitCodeAccessor(
 
   GeneratedFile out;
   if (!out.startFile(output_path, filename, context.rsFileName,
-                     context.licenseNote, true, context.verbose)) {
+                     context.licenseNote, true, context.verbose,
+                     context.messages)) {
     return false;
   }
 
@@ -285,6 +338,55 @@ bool RSSlangReflectUtils::GenerateJavaBitCodeAccessor(
   return ret;
 }
 
+bool RSSlangReflectUtils::ReadBitCodePayload(const std::string &bcFileName,
+                                             bool compress, bool verbose,
+                                             BitCodePayload *payload,
+                                             ReflectionMessages *messages) {
+  llvm::ErrorOr<std::unique_ptr<llvm::MemoryBuffer>> MBOrErr =
+      llvm::MemoryBuffer::getFile(bcFileName);
+  if (std::error_code EC = MBOrErr.getError()) {
+    messages->err() << "Error: could not read file " << bcFileName << ": "
+                    << EC.message() << "\n";
+    return false;
+  }
+  llvm::StringRef bitcode = MBOrErr.get()->getBuffer();
+
+  payload->uncompressedSize = bitcode.size();
+  payload->compressed = false;
+  if (!compress) {
+    payload->data = bitcode.str();
+    return true;
+  }
+
+  llvm::SmallVector<char, 0> compressed;
+  if (!llvm::zlib::isAvailable() ||
+      (llvm::zlib::compress(bitcode, compressed,
+                            llvm::zlib::BestSizeCompression) !=
+       llvm::zlib::StatusOK)) {
+    messages->err() << "Error: could not compress file " << bcFileName << "\n";
+    return false;
+  }
+  payload->data.assign(compressed.begin(), compressed.end());
+  payload->compressed = true;
+
+  if (verbose) {
+    messages->out() << llvm::format(
+        "Compressed bitcode %s: %u -> %u bytes (%.1f%%)\n",
+        bcFileName.c_str(), static_cast<unsigned>(bitcode.size()),
+        static_cast<unsigned>(payload->data.size()),
+        bitcode.empty() ? 100.0 :
+            (100.0 * payload->data.size() / bitcode.size()));
+  }
+  return true;
+}
+
+void ReflectionMessages::print() {
+  fputs(mOut.str().c_str(), stdout);
+  fputs(mErr.str().c_str(), stderr);
+  mOutBuffer.clear();
+  mErrBuffer.clear();
+}
+
 std::string JoinPath(const std::string &path1, const std::string &path2) {
   if (path1.empty()) {
     return path2;
@@ -341,16 +443,17 @@ bool GeneratedFile::startFile(const string &outDirectory,
                               const string &outFileName,
                               const string &sourceFileName,
                               const string *optionalLicense, bool isJava,
-                              bool verbose) {
+                              bool verbose,
+                              ReflectionMessages *messages) {
   if (verbose) {
-    printf("Generating %s\n", outFileName.c_str());
+    messages->out() << "Generating " << outFileName << "\n";
   }
 
   // Create the parent directories.
   if (!outDirectory.empty()) {
     std::string errorMsg;
     if (!SlangUtils::CreateDirectoryWithParents(outDirectory, &errorMsg)) {
-      fprintf(stderr, "Error: %s\n", errorMsg.c_str());
+      messages->err() << "Error: " << errorMsg << "\n";
       return false;
     }
   }
@@ -360,7 +463,7 @@ bool GeneratedFile::startFile(const string &outDirectory,
   // Open the file.
   open(FilePath.c_str());
   if (!good()) {
-    fprintf(stderr, "Error: could not write file %s\n", outFileName.c_str());
+    messages->err() << "Error: could not write file " << outFileName << "\n";
     return false;
   }
 
@@ -20,8 +20,32 @@
 #include <fstream>
 #include <string>
 
+#include "llvm/Support/raw_ostream.h"
+
 namespace slang {
 
+// The messages printed while reflecting an input file. The reflection may run
+// while the next input file is compiled (see SlangRS::ReflectionJob), so they
+// are buffered and printed once the reflection is done, in the order of a
+// sequential compilation.
+class ReflectionMessages {
+ private:
+  std::string mOutBuffer;
+  std::string mErrBuffer;
+  llvm::raw_string_ostream mOut;
+  llvm::raw_string_ostream mErr;
+
+ public:
+  ReflectionMessages() : mOut(mOutBuffer), mErr(mErrBuffer) { }
+
+  // The buffered standard output and standard error respectively
+  llvm::raw_ostream &out() { return mOut; }
+  llvm::raw_ostream &err() { return mErr; }
+
+  // Print the buffered messages and clear them.
+  void print();
+};
+
 // BitCode storage type
 enum BitCodeStorageType { BCST_APK_RESOURCE, BCST_JAVA_CODE, BCST_CPP_CODE };
 
@@ -36,6 +60,8 @@ public:
   // packageName: the package of the output Java file.
   // verbose: whether or not to print out additional info about compilation.
   // bcStorage: where to emit bitcode to (resource file or embedded).
+  // compress: whether to embed the bitcode compressed with zlib.
+  // messages: where to report errors.
   struct BitCodeAccessorContext {
     const char *rsFileName;
     const char *bc32FileName;
@@ -45,6 +71,17 @@ public:
     const std::string *licenseNote;
     bool verbose;
     BitCodeStorageType bcStorage;
+    bool compress;
+    ReflectionMessages *messages;
+  };
+
+  // The bitcode as stored in the reflected sources or in the raw resource.
+  // data: the stored bytes (a zlib stream if compressed).
+  // uncompressedSize: the size of the bitcode itself.
+  struct BitCodePayload {
+    std::string data;
+    size_t uncompressedSize;
+    bool compressed;
   };
 
   // Return the stem of the file name, i.e., remove the dir and the extension.
@@ -86,6 +123,13 @@ public:
 
   // Generate the bit code accessor Java source file.
   static bool GenerateJavaBitCodeAccessor(const BitCodeAccessorContext &context);
+
+  // Read the bitcode file bcFileName into payload, compressing it with zlib
+  // if compress is set. Errors (and the compression ratio if verbose is set)
+  // are reported to messages.
+  static bool ReadBitCodePayload(const std::string &bcFileName, bool compress,
+                                 bool verbose, BitCodePayload *payload,
+                                 ReflectionMessages *messages);
 };
 
 // Joins two sections of a path, inserting a separator if needed.
@@ -111,11 +155,13 @@ public:
    * - opening the stream,
    * - writing out the license,
    * - writing a message that this file has been auto-generated.
-   * If optionalLicense is nullptr, a default license is used.
+   * If optionalLicense is nullptr, a default license is used. Errors (and
+   * the name of the file if verbose is set) are reported to messages.
    */
   bool startFile(const std::string &outPath, const std::string &outFileName,
                  const std::string &sourceFileName,
-                 const std::string *optionalLicense, bool isJava, bool verbose);
+                 const std::string *optionalLicense, bool isJava, bool verbose,
+                 ReflectionMessages *messages);
   void closeFile();
 
   void increaseIndent(); // Increases the new line indentation by 4.
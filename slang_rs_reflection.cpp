@@ -35,6 +35,7 @@
 #include "slang_rs_export_var.h"
 #include "slang_rs_export_foreach.h"
 #include "slang_rs_export_func.h"
+#include "slang_rs_export_reduce.h"
 #include "slang_rs_reflect_utils.h"
 #include "slang_version.h"
 #include "slang_utils.h"
@@ -44,6 +45,9 @@
 
 #define RS_TYPE_CLASS_SUPER_CLASS_NAME ".Script.FieldBase"
 
+#define RS_SOA_TYPE_CLASS_NAME_PREFIX "ScriptFieldSoA_"
+#define RS_SOA_FIELD_ALLOCATION_PREFIX "mAlloc_"
+
 #define RS_TYPE_ITEM_CLASS_NAME "Item"
 
 #define RS_TYPE_ITEM_SIZEOF_LEGACY "Item.sizeof"
@@ -51,6 +55,8 @@
 
 #define RS_TYPE_ITEM_BUFFER_NAME "mItemArray"
 #define RS_TYPE_ITEM_BUFFER_PACKER_NAME "mIOBuffer"
+#define RS_TYPE_RANGE_BUFFER_PACKER_NAME "mRangeBuffer"
+#define RS_TYPE_DIRTY_SET_NAME "mDirty"
 #define RS_TYPE_ELEMENT_REF_NAME "mElementCache"
 
 #define RS_EXPORT_VAR_INDEX_PREFIX "mExportVarIdx_"
@@ -58,15 +64,26 @@
 #define RS_EXPORT_VAR_ELEM_PREFIX "mExportVarElem_"
 #define RS_EXPORT_VAR_DIM_PREFIX "mExportVarDim_"
 #define RS_EXPORT_VAR_CONST_PREFIX "const_"
+#define RS_EXPORT_VAR_FP_PREFIX "mExportVarFP_"
 
 #define RS_ELEM_PREFIX "__"
 
 #define RS_FP_PREFIX "__rs_fp_"
 
 #define RS_RESOURCE_NAME "__rs_resource_name"
+#define RS_INFLATE_BITCODE_METHOD "inflateBitCode"
 
 #define RS_EXPORT_FUNC_INDEX_PREFIX "mExportFuncIdx_"
 #define RS_EXPORT_FOREACH_INDEX_PREFIX "mExportForEachIdx_"
+#define RS_EXPORT_FUNC_FP_PREFIX "mExportFuncFP_"
+#define RS_EXPORT_FOREACH_FP_PREFIX "mExportForEachFP_"
+#define RS_EXPORT_FOREACH_LAUNCH_PREFIX "Launch_"
+#define RS_EXPORT_REDUCE_INDEX_PREFIX "mExportReduceIdx_"
+#define RS_REDUCE_RS_NAME "mRSLocal"
+#define RS_BATCH_FP_NAME "$batchPacker"
+#define RS_BATCH_COUNT_NAME "$batchCount"
+#define RS_BATCH_INDEX_NAME "$batchIndex"
+#define RS_SPECIALIZED_NAME "mSpecialized"
 
 #define RS_EXPORT_VAR_ALLOCATION_PREFIX "mAlloction_"
 #define RS_EXPORT_VAR_DATA_STORAGE_PREFIX "mData_"
@@ -131,9 +148,43 @@ static const char *GetVectorAccessor(unsigned Index) {
   return VectorAccessorMap[Index];
 }
 
+// Returns the Java primitive type of the arrays used to move the values of a
+// field of a struct in structure-of-arrays layout in and out of the field's
+// Allocation. Unsigned values are moved as their raw bits (e.g., uint as int)
+// since that is what Allocation.copyFrom()/copyTo() accept.
+static const char *GetSoAArrayTypeName(const RSExportType *ET) {
+  slangAssert(((ET->getClass() == RSExportType::ExportClassPrimitive) ||
+               (ET->getClass() == RSExportType::ExportClassVector)) &&
+              "Unsupported type of field in structure-of-arrays layout");
+
+  switch (static_cast<const RSExportPrimitiveType *>(ET)->getType()) {
+  case DataTypeFloat32:
+    return "float";
+  case DataTypeFloat64:
+    return "double";
+  case DataTypeSigned8:
+  case DataTypeUnsigned8:
+    return "byte";
+  case DataTypeFloat16:
+  case DataTypeSigned16:
+  case DataTypeUnsigned16:
+    return "short";
+  case DataTypeSigned32:
+  case DataTypeUnsigned32:
+    return "int";
+  case DataTypeSigned64:
+  case DataTypeUnsigned64:
+    return "long";
+  default:
+    slangAssert(false && "Unsupported type of field in structure-of-arrays "
+                         "layout");
+  }
+  return nullptr;
+}
+
 static const char *GetPackerAPIName(const RSExportPrimitiveType *EPT) {
   static const char *PrimitiveTypePackerAPINameMap[] = {
-      "",           // DataTypeFloat16
+      "addI16",     // DataTypeFloat16
       "addF32",     // DataTypeFloat32
       "addF64",     // DataTypeFloat64
       "addI8",      // DataTypeSigned8
@@ -242,6 +293,40 @@ static const char *GetTypeNullValue(const RSExportType *ET) {
   return "";
 }
 
+// Returns the Java expression reading a value of type @DT stored (by a
+// FieldPacker, i.e., in little-endian order) at byte offset @Offset of the
+// byte[] named "d", or an empty string if @DT cannot be read back.
+static std::string GetUnpackExpr(DataType DT, const std::string &Offset) {
+  std::string Args = "(d, " + Offset + ")";
+  switch (DT) {
+  case DataTypeFloat16:
+    return "unpackI16" + Args;
+  case DataTypeFloat32:
+    return "Float.intBitsToFloat(unpackI32" + Args + ")";
+  case DataTypeFloat64:
+    return "Double.longBitsToDouble(unpackI64" + Args + ")";
+  case DataTypeSigned8:
+    return "d[" + Offset + "]";
+  case DataTypeSigned16:
+    return "unpackI16" + Args;
+  case DataTypeSigned32:
+    return "unpackI32" + Args;
+  case DataTypeSigned64:
+  case DataTypeUnsigned64:
+    return "unpackI64" + Args;
+  case DataTypeUnsigned8:
+    return "(short) (d[" + Offset + "] & 0xff)";
+  case DataTypeUnsigned16:
+    return "(unpackI16" + Args + " & 0xffff)";
+  case DataTypeUnsigned32:
+    return "(unpackI32" + Args + " & 0xffffffffL)";
+  case DataTypeBoolean:
+    return "(d[" + Offset + "] != 0)";
+  default:
+    return "";
+  }
+}
+
 static std::string GetBuiltinElementConstruct(const RSExportType *ET) {
   if (ET->getClass() == RSExportType::ExportClassPrimitive) {
     return std::string("Element.") + ET->getElementName();
@@ -281,12 +366,17 @@ static std::string GetBuiltinElementConstruct(const RSExportType *ET) {
 
 /********************** Methods to generate script class **********************/
 RSReflectionJava::RSReflectionJava(const RSContext *Context,
+                                   ReflectionMessages *Messages,
                                    std::vector<std::string> *GeneratedFileNames,
                                    const std::string &OutputBaseDirectory,
                                    const std::string &RSSourceFileName,
                                    const std::string &BitCodeFileName,
-                                   bool EmbedBitcodeInJava)
-    : mRSContext(Context), mPackageName(Context->getReflectJavaPackageName()),
+                                   bool EmbedBitcodeInJava,
+                                   bool PackedFieldStorage,
+                                   bool ElideRedundantSet,
+                                   bool CompressBitcode)
+    : mRSContext(Context), mMessages(Messages),
+      mPackageName(Context->getReflectJavaPackageName()),
       mRSPackageName(Context->getRSPackageName()),
       mOutputBaseDirectory(OutputBaseDirectory),
       mRSSourceFileName(RSSourceFileName), mBitCodeFileName(BitCodeFileName),
@@ -295,8 +385,12 @@ RSReflectionJava::RSReflectionJava(const RSContext *Context,
       mScriptClassName(RS_SCRIPT_CLASS_NAME_PREFIX +
                        RSSlangReflectUtils::JavaClassNameFromRSFileName(
                            mRSSourceFileName.c_str())),
-      mEmbedBitcodeInJava(EmbedBitcodeInJava), mNextExportVarSlot(0),
-      mNextExportFuncSlot(0), mNextExportForEachSlot(0), mLastError(""),
+      mEmbedBitcodeInJava(EmbedBitcodeInJava),
+      mPackedFieldStorage(PackedFieldStorage),
+      mElideRedundantSet(ElideRedundantSet),
+      mCompressBitcode(CompressBitcode), mNextExportVarSlot(0),
+      mNextExportFuncSlot(0), mNextExportForEachSlot(0),
+      mNextExportReduceSlot(0), mLastError(""),
       mGeneratedFileNames(GeneratedFileNames), mFieldIndex(0) {
   slangAssert(mGeneratedFileNames && "Must supply GeneratedFileNames");
   slangAssert(!mPackageName.empty() && mPackageName != "-");
@@ -327,6 +421,17 @@ bool RSReflectionJava::genScriptClass(const std::string &ClassName,
        I != E; I++)
     genExportVariable(*I);
 
+  // Reflect the groups of exported variables holding a struct in
+  // structure-of-arrays layout
+  for (RSContext::const_soa_binding_iterator
+           I = mRSContext->soa_bindings_begin(),
+           E = mRSContext->soa_bindings_end();
+       I != E; I++)
+    genSoABinding(*I);
+
+  if (mRSContext->hasSpecializedExportVar())
+    genSpecialize();
+
   // Reflect export for each functions (only available on ICS+)
   if (mRSContext->getTargetAPI() >= SLANG_ICS_TARGET_API) {
     for (RSContext::const_export_foreach_iterator
@@ -336,6 +441,13 @@ bool RSReflectionJava::genScriptClass(const std::string &ClassName,
       genExportForEach(*I);
   }
 
+  // Reflect the reduction kernels
+  for (RSContext::const_export_reduce_iterator
+           I = mRSContext->export_reduce_begin(),
+           E = mRSContext->export_reduce_end();
+       I != E; I++)
+    genExportReduce(*I);
+
   // Reflect export function
   for (RSContext::const_export_func_iterator
            I = mRSContext->export_funcs_begin(),
@@ -343,6 +455,22 @@ bool RSReflectionJava::genScriptClass(const std::string &ClassName,
        I != E; I++)
     genExportFunction(*I);
 
+  // The batch helpers follow all the other functions (see
+  // RSBackend::dumpExportFunctionInfo()).
+  for (RSContext::const_export_func_iterator
+           I = mRSContext->export_funcs_begin(),
+           E = mRSContext->export_funcs_end();
+       I != E; I++) {
+    if ((*I)->isBatched()) {
+      genExportFunctionBatch(*I);
+    }
+  }
+
+  // reduce_*() unpack their result with these.
+  if (mRSContext->hasExportReduce()) {
+    genPackedTypeClassUnpackHelpers();
+  }
+
   endClass();
 
   return true;
@@ -382,8 +510,21 @@ void RSReflectionJava::genScriptClassConstructor() {
     // Alternate constructor (legacy) with 3 original parameters.
     startFunction(AM_Public, false, nullptr, getClassName(), 3, "RenderScript",
                   "rs", "Resources", "resources", "int", "id");
-    // Call constructor of super class
-    mOut.indent() << "super(rs, resources, id);\n";
+    if (mCompressBitcode) {
+      // The raw resource holds the compressed bitcode, which only the
+      // constructor taking bitcode arrays can be given once inflated.
+      mOut.indent() << "this(rs, resources.getResourceEntryName(id),\n";
+      mOut.indent() << "     " RS_INFLATE_BITCODE_METHOD "(resources, id));\n";
+      endFunction();
+
+      startFunction(AM_Private, false, nullptr, getClassName(), 3,
+                    "RenderScript", "rs", "String", "resName", "byte[]",
+                    "bitCode");
+      mOut.indent() << "super(rs, resName, bitCode, bitCode);\n";
+    } else {
+      // Call constructor of super class
+      mOut.indent() << "super(rs, resources, id);\n";
+    }
   }
 
   // If an exported variable has initial value, reflect it
@@ -436,8 +577,32 @@ void RSReflectionJava::genScriptClassConstructor() {
     }
   }
 
+  for (RSContext::const_export_reduce_iterator
+           I = mRSContext->export_reduce_begin(),
+           E = mRSContext->export_reduce_end();
+       I != E; I++) {
+    const RSExportReduce *ER = *I;
+
+    const RSExportReduce::InTypeVec &InTypes = ER->getInTypes();
+    for (RSExportReduce::InTypeVec::const_iterator BI = InTypes.begin(),
+                                                   EI = InTypes.end();
+         BI != EI; BI++) {
+      genTypeInstance(*BI);
+    }
+    genTypeInstance(ER->getResultType());
+  }
+
+  // The result allocations of reduce_*() are created with it.
+  if (mRSContext->hasExportReduce()) {
+    mOut.indent() << RS_REDUCE_RS_NAME " = rs;\n";
+  }
+
   endFunction();
 
+  if (mRSContext->hasExportReduce()) {
+    mOut.indent() << "private RenderScript " RS_REDUCE_RS_NAME ";\n";
+  }
+
   for (std::set<std::string>::iterator I = mTypesToCheck.begin(),
                                        E = mTypesToCheck.end();
        I != E; I++) {
@@ -449,6 +614,45 @@ void RSReflectionJava::genScriptClassConstructor() {
        I != E; I++) {
     mOut.indent() << "private FieldPacker " RS_FP_PREFIX << *I << ";\n";
   }
+
+  if (!getEmbedBitcodeInJava() && mCompressBitcode) {
+    genInflateBitCodeResource();
+  }
+}
+
+void RSReflectionJava::genInflateBitCodeResource() {
+  // The resource is the size of the bitcode (big-endian int) followed by the
+  // zlib stream.
+  startFunction(AM_Private, true, "byte[]", RS_INFLATE_BITCODE_METHOD, 2,
+                "Resources", "resources", "int", "id");
+  mOut.indent() << "java.io.InputStream is = resources.openRawResource(id);\n";
+  mOut.indent() << "java.util.zip.Inflater inflater = "
+                   "new java.util.zip.Inflater();\n";
+  mOut.indent() << "try {\n";
+  mOut.indent() << "    java.io.DataInputStream in = "
+                   "new java.io.DataInputStream(\n";
+  mOut.indent() << "        new java.io.BufferedInputStream(is));\n";
+  mOut.indent() << "    byte[] bc = new byte[in.readInt()];\n";
+  mOut.indent() << "    java.io.InputStream zin = "
+                   "new java.util.zip.InflaterInputStream(in, inflater);\n";
+  mOut.indent() << "    new java.io.DataInputStream(zin).readFully(bc);\n";
+  // The zlib stream has to end exactly after the recorded number of bytes.
+  mOut.indent() << "    if ((zin.read() != -1) || !inflater.finished()) {\n";
+  mOut.indent() << "        throw new RSRuntimeException(\"Corrupted bitcode "
+                   "resource\");\n";
+  mOut.indent() << "    }\n";
+  mOut.indent() << "    return bc;\n";
+  mOut.indent() << "} catch (java.io.IOException e) {\n";
+  mOut.indent() << "    throw new RSRuntimeException(\"Unable to read "
+                   "bitcode resource: \" + e);\n";
+  mOut.indent() << "} finally {\n";
+  mOut.indent() << "    inflater.end();\n";
+  mOut.indent() << "    try {\n";
+  mOut.indent() << "        is.close();\n";
+  mOut.indent() << "    } catch (java.io.IOException e) {\n";
+  mOut.indent() << "    }\n";
+  mOut.indent() << "}\n";
+  endFunction();
 }
 
 void RSReflectionJava::genInitBoolExportVariable(const std::string &VarName,
@@ -490,8 +694,8 @@ void RSReflectionJava::genInitExportVariable(const RSExportType *ET,
   }
   case RSExportType::ExportClassPointer: {
     if (!Val.isInt() || Val.getInt().getSExtValue() != 0)
-      std::cout << "Initializer which is non-NULL to pointer type variable "
-                   "will be ignored\n";
+      mMessages->out() << "Initializer which is non-NULL to pointer type "
+                          "variable will be ignored\n";
     break;
   }
   case RSExportType::ExportClassVector: {
@@ -626,8 +830,15 @@ void RSReflectionJava::genExportFunction(const RSExportFunc *EF) {
     }
   }
 
-  startFunction(AM_Public, false, "void",
-                "invoke_" + EF->getName(/*Mangle=*/false),
+  // The parameters are packed into a FieldPacker owned by the script object,
+  // so the method is synchronized to keep concurrent callers from sharing it.
+  std::string FieldPackerName = RS_EXPORT_FUNC_FP_PREFIX + EF->getName();
+  if (EF->hasParam()) {
+    genCachedFieldPackerDecl(FieldPackerName);
+  }
+
+  startFunction(EF->hasParam() ? AM_PublicSynchronized : AM_Public, false,
+                "void", "invoke_" + EF->getName(/*Mangle=*/false),
                 // We are using un-mangled name since Java
                 // supports method overloading.
                 Args);
@@ -637,9 +848,8 @@ void RSReflectionJava::genExportFunction(const RSExportFunc *EF) {
                   << ");\n";
   } else {
     const RSExportRecordType *ERT = EF->getParamPacketType();
-    std::string FieldPackerName = EF->getName() + "_fp";
 
-    if (genCreateFieldPacker(ERT, FieldPackerName.c_str()))
+    if (genResetCachedFieldPacker(ERT, FieldPackerName))
       genPackVarOfType(ERT, nullptr, FieldPackerName.c_str());
 
     mOut.indent() << "invoke(" << RS_EXPORT_FUNC_INDEX_PREFIX << EF->getName()
@@ -649,6 +859,73 @@ void RSReflectionJava::genExportFunction(const RSExportFunc *EF) {
   endFunction();
 }
 
+void RSReflectionJava::genExportFunctionBatch(const RSExportFunc *EF) {
+  std::string SlotName =
+      RS_EXPORT_FUNC_INDEX_PREFIX + EF->getName() + "_batch";
+  mOut.indent() << "private final static int " << SlotName << " = "
+                << getNextExportFuncSlot() << ";\n";
+
+  // invoke_*_batch() takes one array per parameter and calls the function
+  // for the first $batchCount elements of each, with a single round-trip. The
+  // generated names start with '$' so that they can't collide with the ones
+  // of the parameters.
+  ArgTy Args;
+  for (RSExportFunc::const_param_iterator I = EF->params_begin(),
+                                          E = EF->params_end();
+       I != E; I++) {
+    Args.push_back(
+        std::make_pair(GetTypeName((*I)->getType()) + "[]", (*I)->getName()));
+  }
+  Args.push_back(std::make_pair("int", RS_BATCH_COUNT_NAME));
+
+  startFunction(AM_Public, false, "void",
+                "invoke_" + EF->getName(/*Mangle=*/false) + "_batch", Args);
+
+  const RSExportRecordType *ERT = EF->getParamPacketType();
+  mOut.indent() << "if (" RS_BATCH_COUNT_NAME " <= 0) return;\n";
+  mOut.indent() << "FieldPacker " RS_BATCH_FP_NAME " = new FieldPacker("
+                << RS_BATCH_COUNT_NAME " * " << ERT->getAllocSize() << ");\n";
+  mOut.indent() << "for (int " RS_BATCH_INDEX_NAME " = 0; "
+                << RS_BATCH_INDEX_NAME " < " RS_BATCH_COUNT_NAME "; "
+                << RS_BATCH_INDEX_NAME "++)";
+  mOut.startBlock();
+
+  // Same layout as genPackVarOfType() for the packet, with the
+  // $batchIndex-th element of each array.
+  unsigned Pos = 0;
+  for (RSExportRecordType::const_field_iterator I = ERT->fields_begin(),
+                                                E = ERT->fields_end();
+       I != E; I++) {
+    const RSExportRecordType::Field *F = *I;
+    size_t FieldOffset = F->getOffsetInParent();
+    const RSExportType *T = F->getType();
+    size_t FieldStoreSize = T->getStoreSize();
+    size_t FieldAllocSize = T->getAllocSize();
+
+    if (FieldOffset > Pos) {
+      mOut.indent() << RS_BATCH_FP_NAME ".skip(" << (FieldOffset - Pos)
+                    << ");\n";
+    }
+
+    genPackVarOfType(T, (F->getName() + "[" RS_BATCH_INDEX_NAME "]").c_str(), RS_BATCH_FP_NAME);
+
+    if (FieldAllocSize > FieldStoreSize) {
+      mOut.indent() << RS_BATCH_FP_NAME ".skip("
+                    << (FieldAllocSize - FieldStoreSize) << ");\n";
+    }
+
+    Pos = FieldOffset + FieldAllocSize;
+  }
+  if (ERT->getAllocSize() > Pos) {
+    mOut.indent() << RS_BATCH_FP_NAME ".skip(" << ERT->getAllocSize() - Pos
+                  << ");\n";
+  }
+  mOut.endBlock();
+
+  mOut.indent() << "invoke(" << SlotName << ", " RS_BATCH_FP_NAME ");\n";
+  endFunction();
+}
+
 void RSReflectionJava::genPairwiseDimCheck(std::string name0,
                                            std::string name1) {
 
@@ -686,9 +963,7 @@ void RSReflectionJava::genExportForEach(const RSExportForEach *EF) {
 
   slangAssert(EF->getNumParameters() > 0 || EF->hasReturn());
 
-  const RSExportForEach::InVec     &Ins     = EF->getIns();
-  const RSExportForEach::InTypeVec &InTypes = EF->getInTypes();
-  const RSExportType               *OET     = EF->getOutType();
+  const RSExportForEach::InVec &Ins = EF->getIns();
 
   if (Ins.size() == 1) {
     Args.push_back(std::make_pair("Allocation", "ain"));
@@ -761,7 +1036,54 @@ void RSReflectionJava::genExportForEach(const RSExportForEach *EF) {
     Args.push_back(std::make_pair("Script.LaunchOptions", "sc"));
   }
 
-  startFunction(AM_Public, false, "void", "forEach_" + EF->getName(), Args);
+  // As for invokables, the parameters of the kernel are packed into a
+  // FieldPacker owned by the script object.
+  std::string FieldPackerName = RS_EXPORT_FOREACH_FP_PREFIX + EF->getName();
+  if (ERT) {
+    genCachedFieldPackerDecl(FieldPackerName);
+  }
+
+  startFunction(ERT ? AM_PublicSynchronized : AM_Public, false, "void",
+                "forEach_" + EF->getName(), Args);
+
+  genForEachChecks(EF);
+
+  if (ERT) {
+    if (genResetCachedFieldPacker(ERT, FieldPackerName)) {
+      genPackVarOfType(ERT, nullptr, FieldPackerName.c_str());
+    }
+  }
+  mOut.indent() << "forEach(" << RS_EXPORT_FOREACH_INDEX_PREFIX
+                << EF->getName() << ", ";
+  genForEachInputs(EF);
+
+  if (EF->hasOut() || EF->hasReturn())
+    mOut << ", aout";
+  else
+    mOut << ", null";
+
+  if (EF->hasUsrData())
+    mOut << ", " << FieldPackerName;
+  else
+    mOut << ", null";
+
+  if (mRSContext->getTargetAPI() >= SLANG_JB_MR2_TARGET_API) {
+    mOut << ", sc);\n";
+  } else {
+    mOut << ");\n";
+  }
+
+  endFunction();
+
+  if (mRSContext->getTargetAPI() >= SLANG_JB_MR2_TARGET_API) {
+    genExportForEachLaunch(EF, Args);
+  }
+}
+
+void RSReflectionJava::genForEachChecks(const RSExportForEach *EF) {
+  const RSExportForEach::InVec &Ins = EF->getIns();
+  const RSExportForEach::InTypeVec &InTypes = EF->getInTypes();
+  const RSExportType *OET = EF->getOutType();
 
   if (InTypes.size() == 1) {
     if (InTypes.front() != nullptr) {
@@ -800,20 +1122,15 @@ void RSReflectionJava::genExportForEach(const RSExportForEach *EF) {
       genPairwiseDimCheck(In0Name, "aout");
     }
   }
+}
 
-  std::string FieldPackerName = EF->getName() + "_fp";
-  if (ERT) {
-    if (genCreateFieldPacker(ERT, FieldPackerName.c_str())) {
-      genPackVarOfType(ERT, nullptr, FieldPackerName.c_str());
-    }
-  }
-  mOut.indent() << "forEach(" << RS_EXPORT_FOREACH_INDEX_PREFIX
-                << EF->getName();
+void RSReflectionJava::genForEachInputs(const RSExportForEach *EF) {
+  const RSExportForEach::InVec &Ins = EF->getIns();
 
   if (Ins.size() == 1) {
-    mOut << ", ain";
+    mOut << "ain";
   } else if (Ins.size() > 1) {
-    mOut << ", new Allocation[]{ain_" << Ins[0]->getName().str();
+    mOut << "new Allocation[]{ain_" << Ins[0]->getName().str();
 
     for (size_t index = 1; index < Ins.size(); ++index) {
       mOut << ", ain_" << Ins[index]->getName().str();
@@ -822,25 +1139,141 @@ void RSReflectionJava::genExportForEach(const RSExportForEach *EF) {
     mOut << "}";
 
   } else {
-    mOut << ", (Allocation) null";
+    mOut << "(Allocation) null";
   }
+}
 
-  if (EF->hasOut() || EF->hasReturn())
-    mOut << ", aout";
-  else
-    mOut << ", null";
+void RSReflectionJava::genExportForEachLaunch(const RSExportForEach *EF,
+                                              const ArgTy &Args) {
+  std::string ClassName = RS_EXPORT_FOREACH_LAUNCH_PREFIX + EF->getName();
+  const char *InsType = (EF->getIns().size() > 1) ? "Allocation[]"
+                                                   : "Allocation";
+  const RSExportRecordType *ERT = EF->getParamPacketType();
 
-  if (EF->hasUsrData())
-    mOut << ", " << FieldPackerName;
-  else
-    mOut << ", null";
+  // The launch handle only holds what forEach() needs, the checks are done
+  // once by prepare_*().
+  mOut.indent() << "public final class " << ClassName;
+  mOut.startBlock();
+  mOut.indent() << "private final " << InsType << " mIn;\n";
+  mOut.indent() << "private final Allocation mOut;\n";
+  mOut.indent() << "private final FieldPacker mParams;\n";
+  mOut.indent() << "private final Script.LaunchOptions mLaunchOptions;\n\n";
+
+  startFunction(AM_Private, false, nullptr, ClassName, 4, InsType, "in",
+                "Allocation", "out", "FieldPacker", "params",
+                "Script.LaunchOptions", "sc");
+  mOut.indent() << "mIn = in;\n";
+  mOut.indent() << "mOut = out;\n";
+  mOut.indent() << "mParams = params;\n";
+  mOut.indent() << "mLaunchOptions = sc;\n";
+  endFunction();
 
-  if (mRSContext->getTargetAPI() >= SLANG_JB_MR2_TARGET_API) {
-    mOut << ", sc);\n";
+  startFunction(AM_Public, false, "void", "launch", 0);
+  mOut.indent() << "forEach(" << RS_EXPORT_FOREACH_INDEX_PREFIX
+                << EF->getName()
+                << ", mIn, mOut, mParams, mLaunchOptions);\n";
+  endFunction();
+  mOut.endBlock();
+
+  startFunction(AM_Public, false, ClassName.c_str(),
+                "prepare_" + EF->getName(), Args);
+  genForEachChecks(EF);
+
+  // Each handle owns its packed parameters.
+  if (EF->hasUsrData()) {
+    mOut.indent() << "FieldPacker params = new FieldPacker("
+                  << ERT->getAllocSize() << ");\n";
+    genPackVarOfType(ERT, nullptr, "params");
   } else {
-    mOut << ");\n";
+    mOut.indent() << "FieldPacker params = null;\n";
   }
 
+  mOut.indent() << "return new " << ClassName << "(";
+  genForEachInputs(EF);
+  mOut << ", " << ((EF->hasOut() || EF->hasReturn()) ? "aout" : "null")
+       << ", params, sc);\n";
+  endFunction();
+}
+
+static std::string GetReduceInputName(const RSExportReduce *ER,
+                                      size_t Index) {
+  const RSExportReduce::InNameVec &InNames = ER->getInNames();
+  if (InNames.size() == 1) {
+    return "ain";
+  }
+  return "ain_" + InNames[Index];
+}
+
+void RSReflectionJava::genExportReduce(const RSExportReduce *ER) {
+  mOut.indent() << "private final static int " << RS_EXPORT_REDUCE_INDEX_PREFIX
+                << ER->getName() << " = " << getNextExportReduceSlot()
+                << ";\n";
+
+  const RSExportReduce::InTypeVec &InTypes = ER->getInTypes();
+  const RSExportType *ResultType = ER->getResultType();
+  std::string ResultTypeName = GetTypeName(ResultType);
+
+  ArgTy Args;
+  for (size_t Index = 0; Index < InTypes.size(); Index++) {
+    Args.push_back(
+        std::make_pair("Allocation", GetReduceInputName(ER, Index)));
+  }
+
+  // reduce_*() without launch options reduces all the cells.
+  startFunction(AM_Public, false, ResultTypeName.c_str(),
+                "reduce_" + ER->getName(), Args);
+  mOut.indent() << "return reduce_" << ER->getName() << "(";
+  for (ArgTy::const_iterator I = Args.begin(), E = Args.end(); I != E; I++) {
+    mOut << I->second << ", ";
+  }
+  mOut << "null);\n";
+  endFunction();
+
+  Args.push_back(std::make_pair("Script.LaunchOptions", "sc"));
+  startFunction(AM_Public, false, ResultTypeName.c_str(),
+                "reduce_" + ER->getName(), Args);
+
+  for (size_t Index = 0; Index < InTypes.size(); Index++) {
+    genTypeCheck(InTypes[Index], GetReduceInputName(ER, Index).c_str());
+  }
+  if (InTypes.size() > 1) {
+    mOut.indent() << "Type t0, t1;\n";
+    for (size_t Index = 1; Index < InTypes.size(); Index++) {
+      genPairwiseDimCheck(GetReduceInputName(ER, 0),
+                          GetReduceInputName(ER, Index));
+    }
+  }
+
+  // The runtime stores the result into a single cell allocation.
+  mOut.indent() << "Allocation aout = Allocation.createSized("
+                   RS_REDUCE_RS_NAME ", " RS_ELEM_PREFIX
+                << ResultType->getElementName() << ", 1);\n";
+  mOut.indent() << "reduce(" << RS_EXPORT_REDUCE_INDEX_PREFIX << ER->getName()
+                << ", new Allocation[]{";
+  for (size_t Index = 0; Index < InTypes.size(); Index++) {
+    mOut << ((Index > 0) ? ", " : "") << GetReduceInputName(ER, Index);
+  }
+  mOut << "}, aout, sc);\n";
+  mOut.indent() << "byte[] d = new byte[" << ResultType->getAllocSize()
+                << "];\n";
+  mOut.indent() << "aout.copy1DRangeToUnchecked(0, 1, d);\n";
+  mOut.indent() << "aout.destroy();\n";
+
+  if (ResultType->getClass() == RSExportType::ExportClassVector) {
+    const RSExportVectorType *EVT =
+        static_cast<const RSExportVectorType *>(ResultType);
+    unsigned ComponentSize = RSExportPrimitiveType::GetSizeInBits(EVT) / 8;
+    mOut.indent() << "return new " << ResultTypeName << "(";
+    for (unsigned i = 0; i < EVT->getNumElement(); i++) {
+      mOut << ((i > 0) ? ", " : "")
+           << GetUnpackExpr(EVT->getType(), llvm::utostr_32(i * ComponentSize));
+    }
+    mOut << ");\n";
+  } else {
+    const RSExportPrimitiveType *EPT =
+        static_cast<const RSExportPrimitiveType *>(ResultType);
+    mOut.indent() << "return " << GetUnpackExpr(EPT->getType(), "0") << ";\n";
+  }
   endFunction();
 }
 
@@ -957,6 +1390,12 @@ void RSReflectionJava::genPrimitiveTypeExportVariable(const RSExportVar *EV) {
     // be calling setters.
     startFunction(AM_PublicSynchronized, false, "void", "set_" + VarName, 1,
                   TypeName.c_str(), "v");
+    if (EV->isSpecialized()) {
+      genSpecializedCheck(VarName);
+    }
+    if (mElideRedundantSet) {
+      genReturnIfUnchanged(EPT, VarName);
+    }
     if ((EPT->getSize() < 4) || EV->isUnsigned()) {
       // We create/cache a per-type FieldPacker. This allows us to reuse the
       // validation logic (for catching negative inputs from Dalvik, as well
@@ -966,16 +1405,7 @@ void RSReflectionJava::genPrimitiveTypeExportVariable(const RSExportVar *EV) {
       std::string ElemName = EPT->getElementName();
       std::string FPName;
       FPName = RS_FP_PREFIX + ElemName;
-      mOut.indent() << "if (" << FPName << "!= null) {\n";
-      mOut.increaseIndent();
-      mOut.indent() << FPName << ".reset();\n";
-      mOut.decreaseIndent();
-      mOut.indent() << "} else {\n";
-      mOut.increaseIndent();
-      mOut.indent() << FPName << " = new FieldPacker(" << EPT->getSize()
-                    << ");\n";
-      mOut.decreaseIndent();
-      mOut.indent() << "}\n";
+      genResetCachedFieldPacker(EPT, FPName);
 
       genPackVarOfType(EPT, "v", FPName.c_str());
       mOut.indent() << "setVar(" << RS_EXPORT_VAR_INDEX_PREFIX << VarName
@@ -1014,6 +1444,12 @@ void RSReflectionJava::genInitValue(const clang::APValue &Val, bool asBool) {
 
   case clang::APValue::Float: {
     llvm::APFloat apf = Val.getFloat();
+    if (&apf.getSemantics() == &llvm::APFloat::IEEEhalf) {
+      // half values are reflected as their raw bits.
+      mOut << "(short) 0x"
+           << llvm::utohexstr(apf.bitcastToAPInt().getZExtValue());
+      break;
+    }
     llvm::SmallString<30> s;
     apf.toString(s);
     mOut << s.c_str();
@@ -1098,13 +1534,14 @@ void RSReflectionJava::genMatrixTypeExportVariable(const RSExportVar *EV) {
 
   // set_*()
   if (!EV->isConst()) {
-    const char *FieldPackerName = "fp";
+    std::string FieldPackerName = RS_EXPORT_VAR_FP_PREFIX + VarName;
+    genCachedFieldPackerDecl(FieldPackerName);
     startFunction(AM_PublicSynchronized, false, "void", "set_" + VarName, 1,
                   TypeName.c_str(), "v");
     mOut.indent() << RS_EXPORT_VAR_PREFIX << VarName << " = v;\n";
 
-    if (genCreateFieldPacker(ET, FieldPackerName))
-      genPackVarOfType(ET, "v", FieldPackerName);
+    if (genResetCachedFieldPacker(ET, FieldPackerName))
+      genPackVarOfType(ET, "v", FieldPackerName.c_str());
     mOut.indent() << "setVar(" RS_EXPORT_VAR_INDEX_PREFIX << VarName << ", "
                   << FieldPackerName << ");\n";
 
@@ -1143,6 +1580,40 @@ void RSReflectionJava::genRecordTypeExportVariable(const RSExportVar *EV) {
   genGetFieldID(VarName);
 }
 
+void RSReflectionJava::genSpecialize() {
+  mOut.indent() << "private boolean " RS_SPECIALIZED_NAME ";\n";
+
+  mOut.indent() << "// Makes the current values of the variables listed in "
+                   "\"#pragma rs specialize\"\n";
+  mOut.indent() << "// final, so that the script can be compiled for them. "
+                   "Call this once they are\n";
+  mOut.indent() << "// set and before the first launch. Their setters throw "
+                   "afterwards.\n";
+  startFunction(AM_PublicSynchronized, false, "void", "specialize", 0);
+  mOut.indent() << "if (" RS_SPECIALIZED_NAME ") return;\n";
+  mOut.indent() << "specializeVars(new int[] {";
+  bool First = true;
+  for (RSContext::const_export_var_iterator I = mRSContext->export_vars_begin(),
+                                            E = mRSContext->export_vars_end();
+       I != E; I++) {
+    if (!(*I)->isSpecialized())
+      continue;
+    mOut << (First ? " " : ", ") << RS_EXPORT_VAR_INDEX_PREFIX
+         << (*I)->getName();
+    First = false;
+  }
+  mOut << " });\n";
+  mOut.indent() << RS_SPECIALIZED_NAME " = true;\n";
+  endFunction();
+}
+
+void RSReflectionJava::genSpecializedCheck(const std::string &VarName) {
+  mOut.indent() << "if (" RS_SPECIALIZED_NAME ") {\n";
+  mOut.indent() << "    throw new RSInvalidStateException(\"" << VarName
+                << " cannot be set after specialize()\");\n";
+  mOut.indent() << "}\n";
+}
+
 void RSReflectionJava::genPrivateExportVariable(const std::string &TypeName,
                                                 const std::string &VarName) {
   mOut.indent() << "private " << TypeName << " " << RS_EXPORT_VAR_PREFIX
@@ -1152,28 +1623,38 @@ void RSReflectionJava::genPrivateExportVariable(const std::string &TypeName,
 void RSReflectionJava::genSetExportVariable(const std::string &TypeName,
                                             const RSExportVar *EV) {
   if (!EV->isConst()) {
-    const char *FieldPackerName = "fp";
     std::string VarName = EV->getName();
+    std::string FieldPackerName = RS_EXPORT_VAR_FP_PREFIX + VarName;
     const RSExportType *ET = EV->getType();
+
+    genCachedFieldPackerDecl(FieldPackerName);
+    if (mRSContext->getTargetAPI() >= SLANG_JB_TARGET_API) {
+      // We only have support for one-dimensional array reflection today,
+      // but the entry point (i.e. setVar()) takes an array of dimensions.
+      mOut.indent() << "private final static int[] " RS_EXPORT_VAR_DIM_PREFIX
+                    << VarName << " = new int[] { " << ET->getSize()
+                    << " };\n";
+    }
+
     startFunction(AM_PublicSynchronized, false, "void", "set_" + VarName, 1,
                   TypeName.c_str(), "v");
+    if (EV->isSpecialized()) {
+      genSpecializedCheck(VarName);
+    }
     mOut.indent() << RS_EXPORT_VAR_PREFIX << VarName << " = v;\n";
 
-    if (genCreateFieldPacker(ET, FieldPackerName))
-      genPackVarOfType(ET, "v", FieldPackerName);
+    if (genResetCachedFieldPacker(ET, FieldPackerName))
+      genPackVarOfType(ET, "v", FieldPackerName.c_str());
 
     if (mRSContext->getTargetAPI() < SLANG_JB_TARGET_API) {
       // Legacy apps must use the old setVar() without Element/dim components.
       mOut.indent() << "setVar(" << RS_EXPORT_VAR_INDEX_PREFIX << VarName
                     << ", " << FieldPackerName << ");\n";
     } else {
-      // We only have support for one-dimensional array reflection today,
-      // but the entry point (i.e. setVar()) takes an array of dimensions.
-      mOut.indent() << "int []__dimArr = new int[1];\n";
-      mOut.indent() << "__dimArr[0] = " << ET->getSize() << ";\n";
       mOut.indent() << "setVar(" << RS_EXPORT_VAR_INDEX_PREFIX << VarName
                     << ", " << FieldPackerName << ", " << RS_ELEM_PREFIX
-                    << ET->getElementName() << ", __dimArr);\n";
+                    << ET->getElementName() << ", " RS_EXPORT_VAR_DIM_PREFIX
+                    << VarName << ");\n";
     }
 
     endFunction();
@@ -1204,17 +1685,50 @@ void RSReflectionJava::genGetFieldID(const std::string &VarName) {
 
 /******************* Methods to generate script class /end *******************/
 
-bool RSReflectionJava::genCreateFieldPacker(const RSExportType *ET,
-                                            const char *FieldPackerName) {
+void RSReflectionJava::genCachedFieldPackerDecl(
+    const std::string &FieldPackerName) {
+  mOut.indent() << "private FieldPacker " << FieldPackerName << ";\n";
+}
+
+bool RSReflectionJava::genResetCachedFieldPacker(
+    const RSExportType *ET, const std::string &FieldPackerName) {
   size_t AllocSize = ET->getAllocSize();
-  if (AllocSize > 0)
-    mOut.indent() << "FieldPacker " << FieldPackerName << " = new FieldPacker("
-                  << AllocSize << ");\n";
-  else
+  if (AllocSize == 0)
     return false;
+
+  mOut.indent() << "if (" << FieldPackerName << "!= null) {\n";
+  mOut.increaseIndent();
+  mOut.indent() << FieldPackerName << ".reset();\n";
+  mOut.decreaseIndent();
+  mOut.indent() << "} else {\n";
+  mOut.increaseIndent();
+  mOut.indent() << FieldPackerName << " = new FieldPacker(" << AllocSize
+                << ");\n";
+  mOut.decreaseIndent();
+  mOut.indent() << "}\n";
   return true;
 }
 
+void RSReflectionJava::genReturnIfUnchanged(const RSExportPrimitiveType *EPT,
+                                            const std::string &VarName) {
+  std::string Cached = RS_EXPORT_VAR_PREFIX + VarName;
+  // Floating-point values are compared bitwise so that, e.g., -0.0f is still
+  // sent to a script holding 0.0f.
+  switch (EPT->getType()) {
+  case DataTypeFloat32:
+    mOut.indent() << "if (Float.floatToRawIntBits(v) == "
+                     "Float.floatToRawIntBits(" << Cached << ")) return;\n";
+    break;
+  case DataTypeFloat64:
+    mOut.indent() << "if (Double.doubleToRawLongBits(v) == "
+                     "Double.doubleToRawLongBits(" << Cached << ")) return;\n";
+    break;
+  default:
+    mOut.indent() << "if (v == " << Cached << ") return;\n";
+    break;
+  }
+}
+
 void RSReflectionJava::genPackVarOfType(const RSExportType *ET,
                                         const char *VarName,
                                         const char *FieldPackerName) {
@@ -1405,26 +1919,49 @@ bool RSReflectionJava::genTypeClass(const RSExportRecordType *ERT,
 
   genTypeItemClass(ERT);
 
-  // Declare item buffer and item buffer packer
-  mOut.indent() << "private " << RS_TYPE_ITEM_CLASS_NAME << " "
-                << RS_TYPE_ITEM_BUFFER_NAME << "[];\n";
+  // Declare item buffer and item buffer packer. With packed field storage,
+  // the packer is the only copy of the data on the Java side.
+  if (!mPackedFieldStorage) {
+    mOut.indent() << "private " << RS_TYPE_ITEM_CLASS_NAME << " "
+                  << RS_TYPE_ITEM_BUFFER_NAME << "[];\n";
+  }
   mOut.indent() << "private FieldPacker " << RS_TYPE_ITEM_BUFFER_PACKER_NAME
                 << ";\n";
+  mOut.indent() << "private FieldPacker " << RS_TYPE_RANGE_BUFFER_PACKER_NAME
+                << ";\n";
+  // The items modified without copyNow, uploaded by flush()
+  mOut.indent() << "private java.util.BitSet " << RS_TYPE_DIRTY_SET_NAME
+                << ";\n";
   mOut.indent() << "private static java.lang.ref.WeakReference<Element> "
                 << RS_TYPE_ELEMENT_REF_NAME
                 << " = new java.lang.ref.WeakReference<Element>(null);\n";
 
   genTypeClassConstructor(ERT);
   genTypeClassCopyToArrayLocal(ERT);
-  genTypeClassCopyToArray(ERT);
-  genTypeClassItemSetter(ERT);
-  genTypeClassItemGetter(ERT);
-  genTypeClassComponentSetter(ERT);
-  genTypeClassComponentGetter(ERT);
-  genTypeClassCopyAll(ERT);
-  if (!mRSContext->isCompatLib()) {
-    // Skip the resize method if we are targeting a compatibility library.
-    genTypeClassResize();
+  if (mPackedFieldStorage) {
+    genPackedTypeClassItemSetter(ERT);
+    genPackedTypeClassComponentSetter(ERT);
+    genPackedTypeClassComponentGetter(ERT);
+    genTypeClassCopyRange();
+    genTypeClassFlush();
+    genPackedTypeClassCopyAll();
+    if (!mRSContext->isCompatLib()) {
+      genPackedTypeClassResize();
+    }
+    genPackedTypeClassUnpackHelpers();
+  } else {
+    genTypeClassCopyToArray(ERT);
+    genTypeClassItemSetter(ERT);
+    genTypeClassItemGetter(ERT);
+    genTypeClassComponentSetter(ERT);
+    genTypeClassComponentGetter(ERT);
+    genTypeClassCopyRange();
+    genTypeClassFlush();
+    genTypeClassCopyAll(ERT);
+    if (!mRSContext->isCompatLib()) {
+      // Skip the resize method if we are targeting a compatibility library.
+      genTypeClassResize();
+    }
   }
 
   endClass();
@@ -1435,6 +1972,141 @@ bool RSReflectionJava::genTypeClass(const RSExportRecordType *ERT,
   return true;
 }
 
+bool RSReflectionJava::genSoATypeClass(const RSExportRecordType *ERT,
+                                       std::string &ErrorMsg) {
+  std::string ClassName = RS_SOA_TYPE_CLASS_NAME_PREFIX + ERT->getName();
+  const char *RenderScriptVar = "rs";
+
+  if (!startClass(AM_Public, false, ClassName, nullptr, ErrorMsg))
+    return false;
+
+  mGeneratedFileNames->push_back(ClassName);
+
+  mOut.indent() << "private int mCount;\n";
+  for (RSExportRecordType::const_field_iterator FI = ERT->fields_begin(),
+                                                FE = ERT->fields_end();
+       FI != FE; FI++) {
+    mOut.indent() << "private Allocation " RS_SOA_FIELD_ALLOCATION_PREFIX
+                  << (*FI)->getName() << ";\n";
+  }
+
+  // Constructors
+  startFunction(AM_Public, false, nullptr, ClassName, 2, "RenderScript",
+                RenderScriptVar, "int", "count");
+  mOut.indent() << "this(" << RenderScriptVar
+                << ", count, Allocation.USAGE_SCRIPT);\n";
+  endFunction();
+
+  startFunction(AM_Public, false, nullptr, ClassName, 3, "RenderScript",
+                RenderScriptVar, "int", "count", "int", "usages");
+  mOut.indent() << "mCount = count;\n";
+  for (RSExportRecordType::const_field_iterator FI = ERT->fields_begin(),
+                                                FE = ERT->fields_end();
+       FI != FE; FI++) {
+    const RSExportRecordType::Field *F = *FI;
+    mOut.indent() << RS_SOA_FIELD_ALLOCATION_PREFIX << F->getName()
+                  << " = Allocation.createSized(" << RenderScriptVar
+                  << ", Element." << F->getType()->getElementName() << "("
+                  << RenderScriptVar << "), count, usages);\n";
+  }
+  endFunction();
+
+  startFunction(AM_Public, false, "int", "getCount", 0);
+  mOut.indent() << "return mCount;\n";
+  endFunction();
+
+  // Per-field accessors. Vector values are stored in the arrays one component
+  // after the other, with 3-component vectors padded to 4 components.
+  for (RSExportRecordType::const_field_iterator FI = ERT->fields_begin(),
+                                                FE = ERT->fields_end();
+       FI != FE; FI++) {
+    const RSExportRecordType::Field *F = *FI;
+    std::string AllocName = RS_SOA_FIELD_ALLOCATION_PREFIX + F->getName();
+    std::string ArrayTypeName =
+        std::string(GetSoAArrayTypeName(F->getType())) + "[]";
+
+    startFunction(AM_Public, false, "Allocation", "getAllocation_" +
+                  F->getName(), 0);
+    mOut.indent() << "return " << AllocName << ";\n";
+    endFunction();
+
+    // Allocation only has long[] and double[] overloads of the copy methods
+    // since L. Before, the values are uploaded through a FieldPacker, and
+    // cannot be read back.
+    DataType FieldDataType =
+        static_cast<const RSExportPrimitiveType *>(F->getType())->getType();
+    bool NeedsPacker = (mRSContext->getTargetAPI() < SLANG_L_TARGET_API) &&
+                       ((FieldDataType == DataTypeFloat64) ||
+                        (FieldDataType == DataTypeSigned64) ||
+                        (FieldDataType == DataTypeUnsigned64));
+    const char *PackerAPIName = (FieldDataType == DataTypeFloat64) ? "addF64"
+                                                                   : "addI64";
+
+    startFunction(AM_Public, false, "void", "copyFrom_" + F->getName(), 1,
+                  ArrayTypeName.c_str(), "d");
+    if (NeedsPacker) {
+      mOut.indent() << "FieldPacker fp = new FieldPacker(d.length * 8);\n";
+      mOut.indent() << "for (int ct = 0; ct < d.length; ct++) fp."
+                    << PackerAPIName << "(d[ct]);\n";
+      mOut.indent() << AllocName << ".setFromFieldPacker(0, fp);\n";
+    } else {
+      mOut.indent() << AllocName << ".copyFrom(d);\n";
+    }
+    endFunction();
+
+    if (!NeedsPacker) {
+      startFunction(AM_Public, false, "void", "copyTo_" + F->getName(), 1,
+                    ArrayTypeName.c_str(), "d");
+      mOut.indent() << AllocName << ".copyTo(d);\n";
+      endFunction();
+    }
+
+    startFunction(AM_Public, false, "void", "copyRangeFrom_" + F->getName(), 3,
+                  "int", "off", "int", "count", ArrayTypeName.c_str(), "d");
+    if (NeedsPacker) {
+      mOut.indent() << "int size = count * " << F->getType()->getAllocSize()
+                    << ";\n";
+      mOut.indent() << "FieldPacker fp = new FieldPacker(size);\n";
+      mOut.indent() << "for (int ct = 0; ct < size / 8; ct++) fp."
+                    << PackerAPIName << "(d[ct]);\n";
+      mOut.indent() << AllocName << ".setFromFieldPacker(off, fp);\n";
+    } else {
+      mOut.indent() << AllocName << ".copy1DRangeFrom(off, count, d);\n";
+    }
+    endFunction();
+  }
+
+  startFunction(AM_Public, false, "void", "destroy", 0);
+  for (RSExportRecordType::const_field_iterator FI = ERT->fields_begin(),
+                                                FE = ERT->fields_end();
+       FI != FE; FI++) {
+    mOut.indent() << RS_SOA_FIELD_ALLOCATION_PREFIX << (*FI)->getName()
+                  << ".destroy();\n";
+  }
+  endFunction();
+
+  endClass();
+
+  return true;
+}
+
+void RSReflectionJava::genSoABinding(const RSContext::SoABinding &B) {
+  std::string TypeName = RS_SOA_TYPE_CLASS_NAME_PREFIX + B.Type->getName();
+
+  // bind_<prefix>() binds the Allocation of every field to its variable
+  startFunction(AM_Public, false, "void", "bind_" + B.Prefix, 1,
+                TypeName.c_str(), "v");
+  RSExportRecordType::const_field_iterator FI = B.Type->fields_begin();
+  for (std::vector<const RSExportVar *>::const_iterator
+           I = B.FieldVars.begin(),
+           E = B.FieldVars.end();
+       I != E; I++, FI++) {
+    mOut.indent() << "bind_" << (*I)->getName() << "((v == null) ? null : v."
+                  << "getAllocation_" << (*FI)->getName() << "());\n";
+  }
+  endFunction();
+}
+
 void RSReflectionJava::genTypeItemClass(const RSExportRecordType *ERT) {
   mOut.indent() << "static public class " RS_TYPE_ITEM_CLASS_NAME;
   mOut.startBlock();
@@ -1497,7 +2169,9 @@ void RSReflectionJava::genTypeClassConstructor(const RSExportRecordType *ERT) {
   // private with element
   startFunction(AM_Private, false, nullptr, getClassName(), 1, "RenderScript",
                 RenderScriptVar);
-  mOut.indent() << RS_TYPE_ITEM_BUFFER_NAME << " = null;\n";
+  if (!mPackedFieldStorage) {
+    mOut.indent() << RS_TYPE_ITEM_BUFFER_NAME << " = null;\n";
+  }
   mOut.indent() << RS_TYPE_ITEM_BUFFER_PACKER_NAME << " = null;\n";
   mOut.indent() << "mElement = createElement(" << RenderScriptVar << ");\n";
   endFunction();
@@ -1506,7 +2180,9 @@ void RSReflectionJava::genTypeClassConstructor(const RSExportRecordType *ERT) {
   startFunction(AM_Public, false, nullptr, getClassName(), 2, "RenderScript",
                 RenderScriptVar, "int", "count");
 
-  mOut.indent() << RS_TYPE_ITEM_BUFFER_NAME << " = null;\n";
+  if (!mPackedFieldStorage) {
+    mOut.indent() << RS_TYPE_ITEM_BUFFER_NAME << " = null;\n";
+  }
   mOut.indent() << RS_TYPE_ITEM_BUFFER_PACKER_NAME << " = null;\n";
   mOut.indent() << "mElement = createElement(" << RenderScriptVar << ");\n";
   // Call init() in super class
@@ -1517,7 +2193,9 @@ void RSReflectionJava::genTypeClassConstructor(const RSExportRecordType *ERT) {
   startFunction(AM_Public, false, nullptr, getClassName(), 3, "RenderScript",
                 RenderScriptVar, "int", "count", "int", "usages");
 
-  mOut.indent() << RS_TYPE_ITEM_BUFFER_NAME << " = null;\n";
+  if (!mPackedFieldStorage) {
+    mOut.indent() << RS_TYPE_ITEM_BUFFER_NAME << " = null;\n";
+  }
   mOut.indent() << RS_TYPE_ITEM_BUFFER_PACKER_NAME << " = null;\n";
   mOut.indent() << "mElement = createElement(" << RenderScriptVar << ");\n";
   // Call init() in super class
@@ -1617,6 +2295,7 @@ void RSReflectionJava::genTypeClassItemSetter(const RSExportRecordType *ERT) {
                 "copyNow");
   genNewItemBufferIfNull(nullptr);
   mOut.indent() << RS_TYPE_ITEM_BUFFER_NAME << "[index] = i;\n";
+  mOut.indent() << "if (!copyNow) markDirty(index);\n";
 
   mOut.indent() << "if (copyNow) ";
   mOut.startBlock();
@@ -1658,6 +2337,7 @@ RSReflectionJava::genTypeClassComponentSetter(const RSExportRecordType *ERT) {
     genNewItemBufferIfNull("index");
     mOut.indent() << RS_TYPE_ITEM_BUFFER_NAME << "[index]." << F->getName()
                   << " = v;\n";
+    mOut.indent() << "if (!copyNow) markDirty(index);\n";
 
     mOut.indent() << "if (copyNow) ";
     mOut.startBlock();
@@ -1711,7 +2391,261 @@ void RSReflectionJava::genTypeClassCopyAll(const RSExportRecordType *ERT) {
                 << "[ct], ct);\n";
   mOut.indent() << "mAllocation.setFromFieldPacker(0, "
                 << RS_TYPE_ITEM_BUFFER_PACKER_NAME ");\n";
+  mOut.indent() << "if (" RS_TYPE_DIRTY_SET_NAME " != null) "
+                   RS_TYPE_DIRTY_SET_NAME ".clear();\n";
+
+  endFunction();
+}
 
+void
+RSReflectionJava::genPackedTypeClassItemSetter(const RSExportRecordType *ERT) {
+  startFunction(AM_PublicSynchronized, false, "void", "set", 3,
+                RS_TYPE_ITEM_CLASS_NAME, "i", "int", "index", "boolean",
+                "copyNow");
+  genNewItemBufferPackerIfNull();
+  mOut.indent() << RS_TYPE_ITEM_BUFFER_PACKER_NAME << ".reset(index * "
+                << mItemSizeof << ");\n";
+  mOut.indent() << "copyToArrayLocal(i, " RS_TYPE_ITEM_BUFFER_PACKER_NAME
+                   ");\n";
+  mOut.indent() << "if (copyNow) copyRange(index, 1);\n";
+  mOut.indent() << "else markDirty(index);\n";
+  endFunction();
+}
+
+void RSReflectionJava::genPackedTypeClassComponentSetter(
+    const RSExportRecordType *ERT) {
+  for (RSExportRecordType::const_field_iterator FI = ERT->fields_begin(),
+                                                FE = ERT->fields_end();
+       FI != FE; FI++) {
+    const RSExportRecordType::Field *F = *FI;
+    size_t FieldOffset = F->getOffsetInParent();
+
+    startFunction(AM_PublicSynchronized, false, "void", "set_" + F->getName(),
+                  3, "int", "index", GetTypeName(F->getType()).c_str(), "v",
+                  "boolean", "copyNow");
+    genNewItemBufferPackerIfNull();
+    if (FieldOffset > 0) {
+      mOut.indent() << RS_TYPE_ITEM_BUFFER_PACKER_NAME << ".reset(index * "
+                    << mItemSizeof << " + " << FieldOffset << ");\n";
+    } else {
+      mOut.indent() << RS_TYPE_ITEM_BUFFER_PACKER_NAME << ".reset(index * "
+                    << mItemSizeof << ");\n";
+    }
+    genPackVarOfType(F->getType(), "v", RS_TYPE_ITEM_BUFFER_PACKER_NAME);
+    mOut.indent() << "if (copyNow) copyRange(index, 1);\n";
+    mOut.indent() << "else markDirty(index);\n";
+    endFunction();
+  }
+}
+
+// Scalar fields are returned by value. Vector and matrix fields are read into
+// an object supplied by the caller so that no getter allocates. Fields of other
+// types (structs, arrays, RS objects) are write-only in this mode.
+void RSReflectionJava::genPackedTypeClassComponentGetter(
+    const RSExportRecordType *ERT) {
+  for (RSExportRecordType::const_field_iterator FI = ERT->fields_begin(),
+                                                FE = ERT->fields_end();
+       FI != FE; FI++) {
+    const RSExportRecordType::Field *F = *FI;
+    const RSExportType *ET = F->getType();
+    std::string Offset = "index * " + mItemSizeof;
+    if (F->getOffsetInParent() > 0) {
+      Offset += " + " + llvm::utostr_32(F->getOffsetInParent());
+    }
+
+    switch (ET->getClass()) {
+    case RSExportType::ExportClassPrimitive: {
+      const RSExportPrimitiveType *EPT =
+          static_cast<const RSExportPrimitiveType *>(ET);
+      std::string Value = GetUnpackExpr(EPT->getType(), "o");
+      if (EPT->isRSObjectType() || Value.empty())
+        break;
+
+      startFunction(AM_PublicSynchronized, false, GetTypeName(ET).c_str(),
+                    "get_" + F->getName(), 1, "int", "index");
+      mOut.indent() << "if (" RS_TYPE_ITEM_BUFFER_PACKER_NAME " == null) return "
+                    << GetTypeNullValue(ET) << ";\n";
+      mOut.indent() << "byte[] d = " RS_TYPE_ITEM_BUFFER_PACKER_NAME
+                       ".getData();\n";
+      mOut.indent() << "int o = " << Offset << ";\n";
+      mOut.indent() << "return " << Value << ";\n";
+      endFunction();
+      break;
+    }
+    case RSExportType::ExportClassVector: {
+      const RSExportVectorType *EVT =
+          static_cast<const RSExportVectorType *>(ET);
+      unsigned ComponentSize = RSExportPrimitiveType::GetSizeInBits(EVT) / 8;
+      if (GetUnpackExpr(EVT->getType(), "o").empty())
+        break;
+
+      startFunction(AM_PublicSynchronized, false, "void",
+                    "get_" + F->getName(), 2, "int", "index",
+                    GetTypeName(ET).c_str(), "out");
+      mOut.indent() << "if (" RS_TYPE_ITEM_BUFFER_PACKER_NAME
+                       " == null) return;\n";
+      mOut.indent() << "byte[] d = " RS_TYPE_ITEM_BUFFER_PACKER_NAME
+                       ".getData();\n";
+      mOut.indent() << "int o = " << Offset << ";\n";
+      for (unsigned i = 0; i < EVT->getNumElement(); i++) {
+        std::string ComponentOffset = "o";
+        if (i > 0) {
+          ComponentOffset += " + " + llvm::utostr_32(i * ComponentSize);
+        }
+        mOut.indent() << "out." << GetVectorAccessor(i) << " = "
+                      << GetUnpackExpr(EVT->getType(), ComponentOffset)
+                      << ";\n";
+      }
+      endFunction();
+      break;
+    }
+    case RSExportType::ExportClassMatrix: {
+      const RSExportMatrixType *EMT =
+          static_cast<const RSExportMatrixType *>(ET);
+      unsigned Count = EMT->getDim() * EMT->getDim();
+
+      startFunction(AM_PublicSynchronized, false, "void",
+                    "get_" + F->getName(), 2, "int", "index",
+                    GetTypeName(ET).c_str(), "out");
+      mOut.indent() << "if (" RS_TYPE_ITEM_BUFFER_PACKER_NAME
+                       " == null) return;\n";
+      mOut.indent() << "byte[] d = " RS_TYPE_ITEM_BUFFER_PACKER_NAME
+                       ".getData();\n";
+      mOut.indent() << "int o = " << Offset << ";\n";
+      mOut.indent() << "float[] m = out.getArray();\n";
+      mOut.indent() << "for (int ct = 0; ct < " << Count << "; ct++) "
+                    << "m[ct] = " << GetUnpackExpr(DataTypeFloat32, "o + ct * 4")
+                    << ";\n";
+      endFunction();
+      break;
+    }
+    default:
+      break;
+    }
+  }
+}
+
+// Uploads the items [start, start + count) with a single setFromFieldPacker().
+void RSReflectionJava::genTypeClassCopyRange() {
+  // On targets that upload FieldPacker.getPos() bytes from
+  // setFromFieldPacker() (API 21+ and the compatibility library), the position
+  // of the packers must be moved to the end of the range being uploaded.
+  bool UploadsToPos =
+      (mRSContext->getTargetAPI() >= 21) || mRSContext->isCompatLib();
+
+  startFunction(AM_PublicSynchronized, false, "void", "copyRange", 2, "int",
+                "start", "int", "count");
+  if (!mPackedFieldStorage) {
+    // Pack the items first; they may have been modified without copyNow.
+    mOut.indent() << "if (" RS_TYPE_ITEM_BUFFER_NAME " == null) return;\n";
+    mOut.indent() << "for (int ct = start; ct < start + count; ct++) ";
+    mOut << "if (" RS_TYPE_ITEM_BUFFER_NAME "[ct] != null) copyToArray("
+            RS_TYPE_ITEM_BUFFER_NAME "[ct], ct);\n";
+  }
+  mOut.indent() << "if (" RS_TYPE_ITEM_BUFFER_PACKER_NAME " == null) return;\n";
+  mOut.indent() << "int size = count * " << mItemSizeof << ";\n";
+
+  // The whole buffer is uploaded without copying.
+  mOut.indent() << "if ((start == 0) && (size == " RS_TYPE_ITEM_BUFFER_PACKER_NAME
+                   ".getData().length)) ";
+  mOut.startBlock();
+  if (UploadsToPos) {
+    mOut.indent() << RS_TYPE_ITEM_BUFFER_PACKER_NAME ".reset(size);\n";
+  }
+  mOut.indent() << "mAllocation.setFromFieldPacker(0, "
+                   RS_TYPE_ITEM_BUFFER_PACKER_NAME ");\n";
+  mOut.indent() << "return;\n";
+  mOut.endBlock();
+
+  // Otherwise the range is staged in a packer that is reused for as long as
+  // the ranges keep the same size.
+  mOut.indent() << "if ((" RS_TYPE_RANGE_BUFFER_PACKER_NAME " == null) || ("
+                   RS_TYPE_RANGE_BUFFER_PACKER_NAME ".getData().length != size)) "
+                << RS_TYPE_RANGE_BUFFER_PACKER_NAME " = new FieldPacker(size);\n";
+  mOut.indent() << "System.arraycopy(" RS_TYPE_ITEM_BUFFER_PACKER_NAME
+                   ".getData(), start * " << mItemSizeof << ", "
+                   RS_TYPE_RANGE_BUFFER_PACKER_NAME ".getData(), 0, size);\n";
+  if (UploadsToPos) {
+    mOut.indent() << RS_TYPE_RANGE_BUFFER_PACKER_NAME ".reset(size);\n";
+  }
+  mOut.indent() << "mAllocation.setFromFieldPacker(start, "
+                   RS_TYPE_RANGE_BUFFER_PACKER_NAME ");\n";
+  endFunction();
+}
+
+void RSReflectionJava::genTypeClassFlush() {
+  startFunction(AM_Private, false, "void", "markDirty", 1, "int", "index");
+  mOut.indent() << "if (" RS_TYPE_DIRTY_SET_NAME " == null) "
+                   RS_TYPE_DIRTY_SET_NAME " = new java.util.BitSet(getType()"
+                   ".getX() /* count */);\n";
+  mOut.indent() << RS_TYPE_DIRTY_SET_NAME ".set(index);\n";
+  endFunction();
+
+  // flush() uploads each run of consecutive modified items with one call.
+  startFunction(AM_PublicSynchronized, false, "void", "flush", 0);
+  mOut.indent() << "if (" RS_TYPE_DIRTY_SET_NAME " == null) return;\n";
+  mOut.indent() << "for (int start = " RS_TYPE_DIRTY_SET_NAME
+                   ".nextSetBit(0); start >= 0; )";
+  mOut.startBlock();
+  mOut.indent() << "int end = " RS_TYPE_DIRTY_SET_NAME
+                   ".nextClearBit(start);\n";
+  mOut.indent() << "copyRange(start, end - start);\n";
+  mOut.indent() << "start = " RS_TYPE_DIRTY_SET_NAME ".nextSetBit(end);\n";
+  mOut.endBlock();
+  mOut.indent() << RS_TYPE_DIRTY_SET_NAME ".clear();\n";
+  endFunction();
+}
+
+void RSReflectionJava::genPackedTypeClassCopyAll() {
+  startFunction(AM_PublicSynchronized, false, "void", "copyAll", 0);
+  mOut.indent() << "copyRange(0, getType().getX() /* count */);\n";
+  mOut.indent() << "if (" RS_TYPE_DIRTY_SET_NAME " != null) "
+                   RS_TYPE_DIRTY_SET_NAME ".clear();\n";
+  endFunction();
+}
+
+void RSReflectionJava::genPackedTypeClassResize() {
+  startFunction(AM_PublicSynchronized, false, "void", "resize", 1, "int",
+                "newSize");
+
+  mOut.indent() << "if (" RS_TYPE_ITEM_BUFFER_PACKER_NAME " != null) ";
+  mOut.startBlock();
+  mOut.indent() << "int oldSize = " RS_TYPE_ITEM_BUFFER_PACKER_NAME
+                   ".getData().length / " << mItemSizeof << ";\n";
+  mOut.indent() << "int copySize = Math.min(oldSize, newSize);\n";
+  mOut.indent() << "if (newSize == oldSize) return;\n";
+  mOut.indent() << "FieldPacker nb = new FieldPacker(" << mItemSizeof
+                << " * newSize);\n";
+  mOut.indent() << "System.arraycopy(" RS_TYPE_ITEM_BUFFER_PACKER_NAME
+                   ".getData(), 0, nb.getData(), 0, copySize * "
+                << mItemSizeof << ");\n";
+  mOut.indent() << RS_TYPE_ITEM_BUFFER_PACKER_NAME " = nb;\n";
+  mOut.endBlock();
+  mOut.indent() << RS_TYPE_RANGE_BUFFER_PACKER_NAME " = null;\n";
+  mOut.indent() << "if (" RS_TYPE_DIRTY_SET_NAME " != null) "
+                   RS_TYPE_DIRTY_SET_NAME ".clear(newSize, Math.max(newSize, "
+                   RS_TYPE_DIRTY_SET_NAME ".length()));\n";
+  mOut.indent() << "mAllocation.resize(newSize);\n";
+
+  endFunction();
+}
+
+void RSReflectionJava::genPackedTypeClassUnpackHelpers() {
+  startFunction(AM_Private, true, "short", "unpackI16", 2, "byte[]", "d", "int",
+                "o");
+  mOut.indent() << "return (short) ((d[o] & 0xff) | (d[o + 1] << 8));\n";
+  endFunction();
+
+  startFunction(AM_Private, true, "int", "unpackI32", 2, "byte[]", "d", "int",
+                "o");
+  mOut.indent() << "return (d[o] & 0xff) | ((d[o + 1] & 0xff) << 8) | "
+                   "((d[o + 2] & 0xff) << 16) | (d[o + 3] << 24);\n";
+  endFunction();
+
+  startFunction(AM_Private, true, "long", "unpackI64", 2, "byte[]", "d", "int",
+                "o");
+  mOut.indent() << "return (unpackI32(d, o) & 0xffffffffL) | "
+                   "((long) unpackI32(d, o + 4) << 32);\n";
   endFunction();
 }
 
@@ -1728,6 +2662,9 @@ void RSReflectionJava::genTypeClassResize() {
   mOut.indent() << "System.arraycopy(mItemArray, 0, ni, 0, copySize);\n";
   mOut.indent() << "mItemArray = ni;\n";
   mOut.endBlock();
+  mOut.indent() << "if (" RS_TYPE_DIRTY_SET_NAME " != null) "
+                   RS_TYPE_DIRTY_SET_NAME ".clear(newSize, Math.max(newSize, "
+                   RS_TYPE_DIRTY_SET_NAME ".length()));\n";
   mOut.indent() << "mAllocation.resize(newSize);\n";
 
   mOut.indent() << "if (" RS_TYPE_ITEM_BUFFER_PACKER_NAME
@@ -1939,8 +2876,8 @@ RSReflectionJavaElementBuilder::genAddStatementEnd(const std::string &VarName,
 bool RSReflectionJava::reflect() {
   std::string ErrorMsg;
   if (!genScriptClass(mScriptClassName, ErrorMsg)) {
-    std::cerr << "Failed to generate class " << mScriptClassName << " ("
-              << ErrorMsg << ")\n";
+    mMessages->err() << "Failed to generate class " << mScriptClassName
+                     << " (" << ErrorMsg << ")\n";
     return false;
   }
 
@@ -1958,16 +2895,55 @@ bool RSReflectionJava::reflect() {
           static_cast<const RSExportRecordType *>(ET);
 
       if (!ERT->isArtificial() && !genTypeClass(ERT, ErrorMsg)) {
-        std::cerr << "Failed to generate type class for struct '"
-                  << ERT->getName() << "' (" << ErrorMsg << ")\n";
+        mMessages->err() << "Failed to generate type class for struct '"
+                         << ERT->getName() << "' (" << ErrorMsg << ")\n";
         return false;
       }
     }
   }
 
+  // class ScriptFieldSoA_<TypeName>
+  for (RSContext::const_export_soa_type_iterator
+           TI = mRSContext->export_soa_types_begin(),
+           TE = mRSContext->export_soa_types_end();
+       TI != TE; TI++) {
+    if (!genSoATypeClass(*TI, ErrorMsg)) {
+      mMessages->err()
+          << "Failed to generate structure-of-arrays class for struct '"
+          << (*TI)->getName() << "' (" << ErrorMsg << ")\n";
+      return false;
+    }
+  }
+
   return true;
 }
 
+void RSReflectionJava::GetGeneratedClassNames(
+    const RSContext *Context, const std::string &RSSourceFileName,
+    std::vector<std::string> *Names) {
+  Names->push_back(RS_SCRIPT_CLASS_NAME_PREFIX +
+                   RSSlangReflectUtils::JavaClassNameFromRSFileName(
+                       RSSourceFileName.c_str()));
+
+  for (RSContext::const_export_type_iterator
+           TI = Context->export_types_begin(),
+           TE = Context->export_types_end();
+       TI != TE; TI++) {
+    const RSExportType *ET = TI->getValue();
+    if ((ET->getClass() == RSExportType::ExportClassRecord) &&
+        !static_cast<const RSExportRecordType *>(ET)->isArtificial()) {
+      Names->push_back(ET->getElementName());
+    }
+  }
+
+  for (RSContext::const_export_soa_type_iterator
+           TI = Context->export_soa_types_begin(),
+           TE = Context->export_soa_types_end();
+       TI != TE; TI++) {
+    Names->push_back(RS_SOA_TYPE_CLASS_NAME_PREFIX + (*TI)->getName());
+  }
+}
+
 const char *RSReflectionJava::AccessModifierStr(AccessModifier AM) {
   switch (AM) {
   case AM_Public:
@@ -1996,7 +2972,7 @@ bool RSReflectionJava::startClass(AccessModifier AM, bool IsStatic,
   std::string FileName = ClassName + ".java";
   if (!mOut.startFile(mOutputDirectory, FileName, mRSSourceFileName,
                       mRSContext->getLicenseNote(), true,
-                      mRSContext->getVerbose())) {
+                      mRSContext->getVerbose(), mMessages)) {
     return false;
   }
 
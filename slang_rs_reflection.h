@@ -27,20 +27,24 @@
 #include "llvm/ADT/StringExtras.h"
 
 #include "slang_assert.h"
+#include "slang_rs_context.h"
 #include "slang_rs_export_type.h"
 #include "slang_rs_reflect_utils.h"
 
 namespace slang {
 
-class RSContext;
 class RSExportVar;
 class RSExportFunc;
 class RSExportForEach;
+class RSExportReduce;
 
 class RSReflectionJava {
 private:
   const RSContext *mRSContext;
 
+  // Where the messages of the reflection are reported
+  ReflectionMessages *mMessages;
+
   // The name of the Java package name we're creating this file for,
   // e.g. com.example.android.rs.flashlight
   std::string mPackageName;
@@ -78,9 +82,19 @@ private:
 
   bool mEmbedBitcodeInJava;
 
+  // Back the ScriptField_* classes with a packed buffer instead of Items.
+  bool mPackedFieldStorage;
+
+  // Return early from scalar setters called with the last value set.
+  bool mElideRedundantSet;
+
+  // The bitcode (raw resource or embedded) is compressed with zlib.
+  bool mCompressBitcode;
+
   int mNextExportVarSlot;
   int mNextExportFuncSlot;
   int mNextExportForEachSlot;
+  int mNextExportReduceSlot;
 
   GeneratedFile mOut;
 
@@ -101,6 +115,7 @@ private:
     mNextExportVarSlot = 0;
     mNextExportFuncSlot = 0;
     mNextExportForEachSlot = 0;
+    mNextExportReduceSlot = 0;
   }
 
 public:
@@ -127,6 +142,7 @@ public:
   inline int getNextExportVarSlot() { return mNextExportVarSlot++; }
   inline int getNextExportFuncSlot() { return mNextExportFuncSlot++; }
   inline int getNextExportForEachSlot() { return mNextExportForEachSlot++; }
+  inline int getNextExportReduceSlot() { return mNextExportReduceSlot++; }
 
   bool startClass(AccessModifier AM, bool IsStatic,
                   const std::string &ClassName, const char *SuperClassName,
@@ -171,6 +187,7 @@ public:
 private:
   bool genScriptClass(const std::string &ClassName, std::string &ErrorMsg);
   void genScriptClassConstructor();
+  void genInflateBitCodeResource();
 
   void genInitBoolExportVariable(const std::string &VarName,
                                  const clang::APValue &Val);
@@ -192,10 +209,23 @@ private:
   void genGetExportVariable(const std::string &TypeName,
                             const std::string &VarName);
   void genGetFieldID(const std::string &VarName);
+  // specialize() and the check that keeps the setters of the specialized
+  // variables from being called after it.
+  void genSpecialize();
+  void genSpecializedCheck(const std::string &VarName);
 
   void genExportFunction(const RSExportFunc *EF);
+  void genExportFunctionBatch(const RSExportFunc *EF);
 
   void genExportForEach(const RSExportForEach *EF);
+  // Type and dimension checks of the allocations passed to forEach_*().
+  void genForEachChecks(const RSExportForEach *EF);
+  // The input allocation(s) argument of Script.forEach().
+  void genForEachInputs(const RSExportForEach *EF);
+  // prepare_*() and the launch handle class it returns.
+  void genExportForEachLaunch(const RSExportForEach *EF, const ArgTy &Args);
+
+  void genExportReduce(const RSExportReduce *ER);
 
   void genTypeCheck(const RSExportType *ET, const char *VarName);
 
@@ -216,6 +246,18 @@ private:
   void genTypeClassComponentGetter(const RSExportRecordType *ERT);
   void genTypeClassCopyAll(const RSExportRecordType *ERT);
   void genTypeClassResize();
+  void genTypeClassCopyRange();
+  void genTypeClassFlush();
+
+  void genPackedTypeClassItemSetter(const RSExportRecordType *ERT);
+  void genPackedTypeClassComponentSetter(const RSExportRecordType *ERT);
+  void genPackedTypeClassComponentGetter(const RSExportRecordType *ERT);
+  void genPackedTypeClassCopyAll();
+  void genPackedTypeClassResize();
+  void genPackedTypeClassUnpackHelpers();
+
+  bool genSoATypeClass(const RSExportRecordType *ERT, std::string &ErrorMsg);
+  void genSoABinding(const RSContext::SoABinding &B);
 
   void genBuildElement(const char *ElementBuilderName,
                        const RSExportRecordType *ERT,
@@ -226,7 +268,11 @@ private:
                                      const char *RenderScriptVar,
                                      unsigned ArraySize);
 
-  bool genCreateFieldPacker(const RSExportType *T, const char *FieldPackerName);
+  void genCachedFieldPackerDecl(const std::string &FieldPackerName);
+  bool genResetCachedFieldPacker(const RSExportType *T,
+                                 const std::string &FieldPackerName);
+  void genReturnIfUnchanged(const RSExportPrimitiveType *EPT,
+                            const std::string &VarName);
   void genPackVarOfType(const RSExportType *T, const char *VarName,
                         const char *FieldPackerName);
   void genAllocateVarOfType(const RSExportType *T, const std::string &VarName);
@@ -237,14 +283,24 @@ private:
 
 public:
   RSReflectionJava(const RSContext *Context,
+                   ReflectionMessages *Messages,
                    std::vector<std::string> *GeneratedFileNames,
                    const std::string &OutputBaseDirectory,
                    const std::string &RSSourceFilename,
                    const std::string &BitCodeFileName,
-                   bool EmbedBitcodeInJava);
+                   bool EmbedBitcodeInJava,
+                   bool PackedFieldStorage,
+                   bool ElideRedundantSet,
+                   bool CompressBitcode);
 
   bool reflect();
 
+  // Append to Names the names of the classes reflect() generates for the
+  // script RSSourceFileName, in the same order, without generating them.
+  static void GetGeneratedClassNames(const RSContext *Context,
+                                     const std::string &RSSourceFileName,
+                                     std::vector<std::string> *Names);
+
   inline const char *getLastError() const {
     if (mLastError.empty())
       return nullptr;
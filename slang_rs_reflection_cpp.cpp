@@ -23,15 +23,24 @@
 #include <cctype>
 
 #include <algorithm>
+#include <fstream>
 #include <sstream>
 #include <string>
+#include <system_error>
 #include <utility>
 
+#include "llvm/ADT/SmallString.h"
+#include "llvm/ADT/StringExtras.h"
+#include "llvm/ADT/StringRef.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/Path.h"
+
 #include "os_sep.h"
 #include "slang_rs_context.h"
 #include "slang_rs_export_var.h"
 #include "slang_rs_export_foreach.h"
 #include "slang_rs_export_func.h"
+#include "slang_rs_export_reduce.h"
 #include "slang_rs_reflect_utils.h"
 #include "slang_version.h"
 #include "slang_utils.h"
@@ -46,6 +55,10 @@ namespace slang {
 
 #define RS_ELEM_PREFIX "__rs_elem_"
 
+#define RS_SOA_TYPE_CLASS_NAME_PREFIX "ScriptFieldSoA_"
+#define RS_SPECIALIZED_NAME "mSpecialized"
+#define RS_SOA_FIELD_ALLOCATION_PREFIX "mAlloc_"
+
 static const char *GetMatrixTypeName(const RSExportMatrixType *EMT) {
   static const char *MatrixTypeCNameMap[] = {
       "rs_matrix2x2", "rs_matrix3x3", "rs_matrix4x4",
@@ -72,13 +85,9 @@ static std::string GetTypeName(const RSExportType *ET, bool Brackets = true) {
     }
   }
   case RSExportType::ExportClassPointer: {
-    const RSExportType *PointeeType =
-        static_cast<const RSExportPointerType *>(ET)->getPointeeType();
-
-    if (PointeeType->getClass() != RSExportType::ExportClassRecord)
-      return "android::RSC::sp<android::RSC::Allocation>";
-    else
-      return PointeeType->getElementName();
+    // Pointers to records can also be bound from their ScriptField_ wrapper,
+    // see genPointerTypeExportVariable().
+    return "android::RSC::sp<android::RSC::Allocation>";
   }
   case RSExportType::ExportClassVector: {
     const RSExportVectorType *EVT = static_cast<const RSExportVectorType *>(ET);
@@ -101,8 +110,7 @@ static std::string GetTypeName(const RSExportType *ET, bool Brackets = true) {
     return ElementTypeName;
   }
   case RSExportType::ExportClassRecord: {
-    // TODO: Fix for C structs!
-    return ET->getElementName() + "." RS_TYPE_ITEM_CLASS_NAME;
+    return ET->getElementName() + "::" RS_TYPE_ITEM_CLASS_NAME;
   }
   default: { slangAssert(false && "Unknown class of type"); }
   }
@@ -110,22 +118,177 @@ static std::string GetTypeName(const RSExportType *ET, bool Brackets = true) {
   return "";
 }
 
+// Whether a value of type @ET can't be written directly from native code.
+// RS object handles and pointers have a runtime-specific representation, so
+// they are reserved as raw bytes in the reflected structures.
+static bool IsOpaqueInItem(const RSExportType *ET) {
+  switch (ET->getClass()) {
+  case RSExportType::ExportClassPointer:
+    return true;
+  case RSExportType::ExportClassPrimitive:
+    return static_cast<const RSExportPrimitiveType *>(ET)->isRSObjectType();
+  default:
+    return false;
+  }
+}
+
+// Whether a value of type @ET holds any opaque data (see IsOpaqueInItem()).
+// Such values can't be sent to the script as raw bytes.
+static bool HasOpaqueData(const RSExportType *ET) {
+  if (ET->getClass() == RSExportType::ExportClassConstantArray) {
+    return HasOpaqueData(
+        static_cast<const RSExportConstantArrayType *>(ET)->getElementType());
+  }
+  if (ET->getClass() == RSExportType::ExportClassRecord) {
+    const RSExportRecordType *ERT = static_cast<const RSExportRecordType *>(ET);
+    for (RSExportRecordType::const_field_iterator I = ERT->fields_begin(),
+                                                  E = ERT->fields_end();
+         I != E; I++) {
+      if (HasOpaqueData((*I)->getType())) {
+        return true;
+      }
+    }
+    return false;
+  }
+  return IsOpaqueInItem(ET);
+}
+
+// Returns the declaration of a member @Name of type @ET in a reflected
+// structure, e.g. "float4 v" or "int32_t a[4][2]".
+static std::string GetItemFieldDeclaration(const RSExportType *ET,
+                                           const std::string &Name) {
+  std::stringstream Decl;
+  if (ET->getClass() == RSExportType::ExportClassConstantArray) {
+    const RSExportConstantArrayType *ECAT =
+        static_cast<const RSExportConstantArrayType *>(ET);
+    Decl << Name << "[" << ECAT->getSize() << "]";
+    return GetItemFieldDeclaration(ECAT->getElementType(), Decl.str());
+  }
+
+  if (IsOpaqueInItem(ET)) {
+    Decl << "uint8_t " << Name << "[" << ET->getAllocSize() << "]";
+  } else {
+    Decl << GetTypeName(ET) << " " << Name;
+  }
+  return Decl.str();
+}
+
+// Returns the expression creating the Element of a value of type @ET (the
+// element type for arrays), using @RenderScriptVar as the context.
+static std::string GetElementConstruct(const RSExportType *ET,
+                                       const char *RenderScriptVar) {
+  std::string Construct;
+  switch (ET->getClass()) {
+  case RSExportType::ExportClassConstantArray: {
+    return GetElementConstruct(
+        static_cast<const RSExportConstantArrayType *>(ET)->getElementType(),
+        RenderScriptVar);
+  }
+  case RSExportType::ExportClassRecord: {
+    Construct = ET->getElementName() + "::createElement";
+    break;
+  }
+  case RSExportType::ExportClassPointer: {
+    Construct = "android::RSC::Element::ALLOCATION";
+    break;
+  }
+  case RSExportType::ExportClassMatrix: {
+    std::stringstream Name;
+    unsigned Dim = static_cast<const RSExportMatrixType *>(ET)->getDim();
+    Name << "android::RSC::Element::MATRIX_" << Dim << "X" << Dim;
+    Construct = Name.str();
+    break;
+  }
+  default: {
+    Construct = "android::RSC::Element::" + ET->getElementName();
+    break;
+  }
+  }
+  return Construct + "(" + RenderScriptVar + ")";
+}
+
+// Returns the total number of elements of a (possibly multi-dimensional)
+// constant array, or 0 if @ET is not an array.
+static size_t GetFlattenedArraySize(const RSExportType *ET) {
+  size_t Size = 0;
+  while (ET->getClass() == RSExportType::ExportClassConstantArray) {
+    const RSExportConstantArrayType *ECAT =
+        static_cast<const RSExportConstantArrayType *>(ET);
+    Size = (Size ? Size : 1) * ECAT->getSize();
+    ET = ECAT->getElementType();
+  }
+  return Size;
+}
+
+// Returns the absolute path @Path relative to the absolute directory @Dir.
+static std::string GetRelativePath(llvm::StringRef Path, llvm::StringRef Dir) {
+  llvm::sys::path::const_iterator PI = llvm::sys::path::begin(Path),
+                                  PE = llvm::sys::path::end(Path),
+                                  DI = llvm::sys::path::begin(Dir),
+                                  DE = llvm::sys::path::end(Dir);
+  while ((PI != PE) && (DI != DE) && (*PI == *DI)) {
+    PI++;
+    DI++;
+  }
+
+  llvm::SmallString<256> Relative;
+  for (; DI != DE; DI++) {
+    // A trailing separator shows up as a "." component.
+    if (*DI != ".") {
+      llvm::sys::path::append(Relative, "..");
+    }
+  }
+  for (; PI != PE; PI++) {
+    llvm::sys::path::append(Relative, *PI);
+  }
+  return Relative.str();
+}
+
 RSReflectionCpp::RSReflectionCpp(const RSContext *Context,
+                                 ReflectionMessages *Messages,
                                  const string &OutputDirectory,
                                  const string &RSSourceFileName,
-                                 const string &BitCodeFileName)
-    : mRSContext(Context), mRSSourceFilePath(RSSourceFileName),
-      mBitCodeFilePath(BitCodeFileName), mOutputDirectory(OutputDirectory),
+                                 const string &BitCodeFileName,
+                                 bool EmbedBitcodeWithIncbin,
+                                 bool CompressBitcode)
+    : mRSContext(Context), mMessages(Messages),
+      mRSSourceFilePath(RSSourceFileName),
+      mBitCodeFilePath(BitCodeFileName),
+      mEmbedBitcodeWithIncbin(EmbedBitcodeWithIncbin),
+      mCompressBitcode(CompressBitcode),
+      mOutputDirectory(OutputDirectory),
       mNextExportVarSlot(0), mNextExportFuncSlot(0), mNextExportForEachSlot(0) {
   mCleanedRSFileName = RootNameFromRSFileName(mRSSourceFilePath);
   mClassName = "ScriptC_" + mCleanedRSFileName;
+  mBitCode.uncompressedSize = 0;
+  mBitCode.compressed = false;
 }
 
 RSReflectionCpp::~RSReflectionCpp() {}
 
+std::string RSReflectionCpp::GetBitCodeAssemblyFilePath(
+    const std::string &OutputDirectory, const std::string &RSSourceFileName) {
+  return JoinPath(OutputDirectory, "ScriptC_" +
+                  RootNameFromRSFileName(RSSourceFileName) + "_bitcode.S");
+}
+
 bool RSReflectionCpp::reflect() {
+  if ((!mEmbedBitcodeWithIncbin || mCompressBitcode) &&
+      !RSSlangReflectUtils::ReadBitCodePayload(mBitCodeFilePath,
+                                               mCompressBitcode,
+                                               mRSContext->getVerbose(),
+                                               &mBitCode, mMessages)) {
+    return false;
+  }
+
+  if (!writeRecordTypeHeaders()) {
+    return false;
+  }
   writeHeaderFile();
   writeImplementationFile();
+  if (mEmbedBitcodeWithIncbin && !genBitCodeAssemblyFile()) {
+    return false;
+  }
 
   return true;
 }
@@ -136,11 +299,26 @@ bool RSReflectionCpp::writeHeaderFile() {
   // Create the file and write the license note.
   if (!mOut.startFile(mOutputDirectory, mClassName + ".h", mRSSourceFilePath,
                       mRSContext->getLicenseNote(), false,
-                      mRSContext->getVerbose())) {
+                      mRSContext->getVerbose(), mMessages)) {
     return false;
   }
 
   mOut.indent() << "#include \"RenderScript.h\"\n\n";
+  // Multi-input kernels and reduction kernels take a vector of allocations.
+  bool NeedsVector = mRSContext->hasExportReduce();
+  for (RSContext::const_export_foreach_iterator
+           I = mRSContext->export_foreach_begin(),
+           E = mRSContext->export_foreach_end();
+       I != E; I++) {
+    if ((*I)->getIns().size() > 1) {
+      NeedsVector = true;
+      break;
+    }
+  }
+  if (NeedsVector) {
+    mOut.indent() << "#include <vector>\n\n";
+  }
+  genRecordTypeIncludes();
   mOut.indent() << "using namespace android::RSC;\n\n";
 
   mOut.comment("This class encapsulates access to the exported elements of the script.  "
@@ -156,6 +334,7 @@ bool RSReflectionCpp::writeHeaderFile() {
 
   genFieldsToStoreExportVariableValues();
   genTypeInstancesUsedInForEach();
+  genTypeInstancesUsedInReduce();
   genFieldsForAllocationTypeVerification();
 
   mOut.decreaseIndent();
@@ -167,7 +346,12 @@ bool RSReflectionCpp::writeHeaderFile() {
   mOut.indent() << "virtual ~" << mClassName << "();\n\n";
 
   genExportVariablesGetterAndSetter();
+  genSoABindings();
+  if (mRSContext->hasSpecializedExportVar()) {
+    genSpecialize();
+  }
   genForEachDeclarations();
+  genReduceDeclarations();
   genExportFunctionDeclarations();
 
   mOut.endBlock(true);
@@ -175,6 +359,344 @@ bool RSReflectionCpp::writeHeaderFile() {
   return true;
 }
 
+bool RSReflectionCpp::writeRecordTypeHeaders() {
+  for (RSContext::const_export_type_iterator
+           I = mRSContext->export_types_begin(),
+           E = mRSContext->export_types_end();
+       I != E; I++) {
+    const RSExportType *ET = I->getValue();
+    if ((ET->getClass() == RSExportType::ExportClassRecord) &&
+        !writeRecordTypeHeader(static_cast<const RSExportRecordType *>(ET))) {
+      return false;
+    }
+  }
+  for (RSContext::const_export_soa_type_iterator
+           I = mRSContext->export_soa_types_begin(),
+           E = mRSContext->export_soa_types_end();
+       I != E; I++) {
+    if (!writeSoATypeHeader(*I)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+void RSReflectionCpp::genRecordTypeIncludes() {
+  bool Included = false;
+  for (RSContext::const_export_type_iterator
+           I = mRSContext->export_types_begin(),
+           E = mRSContext->export_types_end();
+       I != E; I++) {
+    const RSExportType *ET = I->getValue();
+    if (ET->getClass() == RSExportType::ExportClassRecord) {
+      mOut.indent() << "#include \"" << ET->getElementName() << ".h\"\n";
+      Included = true;
+    }
+  }
+  for (RSContext::const_export_soa_type_iterator
+           I = mRSContext->export_soa_types_begin(),
+           E = mRSContext->export_soa_types_end();
+       I != E; I++) {
+    mOut.indent() << "#include \"" RS_SOA_TYPE_CLASS_NAME_PREFIX
+                  << (*I)->getName() << ".h\"\n";
+    Included = true;
+  }
+  if (Included) {
+    mOut << "\n";
+  }
+}
+
+bool RSReflectionCpp::writeRecordTypeHeader(const RSExportRecordType *ERT) {
+  std::string ClassName = ERT->getElementName();
+
+  if (!mOut.startFile(mOutputDirectory, ClassName + ".h", mRSSourceFilePath,
+                      mRSContext->getLicenseNote(), false,
+                      mRSContext->getVerbose(), mMessages)) {
+    return false;
+  }
+
+  // The same record type may be reflected by several scripts of a package.
+  std::string Guard = "RS_" + ClassName + "_H";
+  std::transform(Guard.begin(), Guard.end(), Guard.begin(), ::toupper);
+  mOut.indent() << "#ifndef " << Guard << "\n";
+  mOut.indent() << "#define " << Guard << "\n\n";
+
+  mOut.indent() << "#include <stddef.h>\n\n";
+  mOut.indent() << "#include \"RenderScript.h\"\n";
+
+  // The headers of the records that are nested in this one.
+  std::set<std::string> Nested;
+  for (RSExportRecordType::const_field_iterator FI = ERT->fields_begin(),
+                                                FE = ERT->fields_end();
+       FI != FE; FI++) {
+    const RSExportType *T = (*FI)->getType();
+    while (T->getClass() == RSExportType::ExportClassConstantArray) {
+      T = static_cast<const RSExportConstantArrayType *>(T)->getElementType();
+    }
+    if ((T->getClass() == RSExportType::ExportClassRecord) &&
+        Nested.insert(T->getElementName()).second) {
+      mOut.indent() << "#include \"" << T->getElementName() << ".h\"\n";
+    }
+  }
+  mOut << "\n";
+
+  mOut.comment("Typed storage of struct " + ERT->getName() + ".  " +
+               RS_TYPE_ITEM_CLASS_NAME " has exactly the layout the script "
+               "uses, so arrays of items are copied to and from the "
+               "Allocation as is, without going through a FieldPacker.  "
+               "Fields holding RS objects or pointers are left opaque.");
+  mOut.indent() << "class " << ClassName;
+  mOut.startBlock();
+
+  mOut.decreaseIndent();
+  mOut.indent() << "public:\n";
+  mOut.increaseIndent();
+
+  mOut.indent() << "struct " RS_TYPE_ITEM_CLASS_NAME;
+  mOut.startBlock();
+  size_t Pos = 0;
+  unsigned PaddingIndex = 0;
+  for (RSExportRecordType::const_field_iterator FI = ERT->fields_begin(),
+                                                FE = ERT->fields_end();
+       FI != FE; FI++) {
+    const RSExportRecordType::Field *F = *FI;
+    size_t FieldOffset = F->getOffsetInParent();
+    if (FieldOffset > Pos) {
+      mOut.indent() << "uint8_t __rs_padding_" << PaddingIndex++ << "["
+                    << (FieldOffset - Pos) << "];\n";
+    }
+    mOut.indent() << GetItemFieldDeclaration(F->getType(), F->getName())
+                  << ";\n";
+    Pos = FieldOffset + F->getType()->getAllocSize();
+  }
+  if (ERT->getAllocSize() > Pos) {
+    mOut.indent() << "uint8_t __rs_padding_" << PaddingIndex++ << "["
+                  << (ERT->getAllocSize() - Pos) << "];\n";
+  }
+  mOut.endBlock(true);
+
+  mOut.indent() << "static android::RSC::sp<const android::RSC::Element> "
+                   "createElement(\n";
+  mOut.indent() << "    android::RSC::sp<android::RSC::RS> rs)";
+  mOut.startBlock();
+  mOut.indent() << "android::RSC::Element::Builder eb(rs);\n";
+  Pos = 0;
+  PaddingIndex = 0;
+  for (RSExportRecordType::const_field_iterator FI = ERT->fields_begin(),
+                                                FE = ERT->fields_end();
+       FI != FE; FI++) {
+    const RSExportRecordType::Field *F = *FI;
+    size_t FieldOffset = F->getOffsetInParent();
+    if (FieldOffset > Pos) {
+      mOut.indent() << "eb.add(android::RSC::Element::U8(rs), "
+                       "\"#rs_padding_" << PaddingIndex++ << "\", "
+                    << (FieldOffset - Pos) << ");\n";
+    }
+    mOut.indent() << "eb.add(" << GetElementConstruct(F->getType(), "rs")
+                  << ", \"" << F->getName() << "\"";
+    if (size_t ArraySize = GetFlattenedArraySize(F->getType())) {
+      mOut << ", " << ArraySize;
+    }
+    mOut << ");\n";
+    Pos = FieldOffset + F->getType()->getAllocSize();
+  }
+  if (ERT->getAllocSize() > Pos) {
+    mOut.indent() << "eb.add(android::RSC::Element::U8(rs), "
+                     "\"#rs_padding_" << PaddingIndex++ << "\", "
+                  << (ERT->getAllocSize() - Pos) << ");\n";
+  }
+  mOut.indent() << "return eb.create();\n";
+  mOut.endBlock();
+
+  mOut.decreaseIndent();
+  mOut.indent() << "private:\n";
+  mOut.increaseIndent();
+  mOut.indent() << "android::RSC::sp<android::RSC::Allocation> mAllocation;\n\n";
+
+  mOut.decreaseIndent();
+  mOut.indent() << "public:\n";
+  mOut.increaseIndent();
+  mOut.indent() << ClassName
+                << "(android::RSC::sp<android::RSC::RS> rs, size_t count,\n";
+  mOut.indent() << "    uint32_t usages = RS_ALLOCATION_USAGE_SCRIPT)";
+  mOut.startBlock();
+  mOut.indent() << "mAllocation = android::RSC::Allocation::createSized(rs, "
+                   "createElement(rs), count, usages);\n";
+  mOut.endBlock();
+
+  mOut.indent() << "android::RSC::sp<android::RSC::Allocation> "
+                   "getAllocation() const";
+  mOut.startBlock();
+  mOut.indent() << "return mAllocation;\n";
+  mOut.endBlock();
+
+  mOut.indent() << "void copyFrom(const " RS_TYPE_ITEM_CLASS_NAME " *d)";
+  mOut.startBlock();
+  mOut.indent() << "mAllocation->copy1DFrom(d);\n";
+  mOut.endBlock();
+
+  mOut.indent() << "void copyTo(" RS_TYPE_ITEM_CLASS_NAME " *d) const";
+  mOut.startBlock();
+  mOut.indent() << "mAllocation->copy1DTo(d);\n";
+  mOut.endBlock();
+
+  mOut.indent() << "void copyRangeFrom(uint32_t off, size_t count, const "
+                   RS_TYPE_ITEM_CLASS_NAME " *d)";
+  mOut.startBlock();
+  mOut.indent() << "mAllocation->copy1DRangeFrom(off, count, d);\n";
+  mOut.endBlock();
+
+  mOut.indent() << "void copyRangeTo(uint32_t off, size_t count, "
+                   RS_TYPE_ITEM_CLASS_NAME " *d) const";
+  mOut.startBlock();
+  mOut.indent() << "mAllocation->copy1DRangeTo(off, count, d);\n";
+  mOut.endBlock();
+
+  mOut.endBlock(true);
+
+  // Catch any mismatch between the script and the native layout at compile
+  // time rather than by corrupting the data.
+  std::string ItemName = ClassName + "::" RS_TYPE_ITEM_CLASS_NAME;
+  mOut.indent() << "static_assert(sizeof(" << ItemName << ") == "
+                << ERT->getAllocSize() << ",\n";
+  mOut.indent() << "              \"Unexpected size of " << ItemName
+                << "\");\n";
+  for (RSExportRecordType::const_field_iterator FI = ERT->fields_begin(),
+                                                FE = ERT->fields_end();
+       FI != FE; FI++) {
+    const RSExportRecordType::Field *F = *FI;
+    mOut.indent() << "static_assert(offsetof(" << ItemName << ", "
+                  << F->getName() << ") == " << F->getOffsetInParent()
+                  << ",\n";
+    mOut.indent() << "              \"Unexpected offset of " << ItemName
+                  << "::" << F->getName() << "\");\n";
+  }
+  mOut << "\n";
+
+  mOut.indent() << "#endif  // " << Guard << "\n";
+  mOut.closeFile();
+  return true;
+}
+
+bool RSReflectionCpp::writeSoATypeHeader(const RSExportRecordType *ERT) {
+  std::string ClassName = RS_SOA_TYPE_CLASS_NAME_PREFIX + ERT->getName();
+
+  if (!mOut.startFile(mOutputDirectory, ClassName + ".h", mRSSourceFilePath,
+                      mRSContext->getLicenseNote(), false,
+                      mRSContext->getVerbose(), mMessages)) {
+    return false;
+  }
+
+  // Like ScriptField_<Record>.h, it may be written by several scripts.
+  std::string Guard = "RS_" + ClassName + "_H";
+  std::transform(Guard.begin(), Guard.end(), Guard.begin(), ::toupper);
+  mOut.indent() << "#ifndef " << Guard << "\n";
+  mOut.indent() << "#define " << Guard << "\n\n";
+
+  mOut.indent() << "#include \"RenderScript.h\"\n\n";
+
+  mOut.comment("Storage of struct " + ERT->getName() + " in structure-of-"
+               "arrays layout: one Allocation per field.  Vector values are "
+               "stored one component after the other, with 3-component "
+               "vectors padded to 4 components.");
+  mOut.indent() << "class " << ClassName;
+  mOut.startBlock();
+
+  mOut.decreaseIndent();
+  mOut.indent() << "private:\n";
+  mOut.increaseIndent();
+  for (RSExportRecordType::const_field_iterator FI = ERT->fields_begin(),
+                                                FE = ERT->fields_end();
+       FI != FE; FI++) {
+    mOut.indent() << "android::RSC::sp<android::RSC::Allocation> "
+                  << RS_SOA_FIELD_ALLOCATION_PREFIX << (*FI)->getName()
+                  << ";\n";
+  }
+
+  mOut.decreaseIndent();
+  mOut.indent() << "public:\n";
+  mOut.increaseIndent();
+  mOut.indent() << ClassName
+                << "(android::RSC::sp<android::RSC::RS> rs, size_t count,\n";
+  mOut.indent() << "    uint32_t usages = RS_ALLOCATION_USAGE_SCRIPT)";
+  mOut.startBlock();
+  for (RSExportRecordType::const_field_iterator FI = ERT->fields_begin(),
+                                                FE = ERT->fields_end();
+       FI != FE; FI++) {
+    const RSExportRecordType::Field *F = *FI;
+    mOut.indent() << RS_SOA_FIELD_ALLOCATION_PREFIX << F->getName()
+                  << " = android::RSC::Allocation::createSized(rs, "
+                  << "android::RSC::Element::"
+                  << F->getType()->getElementName()
+                  << "(rs), count, usages);\n";
+  }
+  mOut.endBlock();
+
+  for (RSExportRecordType::const_field_iterator FI = ERT->fields_begin(),
+                                                FE = ERT->fields_end();
+       FI != FE; FI++) {
+    const RSExportRecordType::Field *F = *FI;
+    std::string AllocName = RS_SOA_FIELD_ALLOCATION_PREFIX + F->getName();
+    const char *DataTypeName = RSExportPrimitiveType::getRSReflectionType(
+        static_cast<const RSExportPrimitiveType *>(F->getType()))->c_name;
+
+    mOut.indent() << "android::RSC::sp<android::RSC::Allocation> "
+                  << "getAllocation_" << F->getName() << "() const";
+    mOut.startBlock();
+    mOut.indent() << "return " << AllocName << ";\n";
+    mOut.endBlock();
+
+    mOut.indent() << "void copyFrom_" << F->getName() << "(const "
+                  << DataTypeName << " *d)";
+    mOut.startBlock();
+    mOut.indent() << AllocName << "->copy1DFrom(d);\n";
+    mOut.endBlock();
+
+    mOut.indent() << "void copyTo_" << F->getName() << "(" << DataTypeName
+                  << " *d)";
+    mOut.startBlock();
+    mOut.indent() << AllocName << "->copy1DTo(d);\n";
+    mOut.endBlock();
+
+    mOut.indent() << "void copyRangeFrom_" << F->getName()
+                  << "(uint32_t off, size_t count, const " << DataTypeName
+                  << " *d)";
+    mOut.startBlock();
+    mOut.indent() << AllocName << "->copy1DRangeFrom(off, count, d);\n";
+    mOut.endBlock();
+  }
+
+  mOut.endBlock(true);
+  mOut << "\n";
+
+  mOut.indent() << "#endif  // " << Guard << "\n";
+  mOut.closeFile();
+  return true;
+}
+
+void RSReflectionCpp::genSoABindings() {
+  for (RSContext::const_soa_binding_iterator
+           I = mRSContext->soa_bindings_begin(),
+           E = mRSContext->soa_bindings_end();
+       I != E; I++) {
+    const RSContext::SoABinding &B = *I;
+
+    mOut.indent() << "void bind_" << B.Prefix << "(const "
+                  << RS_SOA_TYPE_CLASS_NAME_PREFIX << B.Type->getName()
+                  << " &v)";
+    mOut.startBlock();
+    RSExportRecordType::const_field_iterator FI = B.Type->fields_begin();
+    for (std::vector<const RSExportVar *>::const_iterator
+             VI = B.FieldVars.begin(),
+             VE = B.FieldVars.end();
+         VI != VE; VI++, FI++) {
+      mOut.indent() << "bind_" << (*VI)->getName() << "(v.getAllocation_"
+                    << (*FI)->getName() << "());\n";
+    }
+    mOut.endBlock();
+  }
+}
+
 void RSReflectionCpp::genTypeInstancesUsedInForEach() {
   for (RSContext::const_export_foreach_iterator
            I = mRSContext->export_foreach_begin(),
@@ -197,6 +719,23 @@ void RSReflectionCpp::genTypeInstancesUsedInForEach() {
   }
 }
 
+void RSReflectionCpp::genTypeInstancesUsedInReduce() {
+  for (RSContext::const_export_reduce_iterator
+           I = mRSContext->export_reduce_begin(),
+           E = mRSContext->export_reduce_end();
+       I != E; I++) {
+    const RSExportReduce *ER = *I;
+    const RSExportReduce::InTypeVec &InTypes = ER->getInTypes();
+
+    for (RSExportReduce::InTypeVec::const_iterator BI = InTypes.begin(),
+         EI = InTypes.end(); BI != EI; BI++) {
+      genTypeInstance(*BI);
+    }
+    // Also used to create the allocation receiving the result.
+    genTypeInstance(ER->getResultType());
+  }
+}
+
 void RSReflectionCpp::genFieldsForAllocationTypeVerification() {
   bool CommentAdded = false;
   for (std::set<std::string>::iterator I = mTypesToCheck.begin(),
@@ -212,6 +751,40 @@ void RSReflectionCpp::genFieldsForAllocationTypeVerification() {
   }
 }
 
+void RSReflectionCpp::genSpecialize() {
+  mOut.comment("Makes the current values of the variables listed in "
+               "\"#pragma rs specialize\" final, so that the script can be "
+               "compiled for them.  Call this once they are set and before "
+               "the first launch.  Their setters fail afterwards.");
+  mOut.indent() << "void specialize()";
+  mOut.startBlock();
+  mOut.indent() << "static const uint32_t slots[] = {";
+  bool First = true;
+  uint32_t Slot = 0;
+  for (RSContext::const_export_var_iterator I = mRSContext->export_vars_begin(),
+                                            E = mRSContext->export_vars_end();
+       I != E; I++, Slot++) {
+    if (!(*I)->isSpecialized())
+      continue;
+    mOut << (First ? "" : ", ") << Slot;
+    First = false;
+  }
+  mOut << "};\n";
+  mOut.indent() << "if (" RS_SPECIALIZED_NAME ") return;\n";
+  mOut.indent() << "specializeVars(slots, sizeof(slots) / sizeof(slots[0]));\n";
+  mOut.indent() << RS_SPECIALIZED_NAME " = true;\n";
+  mOut.endBlock();
+}
+
+void RSReflectionCpp::genSpecializedCheck(const std::string &VarName) {
+  mOut.indent() << "if (" RS_SPECIALIZED_NAME ")";
+  mOut.startBlock();
+  mOut.indent() << "mRS->throwError(RS_ERROR_INVALID_PARAMETER, \"" << VarName
+                << " cannot be set after specialize()\");\n";
+  mOut.indent() << "return;\n";
+  mOut.endBlock();
+}
+
 void RSReflectionCpp::genFieldsToStoreExportVariableValues() {
   bool CommentAdded = false;
   for (RSContext::const_export_var_iterator I = mRSContext->export_vars_begin(),
@@ -232,12 +805,26 @@ void RSReflectionCpp::genFieldsToStoreExportVariableValues() {
                    "initialize this field to the same value.");
       CommentAdded = true;
     }
+    if (ev->getType()->getClass() == RSExportType::ExportClassConstantArray) {
+      mOut.indent() << GetItemFieldDeclaration(
+                           ev->getType(), RS_EXPORT_VAR_PREFIX + ev->getName())
+                    << ";\n";
+      continue;
+    }
     mOut.indent() << GetTypeName(ev->getType()) << " " RS_EXPORT_VAR_PREFIX
                   << ev->getName() << ";\n";
   }
+  if (mRSContext->hasSpecializedExportVar()) {
+    mOut.indent() << "bool " RS_SPECIALIZED_NAME ";\n";
+  }
+}
+
+bool RSReflectionCpp::hasKernelLaunchAPI() const {
+  return mRSContext->getTargetAPI() == SLANG_DEVELOPMENT_TARGET_API;
 }
 
 void RSReflectionCpp::genForEachDeclarations() {
+  bool LaunchAPI = hasKernelLaunchAPI();
   bool CommentAdded = false;
   for (RSContext::const_export_foreach_iterator
            I = mRSContext->export_foreach_begin(),
@@ -251,41 +838,71 @@ void RSReflectionCpp::genForEachDeclarations() {
     }
 
     if (!CommentAdded) {
-      mOut.comment("For each kernel of the script corresponds one method.  "
-                   "That method queues the kernel for execution.  The kernel "
-                   "may not have completed nor even started by the time this "
-                   "function returns.  Calls that extract the data out of the "
-                   "output allocation will wait for the kernels to complete.");
+      std::string Comment =
+          "For each kernel of the script corresponds one method.  That method "
+          "queues the kernel for execution.  The kernel may not have "
+          "completed nor even started by the time this function returns.  "
+          "Calls that extract the data out of the output allocation will wait "
+          "for the kernels to complete.";
+      if (LaunchAPI) {
+        Comment += "\n\nThe variant taking an RsScriptCall restricts the "
+                   "launch to the given range of cells.  getKernelID_ returns "
+                   "the kernel to add to a ScriptGroup.";
+      }
+      mOut.comment(Comment);
       CommentAdded = true;
     }
 
-    std::string FunctionStart = "void forEach_" + ForEach->getName() + "(";
-    mOut.indent() << FunctionStart;
+    if (LaunchAPI) {
+      mOut.indent() << "android::RSC::sp<android::RSC::ScriptKernelID> "
+                    << "getKernelID_" << ForEach->getName() << "();\n";
+    }
 
     ArgumentList Arguments;
-    const RSExportForEach::InVec &Ins = ForEach->getIns();
-    for (RSExportForEach::InIter BI = Ins.begin(), EI = Ins.end();
-         BI != EI; BI++) {
+    genForEachArguments(ForEach, &Arguments);
 
-      Arguments.push_back(std::make_pair(
-        "android::RSC::sp<const android::RSC::Allocation>", (*BI)->getName()));
-    }
+    std::string FunctionStart = "void forEach_" + ForEach->getName() + "(";
+    mOut.indent() << FunctionStart;
+    genArguments(Arguments, FunctionStart.length());
+    mOut << ");\n";
 
-    if (ForEach->hasOut() || ForEach->hasReturn()) {
-      Arguments.push_back(std::make_pair(
-          "android::RSC::sp<const android::RSC::Allocation>", "aout"));
+    if (LaunchAPI) {
+      Arguments.push_back(std::make_pair("const RsScriptCall *", "sc"));
+      mOut.indent() << FunctionStart;
+      genArguments(Arguments, FunctionStart.length());
+      mOut << ");\n";
     }
+  }
+}
 
-    const RSExportRecordType *ERT = ForEach->getParamPacketType();
-    if (ERT) {
-      for (RSExportForEach::const_param_iterator i = ForEach->params_begin(),
-                                                 e = ForEach->params_end();
-           i != e; i++) {
-        RSReflectionTypeData rtd;
-        (*i)->getType()->convertToRTD(&rtd);
-        Arguments.push_back(std::make_pair(rtd.type->c_name, (*i)->getName()));
-      }
+void RSReflectionCpp::genReduceDeclarations() {
+  bool CommentAdded = false;
+  for (RSContext::const_export_reduce_iterator
+           I = mRSContext->export_reduce_begin(),
+           E = mRSContext->export_reduce_end();
+       I != E; I++) {
+    const RSExportReduce *ER = *I;
+
+    if (!CommentAdded) {
+      mOut.comment("For each reduction kernel of the script corresponds one "
+                   "method.  That method runs the reduction over all the "
+                   "cells of its input allocations, or over the given range "
+                   "of cells for the variant taking an RsScriptCall, and "
+                   "waits for the result.");
+      CommentAdded = true;
     }
+
+    ArgumentList Arguments;
+    genReduceArguments(ER, &Arguments);
+
+    std::string FunctionStart = GetTypeName(ER->getResultType()) +
+                                " reduce_" + ER->getName() + "(";
+    mOut.indent() << FunctionStart;
+    genArguments(Arguments, FunctionStart.length());
+    mOut << ");\n";
+
+    Arguments.push_back(std::make_pair("const RsScriptCall *", "sc"));
+    mOut.indent() << FunctionStart;
     genArguments(Arguments, FunctionStart.length());
     mOut << ");\n";
   }
@@ -303,47 +920,169 @@ void RSReflectionCpp::genExportFunctionDeclarations() {
 }
 
 bool RSReflectionCpp::genEncodedBitCode() {
-  FILE *pfin = fopen(mBitCodeFilePath.c_str(), "rb");
-  if (pfin == nullptr) {
-    fprintf(stderr, "Error: could not read file %s\n",
-            mBitCodeFilePath.c_str());
-    return false;
+  if (mEmbedBitcodeWithIncbin) {
+    // The bytes are assembled from the companion assembly file, only declare
+    // the symbols delimiting them.
+    const std::string Symbol = getBitCodeSymbolName();
+    mOut.indent() << "extern \"C\" const unsigned char " << Symbol << "[];\n";
+    mOut.indent() << "extern \"C\" const unsigned char " << Symbol
+                  << "_end[];\n";
+  } else {
+    genBitCodeArray();
   }
 
-  unsigned char buf[16];
-  int read_length;
+  if (mBitCode.compressed) {
+    mOut << "\n";
+    mOut.indent() << "static const size_t __txt_uncompressed_size = "
+                  << mBitCode.uncompressedSize << ";\n\n";
+    mOut.comment("The bitcode is a zlib stream: inflate it into a temporary "
+                 "that lives until the ScriptC constructor has returned.");
+    mOut.indent() << "static std::vector<unsigned char> __inflate_txt("
+                     "const unsigned char *txt, size_t txtLength)";
+    mOut.startBlock();
+    mOut.indent() << "std::vector<unsigned char> "
+                     "bc(__txt_uncompressed_size);\n";
+    mOut.indent() << "uLongf bcLength = bc.size();\n";
+    mOut.indent() << "if ((uncompress(&bc[0], &bcLength, txt, txtLength) != "
+                     "Z_OK) ||\n";
+    mOut.indent() << "    (bcLength != bc.size()))";
+    mOut.startBlock();
+    mOut.comment("Zero bytes make the runtime reject the bitcode rather than "
+                 "load a truncated one.");
+    mOut.indent() << "bc.assign(bc.size(), 0);\n";
+    mOut.endBlock();
+    mOut.indent() << "return bc;\n";
+    mOut.endBlock();
+  }
+  return true;
+}
+
+void RSReflectionCpp::genBitCodeArray() {
+  // Format whole lines in a buffer and write each of them at once: the
+  // bitcode is often several megabytes.
+  static const char kHexDigits[] = "0123456789abcdef";
+  static const int kBytesPerLine = 32;
+  const unsigned char *Data =
+      reinterpret_cast<const unsigned char *>(mBitCode.data.data());
+  int Length = mBitCode.data.size();
+  std::string Line;
   mOut.indent() << "static const unsigned char __txt[] =";
   mOut.startBlock();
-  while ((read_length = fread(buf, 1, sizeof(buf), pfin)) > 0) {
-    mOut.indent();
-    for (int i = 0; i < read_length; i++) {
-      char buf2[16];
-      snprintf(buf2, sizeof(buf2), "0x%02x,", buf[i]);
-      mOut << buf2;
+  for (int i = 0; i < Length; i += kBytesPerLine) {
+    int line_end = std::min(i + kBytesPerLine, Length);
+    Line.clear();
+    for (int j = i; j < line_end; j++) {
+      const char Hex[] = { '0', 'x', kHexDigits[Data[j] >> 4],
+                           kHexDigits[Data[j] & 0xf], ',' };
+      Line.append(Hex, sizeof(Hex));
     }
-    mOut << "\n";
+    Line.push_back('\n');
+    mOut.indent() << Line;
   }
   mOut.endBlock(true);
   mOut << "\n";
+}
+
+bool RSReflectionCpp::genBitCodeAssemblyFile() {
+  // A compressed payload has to be written out for .incbin to pick it up.
+  std::string PayloadPath = mBitCodeFilePath;
+  if (mBitCode.compressed) {
+    PayloadPath = JoinPath(mOutputDirectory, getBitCodeSymbolName() + ".z");
+    std::ofstream Payload(PayloadPath.c_str(),
+                          std::ios::out | std::ios::binary);
+    Payload.write(mBitCode.data.data(), mBitCode.data.size());
+    Payload.close();
+    if (!Payload) {
+      mMessages->err() << "Error: could not write file " << PayloadPath
+                       << "\n";
+      return false;
+    }
+  }
+
+  // The payload is referred to relative to the output directory so that the
+  // generated sources do not depend on where they were generated.
+  llvm::SmallString<256> BitCodePath(PayloadPath);
+  llvm::SmallString<256> OutputDirectory(mOutputDirectory);
+  std::error_code EC = llvm::sys::fs::make_absolute(BitCodePath);
+  if (!EC) {
+    EC = llvm::sys::fs::make_absolute(OutputDirectory);
+  }
+  if (EC) {
+    mMessages->err() << "Error: could not resolve the path of "
+                     << PayloadPath << ": " << EC.message() << "\n";
+    return false;
+  }
+  std::string RelativePath = GetRelativePath(BitCodePath, OutputDirectory);
+  std::string EscapedPath;
+  for (size_t i = 0; i < RelativePath.size(); i++) {
+    if ((RelativePath[i] == '"') || (RelativePath[i] == '\\')) {
+      EscapedPath.push_back('\\');
+    }
+    EscapedPath.push_back(RelativePath[i]);
+  }
+
+  if (!mOut.startFile(mOutputDirectory, getBitCodeSymbolName() + ".S",
+                      mRSSourceFilePath, mRSContext->getLicenseNote(), false,
+                      mRSContext->getVerbose(), mMessages)) {
+    return false;
+  }
+
+  mOut.comment("The bitcode is looked up relative to the directory of this "
+               "file, which the assembler must search (e.g. with -I).");
+  const std::string Symbol = getBitCodeSymbolName();
+  mOut.increaseIndent();
+  mOut.indent() << ".section .rodata\n";
+  mOut.indent() << ".balign 16\n";
+  mOut.indent() << ".globl " << Symbol << "\n";
+  mOut.indent() << ".hidden " << Symbol << "\n";
+  mOut.indent() << ".type " << Symbol << ", %object\n";
+  mOut << Symbol << ":\n";
+  mOut.indent() << ".incbin \"" << EscapedPath << "\"\n";
+  mOut.indent() << ".globl " << Symbol << "_end\n";
+  mOut.indent() << ".hidden " << Symbol << "_end\n";
+  mOut << Symbol << "_end:\n";
+  mOut.indent() << ".size " << Symbol << ", " << Symbol << "_end - " << Symbol
+                << "\n\n";
+  // The bitcode does not need an executable stack.
+  mOut.indent() << ".section .note.GNU-stack,\"\",%progbits\n";
+  mOut.decreaseIndent();
+
+  mOut.closeFile();
   return true;
 }
 
 bool RSReflectionCpp::writeImplementationFile() {
   if (!mOut.startFile(mOutputDirectory, mClassName + ".cpp", mRSSourceFilePath,
                       mRSContext->getLicenseNote(), false,
-                      mRSContext->getVerbose())) {
+                      mRSContext->getVerbose(), mMessages)) {
     return false;
   }
 
   mOut.indent() << "#include \"" << mClassName << ".h\"\n\n";
+  if (mBitCode.compressed) {
+    mOut.indent() << "#include <vector>\n";
+    mOut.indent() << "#include <zlib.h>\n\n";
+  }
 
   genEncodedBitCode();
   mOut.indent() << "\n\n";
 
+  std::string BitCode = "__txt";
+  std::string BitCodeSize = "sizeof(__txt)";
+  if (mEmbedBitcodeWithIncbin) {
+    BitCode = getBitCodeSymbolName();
+    BitCodeSize = BitCode + "_end - " + BitCode;
+  }
+  if (mBitCode.compressed) {
+    BitCode = "__inflate_txt(" + BitCode + ", " + BitCodeSize + ").data()";
+    BitCodeSize = "__txt_uncompressed_size";
+  }
+
   const std::string &packageName = mRSContext->getReflectJavaPackageName();
   mOut.indent() << mClassName << "::" << mClassName
                 << "(android::RSC::sp<android::RSC::RS> rs):\n"
-                   "        ScriptC(rs, __txt, sizeof(__txt), \""
+                   "        ScriptC(rs, " << BitCode << ", " << BitCodeSize
+                << ", \""
                 << mCleanedRSFileName << "\", " << mCleanedRSFileName.length()
                 << ", \"/data/data/" << packageName << "/app\", sizeof(\""
                 << packageName << "\"))";
@@ -351,8 +1090,17 @@ bool RSReflectionCpp::writeImplementationFile() {
   for (std::set<std::string>::iterator I = mTypesToCheck.begin(),
                                        E = mTypesToCheck.end();
        I != E; I++) {
-    mOut.indent() << RS_ELEM_PREFIX << *I << " = android::RSC::Element::" << *I
-                  << "(mRS);\n";
+    if (llvm::StringRef(*I).startswith(RS_TYPE_CLASS_NAME_PREFIX)) {
+      mOut.indent() << RS_ELEM_PREFIX << *I << " = " << *I
+                    << "::createElement(mRS);\n";
+    } else {
+      mOut.indent() << RS_ELEM_PREFIX << *I << " = android::RSC::Element::"
+                    << *I << "(mRS);\n";
+    }
+  }
+
+  if (mRSContext->hasSpecializedExportVar()) {
+    mOut.indent() << RS_SPECIALIZED_NAME " = false;\n";
   }
 
   for (RSContext::const_export_var_iterator I = mRSContext->export_vars_begin(),
@@ -363,6 +1111,9 @@ bool RSReflectionCpp::writeImplementationFile() {
       genInitExportVariable(EV->getType(), EV->getName(), EV->getInit());
     } else {
       genZeroInitExportVariable(EV->getName());
+      if (EV->getNumInits() > 0) {
+        genInitArrayExportVariable(EV);
+      }
     }
   }
   mOut.endBlock();
@@ -372,6 +1123,7 @@ bool RSReflectionCpp::writeImplementationFile() {
   mOut.endBlock();
 
   // Reflect export for each functions
+  bool LaunchAPI = hasKernelLaunchAPI();
   uint32_t slot = 0;
   for (RSContext::const_export_foreach_iterator
            I = mRSContext->export_foreach_begin(),
@@ -383,62 +1135,92 @@ bool RSReflectionCpp::writeImplementationFile() {
       continue;
     }
 
-    ArgumentList Arguments;
-    std::string FunctionStart =
-        "void " + mClassName + "::forEach_" + ef->getName() + "(";
-    mOut.indent() << FunctionStart;
-
-    if (ef->hasIns()) {
-      // FIXME: Add support for kernels with multiple inputs.
-      assert(ef->getIns().size() == 1);
-      Arguments.push_back(std::make_pair(
-          "android::RSC::sp<const android::RSC::Allocation>", "ain"));
+    // Multi-input kernels require the development target API.
+    slangAssert((LaunchAPI || (ef->getIns().size() <= 1)) &&
+                "Multi-input kernel without the kernel launch API");
+
+    if (LaunchAPI) {
+      mOut.indent() << "android::RSC::sp<android::RSC::ScriptKernelID> "
+                    << mClassName << "::getKernelID_" << ef->getName()
+                    << "()";
+      mOut.startBlock();
+      mOut.indent() << "return createKernelID(" << slot << ", "
+                    << ef->getSignatureMetadata() << ", NULL, NULL);\n";
+      mOut.endBlock();
     }
 
-    if (ef->hasOut() || ef->hasReturn()) {
-      Arguments.push_back(std::make_pair(
-          "android::RSC::sp<const android::RSC::Allocation>", "aout"));
-    }
+    ArgumentList Arguments;
+    genForEachArguments(ef, &Arguments);
 
-    const RSExportRecordType *ERT = ef->getParamPacketType();
-    if (ERT) {
-      for (RSExportForEach::const_param_iterator i = ef->params_begin(),
-                                                 e = ef->params_end();
-           i != e; i++) {
-        RSReflectionTypeData rtd;
-        (*i)->getType()->convertToRTD(&rtd);
-        Arguments.push_back(std::make_pair(rtd.type->c_name, (*i)->getName()));
+    std::string FunctionStart =
+        "void " + mClassName + "::forEach_" + ef->getName() + "(";
+    if (LaunchAPI) {
+      // The unclipped launch forwards to the clipped one.
+      mOut.indent() << FunctionStart;
+      genArguments(Arguments, FunctionStart.length());
+      mOut << ")";
+      mOut.startBlock();
+      mOut.indent() << "forEach_" << ef->getName() << "(";
+      for (ArgumentList::const_iterator AI = Arguments.begin(),
+                                        AE = Arguments.end();
+           AI != AE; AI++) {
+        mOut << AI->second << ", ";
       }
+      mOut << "NULL);\n";
+      mOut.endBlock();
+
+      Arguments.push_back(std::make_pair("const RsScriptCall *", "sc"));
     }
+    mOut.indent() << FunctionStart;
     genArguments(Arguments, FunctionStart.length());
     mOut << ")";
     mOut.startBlock();
 
     const RSExportType *OET = ef->getOutType();
     const RSExportForEach::InTypeVec &InTypes = ef->getInTypes();
-    if (ef->hasIns()) {
-      // FIXME: Add support for kernels with multiple inputs.
-      assert(ef->getIns().size() == 1);
-      genTypeCheck(InTypes[0], "ain");
+    for (size_t Index = 0; Index < InTypes.size(); Index++) {
+      if (InTypes[Index] != nullptr) {
+        genTypeCheck(InTypes[Index], getForEachInputName(ef, Index).c_str());
+      }
     }
     if (OET) {
       genTypeCheck(OET, "aout");
     }
 
-    // TODO Add the appropriate dimension checking code, as seen in
-    // slang_rs_reflection.cpp.
+    if (ef->hasIns()) {
+      std::string In0Name = getForEachInputName(ef, 0);
+      for (size_t Index = 1; Index < ef->getIns().size(); Index++) {
+        genPairwiseDimCheck(In0Name, getForEachInputName(ef, Index));
+      }
+      if (ef->hasOut() || ef->hasReturn()) {
+        genPairwiseDimCheck(In0Name, "aout");
+      }
+    }
 
+    const RSExportRecordType *ERT = ef->getParamPacketType();
     std::string FieldPackerName = ef->getName() + "_fp";
+    bool HasFieldPacker = false;
     if (ERT) {
-      if (genCreateFieldPacker(ERT, FieldPackerName.c_str())) {
+      HasFieldPacker = genCreateFieldPacker(ERT, FieldPackerName.c_str());
+      if (HasFieldPacker) {
         genPackVarOfType(ERT, nullptr, FieldPackerName.c_str());
       }
     }
+
+    if (ef->getIns().size() > 1) {
+      mOut.indent() << "std::vector<android::RSC::sp<const "
+                       "android::RSC::Allocation> > ains;\n";
+      for (size_t Index = 0; Index < ef->getIns().size(); Index++) {
+        mOut.indent() << "ains.push_back(" << getForEachInputName(ef, Index)
+                      << ");\n";
+      }
+    }
+
     mOut.indent() << "forEach(" << slot << ", ";
 
-    if (ef->hasIns()) {
-      // FIXME: Add support for kernels with multiple inputs.
-      assert(ef->getIns().size() == 1);
+    if (ef->getIns().size() > 1) {
+      mOut << "ains, ";
+    } else if (ef->hasIns()) {
       mOut << "ain, ";
     } else {
       mOut << "NULL, ";
@@ -450,8 +1232,78 @@ bool RSReflectionCpp::writeImplementationFile() {
       mOut << "NULL, ";
     }
 
-    // FIXME (no support for usrData with C++ kernels)
-    mOut << "NULL, 0);\n";
+    if (HasFieldPacker) {
+      mOut << FieldPackerName << ".getData(), " << ERT->getAllocSize();
+    } else {
+      mOut << "NULL, 0";
+    }
+    mOut << (LaunchAPI ? ", sc);\n" : ");\n");
+    mOut.endBlock();
+  }
+
+  // Reflect the reduction kernels
+  slot = 0;
+  for (RSContext::const_export_reduce_iterator
+           I = mRSContext->export_reduce_begin(),
+           E = mRSContext->export_reduce_end();
+       I != E; I++, slot++) {
+    const RSExportReduce *ER = *I;
+    std::string ResultTypeName = GetTypeName(ER->getResultType());
+
+    ArgumentList Arguments;
+    genReduceArguments(ER, &Arguments);
+
+    // The reduction over all the cells forwards to the clipped one.
+    std::string FunctionStart =
+        ResultTypeName + " " + mClassName + "::reduce_" + ER->getName() + "(";
+    mOut.indent() << FunctionStart;
+    genArguments(Arguments, FunctionStart.length());
+    mOut << ")";
+    mOut.startBlock();
+    mOut.indent() << "return reduce_" << ER->getName() << "(";
+    for (ArgumentList::const_iterator AI = Arguments.begin(),
+                                      AE = Arguments.end();
+         AI != AE; AI++) {
+      mOut << AI->second << ", ";
+    }
+    mOut << "NULL);\n";
+    mOut.endBlock();
+
+    Arguments.push_back(std::make_pair("const RsScriptCall *", "sc"));
+    mOut.indent() << FunctionStart;
+    genArguments(Arguments, FunctionStart.length());
+    mOut << ")";
+    mOut.startBlock();
+
+    // A zero result is returned if the inputs are rejected.
+    mOut.indent() << ResultTypeName << " result;\n";
+    mOut.indent() << "memset(&result, 0, sizeof(result));\n";
+
+    const RSExportReduce::InTypeVec &InTypes = ER->getInTypes();
+    for (size_t Index = 0; Index < InTypes.size(); Index++) {
+      genTypeCheck(InTypes[Index], getReduceInputName(ER, Index).c_str(),
+                   "result");
+    }
+    for (size_t Index = 1; Index < InTypes.size(); Index++) {
+      genPairwiseDimCheck(getReduceInputName(ER, 0),
+                          getReduceInputName(ER, Index), "result");
+    }
+
+    mOut.indent() << "std::vector<android::RSC::sp<const "
+                     "android::RSC::Allocation> > ains;\n";
+    for (size_t Index = 0; Index < InTypes.size(); Index++) {
+      mOut.indent() << "ains.push_back(" << getReduceInputName(ER, Index)
+                    << ");\n";
+    }
+
+    // The runtime stores the result into a single cell allocation.
+    mOut.indent() << "android::RSC::sp<android::RSC::Allocation> aout =\n";
+    mOut.indent() << "    android::RSC::Allocation::createSized(mRS, "
+                  << RS_ELEM_PREFIX << ER->getResultType()->getElementName()
+                  << ", 1);\n";
+    mOut.indent() << "reduce(" << slot << ", ains, aout, sc);\n";
+    mOut.indent() << "aout->copy1DTo(&result);\n";
+    mOut.indent() << "return result;\n";
     mOut.endBlock();
   }
 
@@ -544,6 +1396,9 @@ void RSReflectionCpp::genGetterAndSetter(const RSExportPrimitiveType *EPT,
   if (!EV->isConst()) {
     mOut.indent() << "void set_" << EV->getName() << "(" << TypeName << " v)";
     mOut.startBlock();
+    if (EV->isSpecialized()) {
+      genSpecializedCheck(EV->getName());
+    }
     mOut.indent() << "setVar(" << getNextExportVarSlot() << ", ";
     if (EPT->isRSObjectType()) {
       mOut << "v";
@@ -588,6 +1443,16 @@ void RSReflectionCpp::genPointerTypeExportVariable(const RSExportVar *EV) {
     mOut.indent() << "bindAllocation(v, " << slot << ");\n";
     mOut.indent() << RS_EXPORT_VAR_PREFIX << VarName << " = v;\n";
     mOut.endBlock();
+
+    const RSExportType *PointeeType =
+        static_cast<const RSExportPointerType *>(ET)->getPointeeType();
+    if (PointeeType->getClass() == RSExportType::ExportClassRecord) {
+      mOut.indent() << "void bind_" << VarName << "(const "
+                    << PointeeType->getElementName() << " &v)";
+      mOut.startBlock();
+      mOut.indent() << "bind_" << VarName << "(v.getAllocation());\n";
+      mOut.endBlock();
+    }
   }
   mOut.indent() << TypeName << " get_" << VarName << "() const";
   mOut.startBlock();
@@ -615,6 +1480,9 @@ void RSReflectionCpp::genGetterAndSetter(const RSExportVectorType *EVT,
                   << rtd.type->rs_c_vector_prefix << EVT->getNumElement()
                   << " v)";
     mOut.startBlock();
+    if (EV->isSpecialized()) {
+      genSpecializedCheck(EV->getName());
+    }
     mOut.indent() << "setVar(" << getNextExportVarSlot()
                   << ", &v, sizeof(v));\n";
     mOut.indent() << RS_EXPORT_VAR_PREFIX << EV->getName() << " = v;\n";
@@ -641,12 +1509,56 @@ void RSReflectionCpp::genMatrixTypeExportVariable(const RSExportVar *EV) {
 
 void RSReflectionCpp::genGetterAndSetter(const RSExportConstantArrayType *AT,
                                          const RSExportVar *EV) {
-  slangAssert(false);
+  std::string VarName = RS_EXPORT_VAR_PREFIX + EV->getName();
+  uint32_t Slot = getNextExportVarSlot();
+
+  if (!EV->isConst() && !HasOpaqueData(AT)) {
+    mOut.indent() << "void set_" << EV->getName() << "(const "
+                  << GetItemFieldDeclaration(AT, "v") << ")";
+    mOut.startBlock();
+    mOut.indent() << "memcpy(" << VarName << ", v, sizeof(" << VarName
+                  << "));\n";
+    mOut.indent() << "setVar(" << Slot << ", " << VarName << ", sizeof("
+                  << VarName << "));\n";
+    mOut.endBlock();
+  }
+
+  // Arrays are returned through a pointer to their first element.
+  std::string ElementDecl = GetItemFieldDeclaration(AT->getElementType(), "");
+  size_t Split = ElementDecl.find(' ');
+  std::string ElementType = ElementDecl.substr(0, Split);
+  std::string ElementDims = ElementDecl.substr(Split + 1);
+  if (ElementDims.empty()) {
+    mOut.indent() << "const " << ElementType << " *get_" << EV->getName()
+                  << "() const";
+  } else {
+    mOut.indent() << "const " << ElementType << " (*get_" << EV->getName()
+                  << "() const)" << ElementDims;
+  }
+  mOut.startBlock();
+  mOut.indent() << "return " << VarName << ";\n";
+  mOut.endBlock();
 }
 
 void RSReflectionCpp::genGetterAndSetter(const RSExportRecordType *ERT,
                                          const RSExportVar *EV) {
-  slangAssert(false);
+  std::string TypeName = GetTypeName(ERT);
+  uint32_t Slot = getNextExportVarSlot();
+
+  if (!EV->isConst() && !HasOpaqueData(ERT)) {
+    mOut.indent() << "void set_" << EV->getName() << "(const " << TypeName
+                  << " &v)";
+    mOut.startBlock();
+    mOut.indent() << "setVar(" << Slot << ", &v, sizeof(v));\n";
+    mOut.indent() << RS_EXPORT_VAR_PREFIX << EV->getName() << " = v;\n";
+    mOut.endBlock();
+  }
+  mOut.indent() << "const " << TypeName << " &get_" << EV->getName()
+                << "() const";
+  mOut.startBlock();
+  mOut.indent() << "return " << RS_EXPORT_VAR_PREFIX << EV->getName()
+                << ";\n";
+  mOut.endBlock();
 }
 
 void RSReflectionCpp::makeFunctionSignature(bool isDefinition,
@@ -696,6 +1608,81 @@ void RSReflectionCpp::genArguments(const ArgumentList &Arguments, int Offset) {
   }
 }
 
+std::string RSReflectionCpp::getForEachInputName(const RSExportForEach *EF,
+                                                 size_t Index) {
+  const RSExportForEach::InVec &Ins = EF->getIns();
+  if (Ins.size() == 1) {
+    return "ain";
+  }
+  return "ain_" + Ins[Index]->getName().str();
+}
+
+void RSReflectionCpp::genForEachArguments(const RSExportForEach *EF,
+                                          ArgumentList *Arguments) {
+  for (size_t Index = 0; Index < EF->getIns().size(); Index++) {
+    Arguments->push_back(
+        std::make_pair("android::RSC::sp<const android::RSC::Allocation>",
+                       getForEachInputName(EF, Index)));
+  }
+
+  if (EF->hasOut() || EF->hasReturn()) {
+    Arguments->push_back(std::make_pair(
+        "android::RSC::sp<const android::RSC::Allocation>", "aout"));
+  }
+
+  if (EF->getParamPacketType()) {
+    for (RSExportForEach::const_param_iterator i = EF->params_begin(),
+                                               e = EF->params_end();
+         i != e; i++) {
+      RSReflectionTypeData rtd;
+      (*i)->getType()->convertToRTD(&rtd);
+      Arguments->push_back(std::make_pair(rtd.type->c_name, (*i)->getName()));
+    }
+  }
+}
+
+std::string RSReflectionCpp::getReduceInputName(const RSExportReduce *ER,
+                                                size_t Index) {
+  const RSExportReduce::InNameVec &InNames = ER->getInNames();
+  if (InNames.size() == 1) {
+    return "ain";
+  }
+  return "ain_" + InNames[Index];
+}
+
+void RSReflectionCpp::genReduceArguments(const RSExportReduce *ER,
+                                         ArgumentList *Arguments) {
+  for (size_t Index = 0; Index < ER->getInTypes().size(); Index++) {
+    Arguments->push_back(
+        std::make_pair("android::RSC::sp<const android::RSC::Allocation>",
+                       getReduceInputName(ER, Index)));
+  }
+}
+
+void RSReflectionCpp::genPairwiseDimCheck(const std::string &Name0,
+                                          const std::string &Name1,
+                                          const std::string &ReturnValue) {
+  mOut.indent() << "// Verify dimensions\n";
+  mOut.indent() << "if ((" << Name0 << "->getType()->getCount() != " << Name1
+                << "->getType()->getCount()) ||\n";
+  mOut.indent() << "    (" << Name0 << "->getType()->getX() != " << Name1
+                << "->getType()->getX()) ||\n";
+  mOut.indent() << "    (" << Name0 << "->getType()->getY() != " << Name1
+                << "->getType()->getY()) ||\n";
+  mOut.indent() << "    (" << Name0 << "->getType()->getZ() != " << Name1
+                << "->getType()->getZ()) ||\n";
+  mOut.indent() << "    (" << Name0 << "->getType()->hasFaces() != " << Name1
+                << "->getType()->hasFaces()) ||\n";
+  mOut.indent() << "    (" << Name0 << "->getType()->hasMipmaps() != "
+                << Name1 << "->getType()->hasMipmaps()))";
+  mOut.startBlock();
+  mOut.indent() << "mRS->throwError(RS_ERROR_INVALID_PARAMETER, "
+                   "\"Dimension mismatch between parameters " << Name0
+                << " and " << Name1 << "!\");\n";
+  genErrorReturn(ReturnValue);
+  mOut.endBlock();
+}
+
 bool RSReflectionCpp::genCreateFieldPacker(const RSExportType *ET,
                                            const char *FieldPackerName) {
   size_t AllocSize = ET->getAllocSize();
@@ -800,7 +1787,8 @@ void RSReflectionCpp::genPackVarOfType(const RSExportType *ET,
 }
 
 void RSReflectionCpp::genTypeCheck(const RSExportType *ET,
-                                   const char *VarName) {
+                                   const char *VarName,
+                                   const std::string &ReturnValue) {
   mOut.indent() << "// Type check for " << VarName << "\n";
 
   if (ET->getClass() == RSExportType::ExportClassPointer) {
@@ -829,11 +1817,19 @@ void RSReflectionCpp::genTypeCheck(const RSExportType *ET,
     mOut.startBlock();
     mOut.indent() << "mRS->throwError(RS_ERROR_RUNTIME_ERROR, "
                      "\"Incompatible type\");\n";
-    mOut.indent() << "return;\n";
+    genErrorReturn(ReturnValue);
     mOut.endBlock();
   }
 }
 
+void RSReflectionCpp::genErrorReturn(const std::string &ReturnValue) {
+  if (ReturnValue.empty()) {
+    mOut.indent() << "return;\n";
+  } else {
+    mOut.indent() << "return " << ReturnValue << ";\n";
+  }
+}
+
 void RSReflectionCpp::genTypeInstanceFromPointer(const RSExportType *ET) {
   if (ET->getClass() == RSExportType::ExportClassPointer) {
     // For pointer parameters to original forEach kernels.
@@ -880,8 +1876,8 @@ void RSReflectionCpp::genInitExportVariable(const RSExportType *ET,
   }
   case RSExportType::ExportClassPointer: {
     if (!Val.isInt() || Val.getInt().getSExtValue() != 0)
-      std::cerr << "Initializer which is non-NULL to pointer type variable "
-                   "will be ignored" << std::endl;
+      mMessages->err() << "Initializer which is non-NULL to pointer type "
+                          "variable will be ignored\n";
     break;
   }
   case RSExportType::ExportClassVector: {
@@ -930,6 +1926,24 @@ void RSReflectionCpp::genInitExportVariable(const RSExportType *ET,
   }
 }
 
+void RSReflectionCpp::genInitArrayExportVariable(const RSExportVar *EV) {
+  const RSExportType *ElementType =
+      static_cast<const RSExportConstantArrayType *>(EV->getType())
+          ->getElementType();
+  // Only the arrays of scalars and vectors have their initializer recorded
+  // element by element.
+  if ((ElementType->getClass() != RSExportType::ExportClassPrimitive) &&
+      (ElementType->getClass() != RSExportType::ExportClassVector)) {
+    return;
+  }
+
+  for (unsigned i = 0; i < EV->getNumInits(); i++) {
+    std::stringstream Name;
+    Name << EV->getName() << "[" << i << "]";
+    genInitExportVariable(ElementType, Name.str(), EV->getInitArray(i));
+  }
+}
+
 const char *RSReflectionCpp::getVectorAccessor(unsigned Index) {
   static const char *VectorAccessorMap[] = {/* 0 */ "x",
                                             /* 1 */ "y",
@@ -976,6 +1990,12 @@ void RSReflectionCpp::genInitValue(const clang::APValue &Val, bool asBool) {
 
   case clang::APValue::Float: {
     llvm::APFloat apf = Val.getFloat();
+    if (&apf.getSemantics() == &llvm::APFloat::IEEEhalf) {
+      // half values are reflected as their raw bits.
+      mOut << "0x"
+           << llvm::utohexstr(apf.bitcastToAPInt().getZExtValue());
+      break;
+    }
     llvm::SmallString<30> s;
     apf.toString(s);
     mOut << s.c_str();
@@ -1009,7 +2029,7 @@ void RSReflectionCpp::genInitBoolExportVariable(const std::string &VarName,
 
   mOut.indent() << RS_EXPORT_VAR_PREFIX << VarName << " = "
                 << ((Val.getInt().getSExtValue() == 0) ? "false" : "true")
-                << ";";
+                << ";\n";
 }
 
 } // namespace slang
@@ -28,24 +28,41 @@ namespace slang {
 
 class RSReflectionCpp {
  public:
-  RSReflectionCpp(const RSContext *Context, const std::string &OutputDirectory,
+  RSReflectionCpp(const RSContext *Context, ReflectionMessages *Messages,
+                  const std::string &OutputDirectory,
                   const std::string &RSSourceFileName,
-                  const std::string &BitCodeFileName);
+                  const std::string &BitCodeFileName,
+                  bool EmbedBitcodeWithIncbin = false,
+                  bool CompressBitcode = false);
   virtual ~RSReflectionCpp();
 
   bool reflect();
 
+  // The companion assembly file written in @OutputDirectory for
+  // @RSSourceFileName when the bitcode is pulled in with .incbin.
+  static std::string GetBitCodeAssemblyFilePath(
+      const std::string &OutputDirectory, const std::string &RSSourceFileName);
+
  private:
   // List of of (type, name) pairs.
   typedef std::vector<std::pair<std::string, std::string> > ArgumentList;
 
   // Information coming from the compiler about the code we're reflecting.
   const RSContext *mRSContext;
+  // Where the messages of the reflection are reported.
+  ReflectionMessages *mMessages;
 
   // Path to the *.rs file for which we're generating C++ code.
   std::string mRSSourceFilePath;
   // Path to the file that contains the byte code generated from the *.rs file.
   std::string mBitCodeFilePath;
+  // Whether the bitcode is pulled in by a companion assembly file (.incbin)
+  // rather than embedded as a byte array in the implementation file.
+  bool mEmbedBitcodeWithIncbin;
+  // Whether the embedded bitcode is compressed with zlib.
+  bool mCompressBitcode;
+  // The bitcode to embed (not loaded if it is pulled in as is by .incbin).
+  RSSlangReflectUtils::BitCodePayload mBitCode;
   // The directory where we'll generate the C++ files.
   std::string mOutputDirectory;
   // A cleaned up version of the *.rs file name that can be used in generating
@@ -86,14 +103,31 @@ class RSReflectionCpp {
 
   bool writeHeaderFile();
   bool writeImplementationFile();
+  // Write ScriptField_<Record>.h for each exported record type, and
+  // ScriptFieldSoA_<Record>.h for each structure-of-arrays one.
+  bool writeRecordTypeHeaders();
+  bool writeRecordTypeHeader(const RSExportRecordType *ERT);
+  bool writeSoATypeHeader(const RSExportRecordType *ERT);
+  void genRecordTypeIncludes();
   void makeFunctionSignature(bool isDefinition, const RSExportFunc *ef);
   bool genEncodedBitCode();
+  void genBitCodeArray();
+  bool genBitCodeAssemblyFile();
+  // The symbol of the bitcode defined by the companion assembly file.
+  std::string getBitCodeSymbolName() const { return mClassName + "_bitcode"; }
   void genFieldsToStoreExportVariableValues();
   void genTypeInstancesUsedInForEach();
+  void genTypeInstancesUsedInReduce();
   void genFieldsForAllocationTypeVerification();
   void genExportVariablesGetterAndSetter();
   void genForEachDeclarations();
+  void genReduceDeclarations();
   void genExportFunctionDeclarations();
+  void genSoABindings();
+  // specialize() and the check that keeps the setters of the specialized
+  // variables from being called after it.
+  void genSpecialize();
+  void genSpecializedCheck(const std::string &VarName);
 
   bool startScriptHeader();
 
@@ -105,10 +139,32 @@ class RSReflectionCpp {
                                  const clang::APValue &Val);
   void genInitPrimitiveExportVariable(const std::string &VarName,
                                       const clang::APValue &Val);
+  void genInitArrayExportVariable(const RSExportVar *EV);
 
   // Produce an argument string of the form "T1 t, T2 u, T3 v".
   void genArguments(const ArgumentList &Args, int Offset);
 
+  // Whether the reflected kernels may use the launch options, multi-input and
+  // kernel ID entry points of the C++ Script, which only the development
+  // runtime has. Otherwise forEach_ uses forEach(slot, in, out, usr, len).
+  bool hasKernelLaunchAPI() const;
+
+  // The inputs, output and parameters of the forEach_ method of @EF.
+  void genForEachArguments(const RSExportForEach *EF, ArgumentList *Arguments);
+  // The name of the @Index-th input allocation of the forEach_ method of @EF.
+  static std::string getForEachInputName(const RSExportForEach *EF,
+                                         size_t Index);
+  // Generate a runtime check that two allocations have the same dimensions.
+  // On mismatch, the generated code returns @ReturnValue (if any).
+  void genPairwiseDimCheck(const std::string &Name0, const std::string &Name1,
+                           const std::string &ReturnValue = "");
+
+  // The inputs of the reduce_ method of @ER.
+  void genReduceArguments(const RSExportReduce *ER, ArgumentList *Arguments);
+  // The name of the @Index-th input allocation of the reduce_ method of @ER.
+  static std::string getReduceInputName(const RSExportReduce *ER,
+                                        size_t Index);
+
   void genPointerTypeExportVariable(const RSExportVar *EV);
   void genMatrixTypeExportVariable(const RSExportVar *EV);
   void genRecordTypeExportVariable(const RSExportVar *EV);
@@ -125,8 +181,11 @@ class RSReflectionCpp {
   void genPackVarOfType(const RSExportType *ET, const char *VarName,
                         const char *FieldPackerName);
 
-  // Generate a runtime type check for VarName.
-  void genTypeCheck(const RSExportType *ET, const char *VarName);
+  // Generate a runtime type check for VarName. On mismatch, the generated code
+  // returns @ReturnValue (if any).
+  void genTypeCheck(const RSExportType *ET, const char *VarName,
+                    const std::string &ReturnValue = "");
+  void genErrorReturn(const std::string &ReturnValue);
 
   // Generate a type instance for a given forEach argument type.
   void genTypeInstanceFromPointer(const RSExportType *ET);
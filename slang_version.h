@@ -27,6 +27,7 @@
 // ICS -> Ice Cream Sandwich
 // JB -> Jelly Bean
 // KK -> KitKat
+// L -> Lollipop
 enum SlangTargetAPI {
   SLANG_MINIMUM_TARGET_API = 11,
   SLANG_HC_TARGET_API = 11,
@@ -38,6 +39,7 @@ enum SlangTargetAPI {
   SLANG_JB_MR1_TARGET_API = 17,
   SLANG_JB_MR2_TARGET_API = 18,
   SLANG_KK_TARGET_API = 19,
+  SLANG_L_TARGET_API = 21,
   SLANG_MAXIMUM_TARGET_API = RS_VERSION,
   SLANG_DEVELOPMENT_TARGET_API = RS_DEVELOPMENT_API
 };
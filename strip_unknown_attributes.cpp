@@ -16,19 +16,34 @@
 
 #include "strip_unknown_attributes.h"
 
+#include "llvm/ADT/StringExtras.h"
+#include "llvm/IR/Metadata.h"
+
+#include "slang_rs_metadata.h"
+#include "slang_version.h"
+
 namespace slang {
 
-StripUnknownAttributes::StripUnknownAttributes() : ModulePass(ID) {
+StripUnknownAttributes::StripUnknownAttributes(unsigned int TargetAPI)
+    : ModulePass(ID), mTargetAPI(TargetAPI) {
 }
 
 
-bool StripUnknownAttributes::runOnFunction(llvm::Function &F) {
+bool StripUnknownAttributes::runOnFunction(
+    llvm::Function &F, llvm::SmallVectorImpl<llvm::Value*> *Stripped) {
+  llvm::LLVMContext &C = F.getContext();
   bool changed = false;
   for (llvm::Function::arg_iterator I = F.arg_begin(), E = F.arg_end();
        I != E; ++I) {
     llvm::Argument &A = *I;
     // Remove any readnone/readonly attributes from function parameters.
     if (A.onlyReadsMemory()) {
+      Stripped->push_back(
+          llvm::MDString::get(C, llvm::utostr_32(A.getArgNo())));
+      Stripped->push_back(llvm::MDString::get(
+          C, A.hasAttribute(llvm::Attribute::ReadNone) ? "readnone"
+                                                         : "readonly"));
+
       llvm::AttrBuilder B;
       B.addAttribute(llvm::Attribute::ReadNone);
       B.addAttribute(llvm::Attribute::ReadOnly);
@@ -43,16 +58,33 @@ bool StripUnknownAttributes::runOnFunction(llvm::Function &F) {
 
 
 bool StripUnknownAttributes::runOnModule(llvm::Module &M) {
+  // Starting with Lollipop, the readers accept readnone/readonly on
+  // parameters.
+  if (mTargetAPI >= SLANG_L_TARGET_API)
+    return false;
+
   bool Changed = false;
+  llvm::NamedMDNode *ParamAttrs = nullptr;
+  llvm::SmallVector<llvm::Value*, 8> Stripped;
   for (llvm::Module::iterator I = M.begin(), E = M.end(); I != E; ++I) {
-    Changed |= runOnFunction(*I);
+    Stripped.push_back(llvm::MDString::get(M.getContext(), I->getName()));
+    Changed |= runOnFunction(*I, &Stripped);
+
+    // The declared functions are implemented by the runtime, which knows
+    // their attributes.
+    if ((Stripped.size() > 1) && !I->isDeclaration()) {
+      if (ParamAttrs == nullptr)
+        ParamAttrs = M.getOrInsertNamedMetadata(RS_PARAM_ATTRS_MN);
+      ParamAttrs->addOperand(llvm::MDNode::get(M.getContext(), Stripped));
+    }
+    Stripped.clear();
   }
   return Changed;
 }
 
 
-llvm::ModulePass * createStripUnknownAttributesPass() {
-  return new StripUnknownAttributes();
+llvm::ModulePass * createStripUnknownAttributesPass(unsigned int TargetAPI) {
+  return new StripUnknownAttributes(TargetAPI);
 }
 
 
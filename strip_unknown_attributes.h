@@ -14,6 +14,7 @@
  * limitations under the License.
  */
 
+#include "llvm/ADT/SmallVector.h"
 #include "llvm/IR/Module.h"
 #include "llvm/Pass.h"
 
@@ -24,19 +25,29 @@ namespace slang {
 // other than function attributes, so it will fail verification otherwise.
 // Since we never ran the verifier in Jellybean, it ends up with potential
 // crashes deeper in CodeGen.
+//
+// The attributes are only stripped for the targets before Lollipop, whose
+// readers do not support them. The ones stripped from the defined functions
+// are then recorded in #rs_param_attrs instead, for the newer drivers.
 class StripUnknownAttributes : public llvm::ModulePass {
+private:
+  unsigned int mTargetAPI;
+
 public:
   static char ID;
 
-  StripUnknownAttributes();
+  explicit StripUnknownAttributes(unsigned int TargetAPI);
 
-  bool runOnFunction(llvm::Function &F);
+  // Appends the <argument number, attribute> pairs stripped from @F to
+  // @Stripped.
+  bool runOnFunction(llvm::Function &F,
+                     llvm::SmallVectorImpl<llvm::Value*> *Stripped);
 
   // We have to use a ModulePass, since a FunctionPass only gets run on
   // defined Functions (and not declared Functions).
   virtual bool runOnModule(llvm::Module &M);
 };
 
-llvm::ModulePass * createStripUnknownAttributesPass();
+llvm::ModulePass * createStripUnknownAttributesPass(unsigned int TargetAPI);
 
 }  // namespace slang
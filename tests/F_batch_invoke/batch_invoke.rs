@@ -0,0 +1,7 @@
+#pragma version(1)
+#pragma rs java_package_name(foo)
+
+#pragma rs batch_invoke(clear)
+
+void clear() {
+}
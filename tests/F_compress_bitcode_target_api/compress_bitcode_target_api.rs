@@ -0,0 +1,9 @@
+// -compress-bitcode -target-api 19
+#pragma version(1)
+#pragma rs java_package_name(foo)
+
+float scale;
+
+float4 RS_KERNEL mul(float4 in) {
+  return in * scale;
+}
@@ -0,0 +1,9 @@
+#pragma version(1)
+#pragma rs java_package_name(foo)
+
+typedef struct Node {
+    float weight;
+    bool visited;
+} Node_t;
+
+#pragma rs export_type_soa(Node_t)
@@ -0,0 +1,5 @@
+// -target-api 20
+#pragma version(1)
+#pragma rs java_package_name(foo)
+
+half h;
@@ -0,0 +1,7 @@
+#pragma version(1)
+#pragma rs java_package_name(foo)
+
+#pragma rs fp_precision(rs_fp_full)
+float4 RS_KERNEL copy(float4 in) {
+  return in;
+}
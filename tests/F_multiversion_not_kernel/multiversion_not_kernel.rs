@@ -0,0 +1,10 @@
+#pragma version(1)
+#pragma rs java_package_name(foo)
+
+#pragma rs multiversion(setGain)
+
+float gain;
+
+void setGain(float g) {
+  gain = g;
+}
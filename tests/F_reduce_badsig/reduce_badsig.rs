@@ -0,0 +1,13 @@
+// -target-api 0
+#pragma version(1)
+#pragma rs java_package_name(foo)
+
+#pragma rs reduce(addint) accumulator(aiAccum) combiner(aiCombine)
+
+static void aiAccum(int *accum, int val) {
+  *accum += val;
+}
+
+static void aiCombine(int *accum, int *other) {
+  *accum += *other;
+}
@@ -0,0 +1,7 @@
+// -target-api 0
+#pragma version(1)
+#pragma rs java_package_name(foo)
+
+#pragma rs specialize(kRadius)
+
+const int kRadius = 3;
@@ -0,0 +1,10 @@
+#pragma version(1)
+#pragma rs java_package_name(foo)
+
+#pragma rs specialize(radius)
+
+int radius;
+
+int RS_KERNEL add(int in) {
+  return in + radius;
+}
@@ -0,0 +1,37 @@
+#pragma version(1)
+#pragma rs java_package_name(foo)
+
+typedef struct Particle {
+  float2 position;
+  float2 velocity;
+} Particle_t;
+
+Particle_t *particles;
+int numParticles;
+
+#pragma rs batch_invoke(spawn, spawnAt, emit)
+
+void spawn(float x, float y, float vx, float vy) {
+  Particle_t *p = &particles[numParticles++];
+  p->position.x = x;
+  p->position.y = y;
+  p->velocity.x = vx;
+  p->velocity.y = vy;
+}
+
+void spawnAt(Particle_t p, int index) {
+  particles[index] = p;
+}
+
+// Every overload is batched, and the parameters may use any name.
+void __attribute__((overloadable)) emit(int ct) {
+  numParticles += ct;
+}
+
+void __attribute__((overloadable)) emit(float batchPacker, int batchCount) {
+  numParticles += batchCount;
+}
+
+void clear() {
+  numParticles = 0;
+}
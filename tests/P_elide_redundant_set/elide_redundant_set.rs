@@ -0,0 +1,16 @@
+// -elide-redundant-set
+#pragma version(1)
+#pragma rs java_package_name(foo)
+
+float f;
+double d;
+uchar uc;
+uint u;
+float4 f4;
+rs_matrix4x4 m;
+
+void setAll(float a, int b, float4 c) {
+    f = a;
+    u = b;
+    f4 = c;
+}
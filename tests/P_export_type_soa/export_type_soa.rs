@@ -0,0 +1,18 @@
+#pragma version(1)
+#pragma rs java_package_name(foo)
+
+typedef struct Particle {
+    float4 position;
+    float mass;
+    uint id;
+} Particle_t;
+
+#pragma rs export_type_soa(Particle_t)
+
+float4 *particles_position;
+float *particles_mass;
+uint *particles_id;
+
+void root(const float *in, float *out) {
+    *out = *in;
+}
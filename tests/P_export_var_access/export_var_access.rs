@@ -0,0 +1,21 @@
+#pragma version(1)
+#pragma rs java_package_name(foo)
+
+float scale;          // read-only
+int count;            // written by an invokable
+int hits;             // written by a kernel through a helper
+rs_allocation table;  // read-only, only released by the destructor
+
+static void bump() {
+  hits++;
+}
+
+float RS_KERNEL apply(float in) {
+  if (in > scale)
+    bump();
+  return in * scale + rsGetElementAt_float(table, 0);
+}
+
+void reset(int n) {
+  count = n;
+}
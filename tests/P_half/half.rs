@@ -0,0 +1,30 @@
+// -target-api 0
+#pragma version(1)
+#pragma rs java_package_name(foo)
+
+half h;
+half2 h2;
+half3 h3;
+half4 h4;
+
+const half kOne = 1.0;
+
+typedef struct HalfPixel {
+  half4 color;
+  half weight;
+} HalfPixel_t;
+
+HalfPixel_t pixel;
+HalfPixel_t *pixels;
+
+half4 RS_KERNEL copy(half4 in) {
+  return in;
+}
+
+half RS_KERNEL scale(half in) {
+  return in * h;
+}
+
+float RS_KERNEL widen(half in) {
+  return in;
+}
@@ -0,0 +1,15 @@
+// -target-api 20
+#pragma version(1)
+#pragma rs java_package_name(foo)
+
+// "half" is only a keyword when targeting the development API.
+float half;
+
+static float halve(float in) {
+  float half = in * 0.5f;
+  return half;
+}
+
+float RS_KERNEL scale(float in) {
+  return halve(in) + half;
+}
@@ -0,0 +1,21 @@
+#pragma version(1)
+#pragma rs java_package_name(foo)
+
+float gain;
+int taps;
+
+float RS_KERNEL scale(float in) {
+  return in * gain;
+}
+
+float RS_KERNEL wave(float in) {
+  return native_sin(in) + exp(in) * pow(in, 2.5f);
+}
+
+float RS_KERNEL filter(float in, uint32_t x) {
+  float sum = 0.f;
+  for (int i = 0; i < taps; i++) {
+    sum = sum * in + 1.f;
+  }
+  return sum;
+}
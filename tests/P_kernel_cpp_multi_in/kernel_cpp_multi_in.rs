@@ -0,0 +1,14 @@
+// -reflect-c++ -target-api 0
+#pragma version(1)
+#pragma rs java_package_name(foo)
+
+int RS_KERNEL add(int in0, int in1) {
+  return in0 + in1;
+}
+
+float4 RS_KERNEL blend(float4 a, float4 b, float c, uint32_t x) {
+  return a * c + b * (1.f - c);
+}
+
+void RS_KERNEL consume(uchar4 a, uchar4 b) {
+}
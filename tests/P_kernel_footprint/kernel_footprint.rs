@@ -0,0 +1,29 @@
+// -warn-untiled-reads
+#pragma version(1)
+#pragma rs java_package_name(foo)
+
+rs_allocation image;
+rs_allocation lut;
+rs_allocation weights;
+
+float RS_KERNEL blur3x3(uint32_t x, uint32_t y) {
+  float sum = 0.f;
+  sum += rsGetElementAt_float(image, x - 1, y - 1);
+  sum += rsGetElementAt_float(image, x + 1, y + 1);
+  sum += rsGetElementAt_float(image, x, y);
+  sum += rsGetElementAt_float(image, x + (-1), 1 + y);
+  return sum * rsGetElementAt_float(weights, 0);
+}
+
+float RS_KERNEL shift(uint32_t x) {
+  return rsGetElementAt_float(image, x + 2, 0);
+}
+
+uchar RS_KERNEL remap(uchar in) {
+  return rsGetElementAt_uchar(lut, in);
+}
+
+float RS_KERNEL stride(uint32_t x) {
+  x = x * 2;
+  return rsGetElementAt_float(image, x + 1);
+}
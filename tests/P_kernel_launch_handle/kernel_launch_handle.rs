@@ -0,0 +1,18 @@
+// -target-api 0
+#pragma version(1)
+#pragma rs java_package_name(foo)
+
+int RS_KERNEL root(int ain) {
+  return ain;
+}
+
+int RS_KERNEL add(int in0, int in1) {
+  return in0 + in1;
+}
+
+void RS_KERNEL in_only(uchar4 ain) {
+}
+
+int RS_KERNEL out_only() {
+  return 0;
+}
@@ -0,0 +1,29 @@
+#pragma version(1)
+#pragma rs java_package_name(foo)
+
+float gain;
+
+#pragma rs fp_precision(rs_fp_relaxed)
+float4 RS_KERNEL brighten(float4 in) {
+  return in * gain;
+}
+
+float4 RS_KERNEL copy(float4 in) {
+  return in;
+}
+
+#pragma rs fp_precision(rs_fp_relaxed)
+void setGain(float g) {
+  gain = g;
+}
+
+#pragma rs fp_precision(rs_fp_relaxed)
+float4 RS_KERNEL invert(float4 in);
+
+float4 RS_KERNEL dim(float4 in) {
+  return in * 0.5f;
+}
+
+float4 RS_KERNEL invert(float4 in) {
+  return 1.f - in;
+}
@@ -0,0 +1,38 @@
+// -layout-report
+#pragma version(1)
+#pragma rs java_package_name(foo)
+
+typedef struct Padded {
+    int a;
+    float4 b;
+    int c;
+} Padded;
+
+typedef struct Dense {
+    float4 v;
+    int i;
+    int j;
+    int k;
+    int l;
+} Dense;
+
+typedef struct Inner {
+    float4 v;
+    char c;
+} Inner;
+
+typedef struct Nested {
+    char tag;
+    Inner in;
+} Nested;
+
+typedef struct Aligned {
+    int a;
+    int b __attribute__((aligned(16)));
+    int c;
+} Aligned;
+
+Padded p;
+Dense d;
+Nested n;
+Aligned al;
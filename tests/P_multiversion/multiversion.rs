@@ -0,0 +1,24 @@
+#pragma version(1)
+#pragma rs java_package_name(foo)
+
+#pragma rs multiversion(brighten, ramp, power)
+
+float gain;
+int steps;
+
+float RS_KERNEL brighten(float in) {
+  float out = in * gain + 0.1f;
+  return (out > 1.f) ? 1.f : out;
+}
+
+int RS_KERNEL ramp(uint32_t x) {
+  return x * 2;
+}
+
+float RS_KERNEL power(float in) {
+  float out = 1.f;
+  for (int i = 0; i < steps; i++) {
+    out *= in;
+  }
+  return out;
+}
@@ -0,0 +1,68 @@
+// -target-api 0
+#pragma version(1)
+#pragma rs java_package_name(foo)
+
+// Sum of all the cells, with the accumulator doubling as combiner.
+#pragma rs reduce(addint) accumulator(aiAccum)
+
+static void aiAccum(int *accum, int val) {
+  *accum += val;
+}
+
+// Mean of all the cells.
+typedef struct MeanAccum {
+  float sum;
+  int count;
+} MeanAccum_t;
+
+#pragma rs reduce(mean) initializer(mInit) accumulator(mAccum) \
+  combiner(mCombine) outconverter(mOut)
+
+static void mInit(MeanAccum_t *accum) {
+  accum->sum = 0.f;
+  accum->count = 0;
+}
+
+static void mAccum(MeanAccum_t *accum, float val) {
+  accum->sum += val;
+  accum->count++;
+}
+
+static void mCombine(MeanAccum_t *accum, const MeanAccum_t *other) {
+  accum->sum += other->sum;
+  accum->count += other->count;
+}
+
+static void mOut(float *result, const MeanAccum_t *accum) {
+  *result = (accum->count == 0) ? 0.f : accum->sum / accum->count;
+}
+
+// Dot product of two allocations.
+#pragma rs reduce(dotProduct) accumulator(dAccum) combiner(dCombine)
+
+void dAccum(float *accum, float4 a, float4 b) {
+  *accum += dot(a, b);
+}
+
+void dCombine(float *accum, const float *other) {
+  *accum += *other;
+}
+
+// Bounding box of 2-D points.
+#pragma rs reduce(bounds) initializer(bInit) accumulator(bAccum) \
+  combiner(bCombine)
+
+static void bInit(int4 *accum) {
+  accum->xy = 0x7fffffff;
+  accum->zw = -0x7fffffff - 1;
+}
+
+static void bAccum(int4 *accum, int2 p) {
+  accum->xy = min(accum->xy, p);
+  accum->zw = max(accum->zw, p);
+}
+
+static void bCombine(int4 *accum, const int4 *other) {
+  accum->xy = min(accum->xy, other->xy);
+  accum->zw = max(accum->zw, other->zw);
+}
@@ -0,0 +1,10 @@
+// -reflect-c++ -reflect-c++-incbin
+#pragma version(1)
+#pragma rs java_package_name(foo)
+
+int i1 = 5;
+float f1;
+
+int RS_KERNEL root(int ain) {
+  return ain + i1;
+}
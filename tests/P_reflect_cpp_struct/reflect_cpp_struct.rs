@@ -0,0 +1,26 @@
+// -reflect-c++
+#pragma version(1)
+#pragma rs java_package_name(foo)
+
+typedef struct inner {
+  char c;
+  float3 v;
+} inner_t;
+
+typedef struct outer {
+  int i;
+  inner_t in[2];
+  double d;
+  rs_allocation a;
+} outer_t;
+
+inner_t gInner;
+outer_t gOuter;
+int gArray[4] = {1, 2, 3};
+float2 gVectors[3];
+inner_t *gInnerPtr;
+
+inner_t RS_KERNEL root(inner_t ain) {
+  ain.c++;
+  return ain;
+}
@@ -0,0 +1,19 @@
+// -reflect-packed-fields
+#pragma version(1)
+#pragma rs java_package_name(foo)
+
+typedef struct Inner {
+    int i;
+} Inner_t;
+
+typedef struct Packed {
+    float f;
+    uchar c;
+    uint u;
+    float4 v;
+    rs_matrix2x2 m;
+    Inner_t inner;
+    rs_allocation a;
+} Packed_t;
+
+Packed_t *packed;
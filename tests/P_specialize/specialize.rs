@@ -0,0 +1,21 @@
+// -target-api 0
+#pragma version(1)
+#pragma rs java_package_name(foo)
+
+#pragma rs specialize(radius, channels)
+#pragma rs specialize(weights)
+
+int radius;
+uint32_t channels;
+float4 weights;
+float gain;
+
+rs_allocation input;
+
+float4 RS_KERNEL blur(uint32_t x) {
+  float4 sum = 0.f;
+  for (int dx = -radius; dx <= radius; dx++) {
+    sum += weights * rsGetElementAt_float4(input, x + dx);
+  }
+  return sum * gain;
+}